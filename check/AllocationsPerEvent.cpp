@@ -0,0 +1,138 @@
+/*
+  Counts the heap allocations made while Simulation::run() executes
+  the events of the fractal example in doc/example-code/testFractal,
+  by replacing the global operator new. Once the containers used to
+  track changed cells and to hold the event list have grown to their
+  steady-state sizes, executing an event should not allocate at all,
+  so this exits with a non-zero status if there are more than
+  MAX_ALLOCATIONS_PER_EVENT allocations per event. */
+
+#include <KMCThinFilm/Simulation.hpp>
+#include <KMCThinFilm/RandNumGenMT19937.hpp>
+
+#include "EventsAndActions.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <iostream>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // Measured at about 7e-5, since the containers still grow
+  // occasionally as the film roughens.
+  const double MAX_ALLOCATIONS_PER_EVENT = 1e-3;
+
+  bool countingAllocations = false;
+  unsigned long long numAllocations = 0;
+
+  void * countedAlloc(std::size_t size) {
+    if (countingAllocations) {
+      ++numAllocations;
+    }
+
+    void * ptr = std::malloc(size ? size : 1);
+
+    if (ptr == NULL) {
+      throw std::bad_alloc();
+    }
+
+    return ptr;
+  }
+
+}
+
+void * operator new(std::size_t size) {
+  return countedAlloc(size);
+}
+
+void * operator new[](std::size_t size) {
+  return countedAlloc(size);
+}
+
+void operator delete(void * ptr) throw() {
+  std::free(ptr);
+}
+
+void operator delete[](void * ptr) throw() {
+  std::free(ptr);
+}
+
+int main() {
+
+  double F = 1, DoverF = 1e5, maxCoverage = 2;
+  int domainSize = 128;
+  unsigned int seed = 42;
+  SolverId::Type sId = SolverId::DYNAMIC_SCHULZE;
+
+  double approxDepTime = maxCoverage/F;
+
+  LatticeParams latParams;
+  latParams.numIntsPerCell = FIntVal::SIZE;
+  latParams.globalPlanarDims[0] = latParams.globalPlanarDims[1] = domainSize;
+
+  Simulation sim(latParams);
+
+  sim.setSolver(sId);
+
+  RandNumGenSharedPtr rng(new RandNumGenMT19937(seed));
+
+  sim.setRNG(rng);
+
+  sim.reserveOverLatticeEvents(FOverLatticeEvents::SIZE);
+  sim.addOverLatticeEvent(FOverLatticeEvents::DEPOSITION,
+			  F, DepositionExecute);
+
+  CellNeighOffsets hopCNO(HopOffset::SIZE);
+
+  hopCNO.addOffset(HopOffset::UP,    CellIndsOffset(0,+1,0));
+  hopCNO.addOffset(HopOffset::DOWN,  CellIndsOffset(0,-1,0));
+  hopCNO.addOffset(HopOffset::LEFT,  CellIndsOffset(-1,0,0));
+  hopCNO.addOffset(HopOffset::RIGHT, CellIndsOffset(+1,0,0));
+
+  hopCNO.addOffset(HopOffset::RIGHT_UP,   CellIndsOffset(+1,+1,0));
+  hopCNO.addOffset(HopOffset::RIGHT_DOWN, CellIndsOffset(+1,-1,0));
+  hopCNO.addOffset(HopOffset::LEFT_UP,    CellIndsOffset(-1,+1,0));
+  hopCNO.addOffset(HopOffset::LEFT_DOWN,  CellIndsOffset(-1,-1,0));
+
+  sim.reserveCellCenteredEventGroups(1,FCellCenteredEvents::SIZE);
+
+  EventExecutorGroup hopExecs(FCellCenteredEvents::SIZE);
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_LEFT,
+                            HoppingExecute(FCellCenteredEvents::HOP_LEFT));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_RIGHT,
+                            HoppingExecute(FCellCenteredEvents::HOP_RIGHT));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_UP,
+                            HoppingExecute(FCellCenteredEvents::HOP_UP));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_DOWN,
+                            HoppingExecute(FCellCenteredEvents::HOP_DOWN));
+
+  sim.addCellCenteredEventGroup(1, hopCNO,
+                                HoppingPropensity(DoverF*F),
+                                hopExecs);
+
+  // The first run builds the event list and lets the containers grow
+  // to their steady-state sizes, and only the second is measured.
+  sim.run(0.15*approxDepTime);
+
+  unsigned long long numStepsBefore = sim.numGlobalSteps();
+
+  countingAllocations = true;
+  sim.run(0.15*approxDepTime);
+  countingAllocations = false;
+
+  unsigned long long numEvents = sim.numGlobalSteps() - numStepsBefore;
+  double allocationsPerEvent = static_cast<double>(numAllocations)/numEvents;
+
+  std::cout << numAllocations << " allocations in " << numEvents << " events, or "
+	    << allocationsPerEvent << " allocations per event" << std::endl;
+
+  if (!(allocationsPerEvent <= MAX_ALLOCATIONS_PER_EVENT)) {
+    std::cerr << "More than " << MAX_ALLOCATIONS_PER_EVENT
+	      << " allocations per event" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
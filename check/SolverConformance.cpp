@@ -0,0 +1,91 @@
+/*
+  Runs checkSolverConformance() on every built-in solver with each of
+  several sets of parameters, and on a built-in solver registered as
+  a custom solver through registerSolver().
+
+  This exits with a non-zero status if any solver fails the check. */
+
+#include "SolverConformance.hpp"
+#include "SolverFactory.hpp"
+#include "SolverRegistry.hpp"
+#include "ErrorHandling.hpp"
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include <boost/bind.hpp>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // Creates a built-in solver on behalf of the registry. The
+  // simulation, rather than the creator, is responsible for wrapping
+  // a solver in an alias table, so that parameter isn't passed on.
+  Solver * mkBuiltInSolver(int sId, const Lattice * lattice,
+			   const SolverParams & params) {
+    const SolverParam::Type paramNames[] = {SolverParam::PROPENSITY_CLASS_RATIO,
+					    SolverParam::AGGREGATE_EVENTS_PER_CELL,
+					    SolverParam::SPATIALLY_ORDERED_LEAVES};
+
+    SolverParams unwrappedParams;
+
+    for (std::size_t p = 0; p < sizeof(paramNames)/sizeof(SolverParam::Type); ++p) {
+      bool isAvailable;
+      double paramVal = params.getParamIfAvailable(paramNames[p], isAvailable);
+
+      if (isAvailable) {
+	unwrappedParams.setParam(paramNames[p], paramVal);
+      }
+    }
+
+    return mkSolver(sId, lattice, unwrappedParams);
+  }
+
+}
+
+int main() {
+
+  std::vector<SolverParams> paramSets(4);
+  std::vector<std::string> paramSetNames(4);
+
+  paramSetNames[0] = "default parameters";
+
+  paramSets[1].setParam(SolverParam::ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS, 1);
+  paramSetNames[1] = "ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS";
+
+  paramSets[2].setParam(SolverParam::PROPENSITY_CLASS_RATIO, 2);
+  paramSetNames[2] = "PROPENSITY_CLASS_RATIO";
+
+  paramSets[3].setParam(SolverParam::SPATIALLY_ORDERED_LEAVES, 1);
+  paramSetNames[3] = "SPATIALLY_ORDERED_LEAVES";
+
+  std::vector<int> solverIds;
+  for (int sId = SolverId::DYNAMIC_SCHULZE; sId <= SolverId::AUTO; ++sId) {
+    solverIds.push_back(sId);
+  }
+
+  int customId = SolverId::MIN_CUSTOM_ID;
+  registerSolver(customId, boost::bind(mkBuiltInSolver, SolverId::BINARY_TREE, _1, _2));
+  exitOnCondition(!solverIsAvailable(customId),
+		  "Registered solver is not available");
+  solverIds.push_back(customId);
+
+  int numFailures = 0;
+
+  for (std::size_t s = 0; s < solverIds.size(); ++s) {
+    for (std::size_t p = 0; p < paramSets.size(); ++p) {
+      int status = checkSolverConformance(solverIds[s], paramSets[p]);
+
+      std::cout << "Solver with ID " << solverIds[s] << " and " << paramSetNames[p]
+		<< (status == 0 ? ": OK" : ": FAILED") << std::endl;
+
+      if (status != 0) {
+	++numFailures;
+      }
+    }
+  }
+
+  return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/*
+   Comments in this code of the form "//! [...]" are used to assist
+   Doxygen in documenting this file.
+*/
+
+#include "EventsAndActions.hpp"
+
+#include <iostream>
+#include <boost/lexical_cast.hpp>
+
+#include <KMCThinFilm/CellNeighOffsets.hpp>
+#include <KMCThinFilm/ErrorHandling.hpp>
+
+using namespace KMCThinFilm;
+
+//! [lattice init]
+void InitLattice::operator()(Lattice & lattice) const {
+
+  lattice.addPlanes(1);
+
+  CellNeighOffsets countCNO(NeighOffset::SIZE);
+
+  countCNO.addOffset(NeighOffset::UP,    CellIndsOffset(0,+1,0));
+  countCNO.addOffset(NeighOffset::DOWN,  CellIndsOffset(0,-1,0));
+  countCNO.addOffset(NeighOffset::LEFT,  CellIndsOffset(-1,0,0));
+  countCNO.addOffset(NeighOffset::RIGHT, CellIndsOffset(+1,0,0));
+
+  countCNO.addOffset(NeighOffset::RIGHT_UP,   CellIndsOffset(+1,+1,0));
+  countCNO.addOffset(NeighOffset::RIGHT_DOWN, CellIndsOffset(+1,-1,0));
+  countCNO.addOffset(NeighOffset::LEFT_UP,    CellIndsOffset(-1,+1,0));
+  countCNO.addOffset(NeighOffset::LEFT_DOWN,  CellIndsOffset(-1,-1,0));
+
+  lattice.addNeighborCount(FIntVal::OCCUPIED, FIntVal::NUM_NEIGHS, countCNO);
+}
+//! [lattice init]
+
+//! [dep execute]
+void DepositionExecute(const CellInds & ci,
+		       const SimulationState & simState,
+		       Lattice & lattice) {
+
+  CellInds ciInPlane(ci.i, ci.j, 0);
+
+  int height = lattice.getInt(ciInPlane, FIntVal::HEIGHT);
+
+  if (height >= lattice.currHeight()) {
+    lattice.addPlanes(height + 1 - lattice.currHeight());
+  }
+
+  lattice.setInt(CellInds(ci.i, ci.j, height), FIntVal::OCCUPIED, 1);
+  lattice.setInt(ciInPlane, FIntVal::HEIGHT, height + 1);
+
+}
+//! [dep execute]
+
+//! [hop prop]
+void HoppingPropensity::operator()(const CellNeighProbe & cnp,
+                                   std::vector<double> & propensityVec) const {
+
+  /* A particle at the top of its column can hop if none of the eight
+     cells around it in its plane are occupied, which is the same as
+     the height of its column exceeding the heights of the eight
+     columns around it in ../testFractal. Rather than probing those
+     eight cells, the count of occupied ones kept by the lattice is
+     read. */
+
+  CellToProbe self = cnp.getCellToProbe(PropOffset::SELF);
+
+  if (cnp.getInt(self, FIntVal::OCCUPIED) && (cnp.getInt(self, FIntVal::NUM_NEIGHS) == 0)) {
+
+    CellToProbe above = cnp.getCellToProbe(PropOffset::ABOVE);
+
+    if (cnp.exceedsLatticeHeight(above) || !cnp.getInt(above, FIntVal::OCCUPIED)) {
+      propensityVec[FCellCenteredEvents::HOP_LEFT] =
+        propensityVec[FCellCenteredEvents::HOP_RIGHT] =
+        propensityVec[FCellCenteredEvents::HOP_UP] =
+        propensityVec[FCellCenteredEvents::HOP_DOWN] = D_;
+    }
+  }
+
+}
+//! [hop prop]
+
+//! [hop exec constructor]
+HoppingExecute::HoppingExecute(FCellCenteredEvents::Type hopDir) {
+
+  switch (hopDir) {
+  case FCellCenteredEvents::HOP_UP:
+    jump_i_ = 0;
+    jump_j_ = 1;
+    break;
+  case FCellCenteredEvents::HOP_DOWN:
+    jump_i_ = 0;
+    jump_j_ = -1;
+    break;
+  case FCellCenteredEvents::HOP_LEFT:
+    jump_i_ = -1;
+    jump_j_ = 0;
+    break;
+  case FCellCenteredEvents::HOP_RIGHT:
+    jump_i_ = 1;
+    jump_j_ = 0;
+    break;
+  default:
+    exitWithMsg("Bad hop direction!");
+  }
+}
+//! [hop exec constructor]
+
+//! [hop exec op]
+void HoppingExecute::operator()(const CellInds & ci,
+				const SimulationState & simState,
+				Lattice & lattice) const {
+
+  // The particle drops to the top of the neighboring column, which
+  // is no higher than its own plane, since none of its neighbors in
+  // that plane are occupied.
+  CellInds ciFromInPlane(ci.i, ci.j, 0);
+  CellInds ciToInPlane(ci.i + jump_i_, ci.j + jump_j_, 0);
+
+  int heightTo = lattice.getInt(ciToInPlane, FIntVal::HEIGHT);
+
+  lattice.setInt(ci, FIntVal::OCCUPIED, 0);
+  lattice.setInt(ciFromInPlane, FIntVal::HEIGHT, ci.k);
+
+  lattice.setInt(CellInds(ciToInPlane.i, ciToInPlane.j, heightTo), FIntVal::OCCUPIED, 1);
+  lattice.setInt(ciToInPlane, FIntVal::HEIGHT, heightTo + 1);
+}
+//! [hop exec op]
+
+//! [check op]
+void CheckNeighborCounts::operator()(const SimulationState & simState, Lattice & lattice) const {
+
+  /* Each count is compared against a recount of the occupied cells
+     around it, as seen from the local part of the lattice. In a
+     parallel simulation, this includes the ghosts, which may lag
+     behind the cells they copy until the next sector that borders them
+     is simulated, and so the counts are only expected to match the
+     ghosts as they currently are. */
+
+  LatticePlanarBBox localBBox;
+  lattice.getLocalPlanarBBox(false, localBBox);
+
+  long numCellsChecked = 0, numMismatches = 0;
+
+  CellInds ci;
+  for (ci.k = 0; ci.k < lattice.currHeight(); ++(ci.k)) {
+    for (ci.i = localBBox.imin; ci.i < localBBox.imaxP1; ++(ci.i)) {
+      for (ci.j = localBBox.jmin; ci.j < localBBox.jmaxP1; ++(ci.j)) {
+
+	int numNeighs = 0;
+
+	for (int di = -1; di <= 1; ++di) {
+	  for (int dj = -1; dj <= 1; ++dj) {
+	    if ((di != 0) || (dj != 0)) {
+	      numNeighs += (lattice.getInt(CellInds(ci.i + di, ci.j + dj, ci.k), FIntVal::OCCUPIED) != 0);
+	    }
+	  }
+	}
+
+	++numCellsChecked;
+
+	if (numNeighs != lattice.getInt(ci, FIntVal::NUM_NEIGHS)) {
+	  ++numMismatches;
+	}
+      }
+    }
+  }
+
+#if KMC_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &numCellsChecked, 1, MPI_LONG, MPI_SUM, lattice.comm());
+  MPI_Allreduce(MPI_IN_PLACE, &numMismatches, 1, MPI_LONG, MPI_SUM, lattice.comm());
+#endif
+
+  exitOnCondition(numMismatches > 0,
+		  boost::lexical_cast<std::string>(numMismatches) + " of " +
+		  boost::lexical_cast<std::string>(numCellsChecked) +
+		  " neighbor counts differ from a recount at time " +
+		  boost::lexical_cast<std::string>(simState.elapsedTime()));
+
+  if (lattice.procID() == 0) {
+    std::cout << "All " << numCellsChecked << " neighbor counts match a recount at time "
+	      << simState.elapsedTime() << std::endl;
+  }
+}
+//! [check op]
@@ -0,0 +1,92 @@
+#ifndef EVENTS_AND_ACTIONS_HPP
+#define EVENTS_AND_ACTIONS_HPP
+
+/*
+   Comments in this code of the form "//! [...]" are used to assist
+   Doxygen in documenting this file.
+*/
+
+#include <KMCThinFilm/CellCenteredGroupPropensities.hpp>
+#include <KMCThinFilm/EventExecutor.hpp>
+#include <KMCThinFilm/MakeEnum.hpp>
+
+//! [event and action enums]
+KMC_MAKE_ID_ENUM(FOverLatticeEvents,
+		 DEPOSITION);
+
+KMC_MAKE_ID_ENUM(FCellCenteredEvents,
+		 HOP_UP,
+		 HOP_DOWN,
+		 HOP_LEFT,
+		 HOP_RIGHT);
+
+KMC_MAKE_ID_ENUM(PAction,
+		 CHECK_NEIGHBOR_COUNTS);
+//! [event and action enums]
+
+/* Unlike ../testFractal, where each cell of the single lattice plane
+   holds the height of a column of particles, each cell here holds
+   whether it is occupied by a particle. The height of each column is
+   still kept in the bottom plane, so that deposition and hopping can
+   find the top of a column without searching for it. NUM_NEIGHS is
+   maintained by the lattice itself (see
+   KMCThinFilm::Lattice::addNeighborCount()). */
+
+//! [lattice enum]
+KMC_MAKE_LATTICE_INTVAL_ENUM(F, OCCUPIED, NUM_NEIGHS, HEIGHT);
+//! [lattice enum]
+
+//! [offset enums]
+KMC_MAKE_OFFSET_ENUM(NeighOffset,
+		     UP, DOWN, LEFT, RIGHT,
+                     RIGHT_UP, RIGHT_DOWN, LEFT_UP, LEFT_DOWN);
+
+KMC_MAKE_OFFSET_ENUM(PropOffset,
+		     ABOVE);
+//! [offset enums]
+
+//! [lattice init]
+class InitLattice {
+public:
+  void operator()(KMCThinFilm::Lattice & lattice) const;
+};
+//! [lattice init]
+
+//! [dep execute]
+void DepositionExecute(const KMCThinFilm::CellInds & ci,
+		       const KMCThinFilm::SimulationState & simState,
+		       KMCThinFilm::Lattice & lattice);
+//! [dep execute]
+
+//! [hop prop]
+class HoppingPropensity {
+public:
+  HoppingPropensity(double D) : D_(D) {}
+  void operator()(const KMCThinFilm::CellNeighProbe & cnp,
+                  std::vector<double> & propensityVec) const;
+private:
+  double D_;
+};
+//! [hop prop]
+
+//! [hop exec]
+class HoppingExecute {
+public:
+  HoppingExecute(FCellCenteredEvents::Type hopDir);
+  void operator()(const KMCThinFilm::CellInds & ci,
+		  const KMCThinFilm::SimulationState & simState,
+		  KMCThinFilm::Lattice & lattice) const;
+private:
+  int jump_i_, jump_j_;
+};
+//! [hop exec]
+
+//! [check op]
+class CheckNeighborCounts {
+public:
+  void operator()(const KMCThinFilm::SimulationState & simState,
+		  KMCThinFilm::Lattice & lattice) const;
+};
+//! [check op]
+
+#endif /* EVENTS_AND_ACTIONS_HPP */
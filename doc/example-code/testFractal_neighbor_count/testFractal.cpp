@@ -0,0 +1,124 @@
+/*
+   Any comments in this code of the form "//! [...]" are used to
+   assist Doxygen in documenting this file.  */
+
+//! [headers]
+#include <KMCThinFilm/Simulation.hpp>
+
+#if KMC_PARALLEL
+#include <KMCThinFilm/RandNumGenDCMT.hpp>
+#else
+#include <KMCThinFilm/RandNumGenMT19937.hpp>
+#endif
+
+#include "EventsAndActions.hpp"
+//! [headers]
+
+//! [using decl]
+using namespace KMCThinFilm;
+//! [using decl]
+
+int main(int argc, char *argv[]) {
+
+  //! [mpi init]
+#if KMC_PARALLEL
+  MPI_Init(&argc, &argv);
+#endif
+  //! [mpi init]
+
+  //! [hardcoded parameters]
+  double F = 1, DoverF = 1e5, maxCoverage = 4;
+  int domainSize = 256;
+  unsigned int seedGlobal = 42;
+  SolverId::Type sId = SolverId::DYNAMIC_SCHULZE;
+
+  TimeIncr::SchemeVars schemeVars;
+  schemeVars.setSchemeName(TimeIncr::SchemeName::MAX_AVG_PROPENSITY_PER_POSS_EVENT);
+  schemeVars.setSchemeParam(TimeIncr::SchemeParam::NSTOP, 1);
+  //! [hardcoded parameters]
+
+  //! [deposition time]
+  double approxDepTime = maxCoverage/F;
+  //! [deposition time]
+
+  //! [initializing simulation]
+  LatticeParams latParams;
+  latParams.numIntsPerCell = FIntVal::SIZE;
+  latParams.globalPlanarDims[0] = latParams.globalPlanarDims[1] = domainSize;
+  latParams.ghostExtent[0] = latParams.ghostExtent[1] = 1;
+
+#ifdef USE_COMPACT_DECOMP
+  latParams.parallelDecomp = LatticeParams::COMPACT;
+#endif
+  latParams.latInit = InitLattice();
+
+  Simulation sim(latParams);
+  //! [initializing simulation]
+
+  sim.setSolver(sId);
+
+  //! [setting rng]
+#if KMC_PARALLEL
+  RandNumGenSharedPtr rng(new RandNumGenDCMT(sim.procID(),
+                                             seedGlobal,
+                                             123*sim.procID() + 456,
+                                             RandNumGenDCMT::P521));
+#else
+  RandNumGenSharedPtr rng(new RandNumGenMT19937(seedGlobal));
+#endif
+
+  sim.setRNG(rng);
+  //! [setting rng]
+
+  sim.setTimeIncrScheme(schemeVars);
+
+  //! [adding overlattice events]
+  sim.reserveOverLatticeEvents(FOverLatticeEvents::SIZE);
+  sim.addOverLatticeEvent(FOverLatticeEvents::DEPOSITION,
+			  F, DepositionExecute);
+  //! [adding overlattice events]
+
+  //! [making cellneighoffsets]
+  CellNeighOffsets propCNO(PropOffset::SIZE);
+  propCNO.addOffset(PropOffset::ABOVE, CellIndsOffset(0,0,+1));
+  //! [making cellneighoffsets]
+
+  //! [adding cellcentered events]
+  sim.reserveCellCenteredEventGroups(1,FCellCenteredEvents::SIZE);
+
+  EventExecutorGroup hopExecs(FCellCenteredEvents::SIZE);
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_LEFT,
+                            HoppingExecute(FCellCenteredEvents::HOP_LEFT));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_RIGHT,
+                            HoppingExecute(FCellCenteredEvents::HOP_RIGHT));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_UP,
+                            HoppingExecute(FCellCenteredEvents::HOP_UP));
+  hopExecs.addEventExecutor(FCellCenteredEvents::HOP_DOWN,
+                            HoppingExecute(FCellCenteredEvents::HOP_DOWN));
+
+  sim.addCellCenteredEventGroup(1, propCNO,
+                                HoppingPropensity(DoverF*F),
+                                hopExecs);
+  //! [adding cellcentered events]
+
+  //! [adding checker]
+  sim.reserveTimePeriodicActions(PAction::SIZE);
+  sim.addTimePeriodicAction(PAction::CHECK_NEIGHBOR_COUNTS,
+			    CheckNeighborCounts(),
+			    0.25*approxDepTime, true);
+  //! [adding checker]
+
+  //! [running simulation]
+  sim.run(approxDepTime);
+  sim.removeOverLatticeEvent(FOverLatticeEvents::DEPOSITION);
+  sim.run(0.1*approxDepTime);
+  //! [running simulation]
+
+  //! [mpi finalize]
+#if KMC_PARALLEL
+  MPI_Finalize();
+#endif
+  //! [mpi finalize]
+
+  return 0;
+}
@@ -0,0 +1,542 @@
+#include "EnsembleRunner.hpp"
+#include "Simulation.hpp"
+#include "SimulationState.hpp"
+#include "Lattice.hpp"
+#include "ErrorHandling.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#if !KMC_PARALLEL
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/bind.hpp>
+#endif
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // Number of samples of an observable with the given period that
+  // are due by time t. The small allowance is for roundoff in the
+  // times at which the time-periodic actions taking the samples are
+  // done, which are sums of periods.
+  int numSamplesDueBy(double t, double period) {
+    return static_cast<int>(std::floor(t/period + 1e-9));
+  }
+
+  // Running mean and sum of squared deviations from the mean of a
+  // value over the replicas. These are updated one sample at a time
+  // with Welford's method, and combined with the pairwise formula of
+  // Chan et al., rather than found from the sums of the samples and
+  // of their squares, which can cancel catastrophically when the
+  // samples are large compared to their spread.
+  struct RunningStats {
+    double n, mean, sumOfSqDevs;
+
+    RunningStats() : n(0), mean(0), sumOfSqDevs(0) {}
+
+    void add(double x) {
+      n += 1;
+      double delta = x - mean;
+      mean += delta/n;
+      sumOfSqDevs += delta*(x - mean);
+    }
+
+    void combine(const RunningStats & other) {
+      if (other.n == 0) {
+        return;
+      }
+
+      if (n == 0) {
+        *this = other;
+        return;
+      }
+
+      double totN = n + other.n;
+      double delta = other.mean - mean;
+
+      mean += delta*(other.n/totN);
+      sumOfSqDevs += other.sumOfSqDevs + delta*delta*(n*other.n/totN);
+      n = totN;
+    }
+  };
+
+#if KMC_PARALLEL
+  // Used with MPI_Op_create(), with the RunningStats being passed as
+  // three contiguous doubles each.
+  void combineRunningStats(void * invec, void * inoutvec, int * len, MPI_Datatype * datatype) {
+    const RunningStats * in = static_cast<const RunningStats *>(invec);
+    RunningStats * inout = static_cast<RunningStats *>(inoutvec);
+
+    for (int i = 0; i < *len; ++i) {
+      inout[i].combine(in[i]);
+    }
+  }
+#endif
+
+}
+
+struct EnsembleRunner::Impl_ {
+  Impl_(int numReplicas,
+	const SimulationFactory & mkSimulation,
+	const RNGFactory & mkRNG);
+
+  int numReplicas_;
+
+  SimulationFactory mkSimulation_;
+  RNGFactory mkRNG_;
+
+  struct Observable_ {
+    int actionId;
+    double period;
+    int numVals;
+    Observable measure;
+
+    // Statistics over the replicas of each value of each sample, and
+    // the number of replicas that took each sample.
+    std::vector<RunningStats> stats;
+    std::vector<int> numSampled;
+
+    Observable_(int myActionId, double myPeriod, int myNumVals,
+		const Observable & myMeasure)
+      : actionId(myActionId), period(myPeriod), numVals(myNumVals),
+	measure(myMeasure)
+    {}
+  };
+
+  std::vector<Observable_> observables_;
+
+  // The samples of an observable taken by one replica
+  struct ReplicaSamples_ {
+    std::vector<double> vals, localVals, replicaVals;
+    int numTaken;
+  };
+
+  // The time-periodic action that samples an observable. Since the
+  // action may be done less often than once per period (e.g., if a
+  // global time step is longer than the period), a sample that is
+  // due is also taken for every earlier sample that was missed, and
+  // the action is done at the end of the run as well, to take any
+  // samples still missing then.
+  class SampleObservable_ {
+  public:
+    SampleObservable_(const Observable_ * obs, ReplicaSamples_ * samples,
+		      int maxNumSamples
+#if KMC_PARALLEL
+		      , MPI_Comm replicaComm
+#endif
+		      )
+      : obs_(obs), samples_(samples), maxNumSamples_(maxNumSamples)
+#if KMC_PARALLEL
+      , replicaComm_(replicaComm)
+#endif
+    {}
+
+    void operator()(const SimulationState & simState, Lattice & lattice) const;
+
+  private:
+    const Observable_ * obs_;
+    ReplicaSamples_ * samples_;
+    int maxNumSamples_;
+#if KMC_PARALLEL
+    MPI_Comm replicaComm_;
+#endif
+  };
+
+  // Only valid during a call to run().
+  double runTime_;
+  ResultCollector collectResult_;
+
+  void resetStats_();
+
+  void addObservablesTo_(Simulation & sim, std::vector<ReplicaSamples_> & samples) const;
+
+  void addToStats_(const std::vector<ReplicaSamples_> & samples);
+
+  std::size_t observableIndex_(int actionId) const;
+
+#if KMC_PARALLEL
+  MPI_Comm comm_, replicaComm_;
+  int replicaNum_, replicaProcID_, streamNum_;
+
+  void reduceStats_();
+#else
+  int numThreads_;
+
+  // Number of the next replica to be run by a worker thread.
+  int nextReplicaNum_;
+
+  boost::mutex nextReplicaNumMutex_;
+  boost::mutex factoryMutex_;
+  boost::mutex resultMutex_;
+
+  void runReplicas_();
+  bool getNextReplicaNum_(int & replicaNum);
+#endif
+};
+
+EnsembleRunner::Impl_::Impl_(int numReplicas,
+			     const SimulationFactory & mkSimulation,
+			     const RNGFactory & mkRNG)
+  : numReplicas_(numReplicas),
+    mkSimulation_(mkSimulation),
+    mkRNG_(mkRNG),
+    runTime_(0)
+#if KMC_PARALLEL
+  , replicaNum_(0),
+    replicaProcID_(0),
+    streamNum_(0)
+#else
+  , numThreads_(std::max(1U, boost::thread::hardware_concurrency())),
+    nextReplicaNum_(0)
+#endif
+{}
+
+void EnsembleRunner::Impl_::SampleObservable_::operator()(const SimulationState & simState,
+							   Lattice & lattice) const {
+
+  // Every process of a replica has the same elapsed time, and so
+  // either all of them or none of them take a sample here.
+  int numDue = std::min(numSamplesDueBy(simState.elapsedTime(), obs_->period), maxNumSamples_);
+
+  if (numDue <= samples_->numTaken) {
+    return;
+  }
+
+  std::vector<double> & localVals = samples_->localVals;
+  std::vector<double> & replicaVals = samples_->replicaVals;
+
+  localVals.assign(obs_->numVals, 0);
+  obs_->measure(simState, lattice, localVals);
+
+#if KMC_PARALLEL
+  MPI_Allreduce(&(localVals[0]), &(replicaVals[0]), obs_->numVals,
+		MPI_DOUBLE, MPI_SUM, replicaComm_);
+#else
+  replicaVals = localVals;
+#endif
+
+  for (int k = samples_->numTaken; k < numDue; ++k) {
+    std::copy(replicaVals.begin(), replicaVals.end(),
+	      samples_->vals.begin() + k*obs_->numVals);
+  }
+
+  samples_->numTaken = numDue;
+}
+
+void EnsembleRunner::Impl_::resetStats_() {
+
+  for (std::vector<Observable_>::iterator itr = observables_.begin(),
+	 itrEnd = observables_.end(); itr != itrEnd; ++itr) {
+
+    int numSamples = numSamplesDueBy(runTime_, itr->period);
+
+    itr->stats.assign(numSamples*itr->numVals, RunningStats());
+    itr->numSampled.assign(numSamples, 0);
+  }
+
+}
+
+void EnsembleRunner::Impl_::addObservablesTo_(Simulation & sim,
+					      std::vector<ReplicaSamples_> & samples) const {
+
+  // Sized before any pointers to its elements are taken.
+  samples.resize(observables_.size());
+
+  for (std::size_t i = 0; i < observables_.size(); ++i) {
+    const Observable_ & obs = observables_[i];
+    ReplicaSamples_ & replicaSamples = samples[i];
+
+    int numSamples = obs.numSampled.size();
+
+    replicaSamples.vals.assign(numSamples*obs.numVals, 0);
+    replicaSamples.replicaVals.resize(obs.numVals);
+    replicaSamples.numTaken = 0;
+
+    sim.addTimePeriodicAction(obs.actionId,
+			      SampleObservable_(&obs, &replicaSamples, numSamples
+#if KMC_PARALLEL
+						, replicaComm_
+#endif
+						),
+			      obs.period, true);
+  }
+
+}
+
+void EnsembleRunner::Impl_::addToStats_(const std::vector<ReplicaSamples_> & samples) {
+
+  for (std::size_t i = 0; i < observables_.size(); ++i) {
+    Observable_ & obs = observables_[i];
+    const ReplicaSamples_ & replicaSamples = samples[i];
+
+    std::size_t numValsTaken = replicaSamples.numTaken*obs.numVals;
+
+    for (std::size_t j = 0; j < numValsTaken; ++j) {
+      obs.stats[j].add(replicaSamples.vals[j]);
+    }
+
+    for (int k = 0; k < replicaSamples.numTaken; ++k) {
+      ++(obs.numSampled[k]);
+    }
+  }
+
+}
+
+std::size_t EnsembleRunner::Impl_::observableIndex_(int actionId) const {
+
+  for (std::size_t i = 0; i < observables_.size(); ++i) {
+    if (observables_[i].actionId == actionId) {
+      return i;
+    }
+  }
+
+  return observables_.size();
+}
+
+#if KMC_PARALLEL
+
+void EnsembleRunner::Impl_::reduceStats_() {
+
+  MPI_Datatype statsType;
+  MPI_Type_contiguous(3, MPI_DOUBLE, &statsType);
+  MPI_Type_commit(&statsType);
+
+  MPI_Op combineOp;
+  MPI_Op_create(&combineRunningStats, 1, &combineOp);
+
+  for (std::vector<Observable_>::iterator itr = observables_.begin(),
+	 itrEnd = observables_.end(); itr != itrEnd; ++itr) {
+
+    if (itr->numSampled.empty()) {
+      continue;
+    }
+
+    std::vector<RunningStats> localStats(itr->stats);
+
+    MPI_Allreduce(&(localStats[0]), &(itr->stats[0]), localStats.size(),
+		  statsType, combineOp, comm_);
+
+    // Every value of a sample was taken by the same replicas.
+    for (std::size_t k = 0; k < itr->numSampled.size(); ++k) {
+      itr->numSampled[k] = static_cast<int>(itr->stats[k*itr->numVals].n);
+    }
+  }
+
+  MPI_Op_free(&combineOp);
+  MPI_Type_free(&statsType);
+}
+
+EnsembleRunner::EnsembleRunner(int numReplicas,
+			       const SimulationFactory & mkSimulation,
+			       const RNGFactory & mkRNG,
+			       MPI_Comm comm)
+  : pImpl_(new Impl_(numReplicas, mkSimulation, mkRNG)) {
+
+  exitOnCondition(numReplicas < 1, "EnsembleRunner: The number of replicas must be positive.");
+  exitOnCondition(mkSimulation.empty(), "EnsembleRunner: No simulation factory given.");
+  exitOnCondition(mkRNG.empty(), "EnsembleRunner: No random-number generator factory given.");
+
+  int nProcs, rank;
+  MPI_Comm_size(comm, &nProcs);
+  MPI_Comm_rank(comm, &rank);
+
+  exitOnCondition((nProcs % numReplicas) != 0,
+		  "EnsembleRunner: The number of processes must be a multiple of the number of replicas.");
+
+  int procsPerReplica = nProcs/numReplicas;
+
+  // A communicator of its own keeps the reductions of the ensemble
+  // apart from any other communication over comm.
+  MPI_Comm_dup(comm, &(pImpl_->comm_));
+
+  pImpl_->replicaNum_ = rank/procsPerReplica;
+  pImpl_->streamNum_ = rank;
+
+  MPI_Comm_split(pImpl_->comm_, pImpl_->replicaNum_, rank, &(pImpl_->replicaComm_));
+  MPI_Comm_rank(pImpl_->replicaComm_, &(pImpl_->replicaProcID_));
+}
+
+EnsembleRunner::~EnsembleRunner() {
+  MPI_Comm_free(&(pImpl_->replicaComm_));
+  MPI_Comm_free(&(pImpl_->comm_));
+}
+
+int EnsembleRunner::replicaNum() const {return pImpl_->replicaNum_;}
+
+const MPI_Comm & EnsembleRunner::replicaComm() const {return pImpl_->replicaComm_;}
+
+void EnsembleRunner::run(double runTime, const ResultCollector & collectResult) {
+
+  exitOnCondition(collectResult.empty(), "EnsembleRunner::run: No result collector given.");
+
+  pImpl_->runTime_ = runTime;
+  pImpl_->resetStats_();
+
+  boost::scoped_ptr<Simulation> sim(pImpl_->mkSimulation_(pImpl_->replicaNum_, pImpl_->replicaComm_));
+
+  abortOnCondition(!sim, "EnsembleRunner: The simulation factory returned NULL.");
+
+  sim->setRNG(pImpl_->mkRNG_(pImpl_->replicaNum_, pImpl_->streamNum_));
+
+  std::vector<Impl_::ReplicaSamples_> samples;
+  pImpl_->addObservablesTo_(*sim, samples);
+
+  sim->run(runTime);
+
+  collectResult(*sim, pImpl_->replicaNum_);
+
+  sim.reset();
+
+  // Every process of a replica has the same samples, so only one of
+  // them contributes them to the statistics.
+  if (pImpl_->replicaProcID_ == 0) {
+    pImpl_->addToStats_(samples);
+  }
+
+  pImpl_->reduceStats_();
+}
+
+#else
+
+bool EnsembleRunner::Impl_::getNextReplicaNum_(int & replicaNum) {
+  boost::lock_guard<boost::mutex> lock(nextReplicaNumMutex_);
+
+  replicaNum = nextReplicaNum_;
+
+  if (nextReplicaNum_ < numReplicas_) {
+    ++nextReplicaNum_;
+    return true;
+  }
+
+  return false;
+}
+
+void EnsembleRunner::Impl_::runReplicas_() {
+
+  int replicaNum;
+
+  while (getNextReplicaNum_(replicaNum)) {
+
+    boost::scoped_ptr<Simulation> sim;
+    std::vector<ReplicaSamples_> samples;
+
+    {
+      // The factories are called for one replica at a time, since
+      // neither they nor the random-number generators they create
+      // are assumed to be thread-safe.
+      boost::lock_guard<boost::mutex> lock(factoryMutex_);
+
+      sim.reset(mkSimulation_(replicaNum));
+
+      exitOnCondition(!sim, "EnsembleRunner: The simulation factory returned NULL.");
+
+      sim->setRNG(mkRNG_(replicaNum));
+
+      addObservablesTo_(*sim, samples);
+    }
+
+    sim->run(runTime_);
+
+    {
+      boost::lock_guard<boost::mutex> lock(resultMutex_);
+      collectResult_(*sim, replicaNum);
+      addToStats_(samples);
+    }
+  }
+
+}
+
+EnsembleRunner::EnsembleRunner(int numReplicas,
+			       const SimulationFactory & mkSimulation,
+			       const RNGFactory & mkRNG)
+  : pImpl_(new Impl_(numReplicas, mkSimulation, mkRNG)) {
+
+  exitOnCondition(numReplicas < 1, "EnsembleRunner: The number of replicas must be positive.");
+  exitOnCondition(mkSimulation.empty(), "EnsembleRunner: No simulation factory given.");
+  exitOnCondition(mkRNG.empty(), "EnsembleRunner: No random-number generator factory given.");
+}
+
+EnsembleRunner::~EnsembleRunner() {}
+
+void EnsembleRunner::setNumThreads(int numThreads) {
+  exitOnCondition(numThreads < 1, "EnsembleRunner::setNumThreads: The number of threads must be positive.");
+  pImpl_->numThreads_ = numThreads;
+}
+
+void EnsembleRunner::run(double runTime, const ResultCollector & collectResult) {
+
+  exitOnCondition(collectResult.empty(), "EnsembleRunner::run: No result collector given.");
+
+  pImpl_->runTime_ = runTime;
+  pImpl_->collectResult_ = collectResult;
+  pImpl_->nextReplicaNum_ = 0;
+  pImpl_->resetStats_();
+
+  int numThreads = std::min(pImpl_->numThreads_, pImpl_->numReplicas_);
+
+  if (numThreads == 1) {
+    pImpl_->runReplicas_();
+  }
+  else {
+    boost::thread_group workers;
+
+    for (int i = 0; i < numThreads; ++i) {
+      workers.create_thread(boost::bind(&Impl_::runReplicas_, pImpl_.get()));
+    }
+
+    workers.join_all();
+  }
+
+  pImpl_->collectResult_.clear();
+}
+
+#endif
+
+void EnsembleRunner::addObservable(int actionId,
+				   double period,
+				   int numVals,
+				   const Observable & measure) {
+
+  exitOnCondition(!(period > 0), "EnsembleRunner::addObservable: The period must be positive.");
+  exitOnCondition(numVals < 1, "EnsembleRunner::addObservable: The number of values must be positive.");
+  exitOnCondition(measure.empty(), "EnsembleRunner::addObservable: No function for measuring the observable given.");
+  exitOnCondition(pImpl_->observableIndex_(actionId) < pImpl_->observables_.size(),
+		  "EnsembleRunner::addObservable: An observable with this ID already exists.");
+
+  pImpl_->observables_.push_back(Impl_::Observable_(actionId, period, numVals, measure));
+}
+
+void EnsembleRunner::getObservableStats(int actionId,
+					std::vector<double> & means,
+					std::vector<double> & stdDevs,
+					std::vector<int> & numSampled) const {
+
+  std::size_t obsInd = pImpl_->observableIndex_(actionId);
+
+  exitOnCondition(obsInd == pImpl_->observables_.size(),
+		  "EnsembleRunner::getObservableStats: No observable with this ID exists.");
+
+  const Impl_::Observable_ & obs = pImpl_->observables_[obsInd];
+
+  numSampled = obs.numSampled;
+
+  means.assign(obs.stats.size(), 0);
+  stdDevs.assign(obs.stats.size(), 0);
+
+  for (std::size_t j = 0; j < obs.stats.size(); ++j) {
+    const RunningStats & stats = obs.stats[j];
+
+    means[j] = stats.mean;
+
+    if (stats.n > 1) {
+      double variance = stats.sumOfSqDevs/(stats.n - 1);
+      stdDevs[j] = std::sqrt(std::max(variance, 0.0));
+    }
+  }
+
+}
+
+int EnsembleRunner::numReplicas() const {return pImpl_->numReplicas_;}
@@ -0,0 +1,277 @@
+#ifndef ENSEMBLE_RUNNER_HPP
+#define ENSEMBLE_RUNNER_HPP
+
+#include "KMC_Config.hpp"
+
+#if KMC_PARALLEL
+#include <mpi.h>
+#endif
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/function.hpp>
+
+#include <vector>
+
+#include "RandNumGen.hpp"
+
+/*! \file
+  \brief Defines the EnsembleRunner class.
+ */
+
+namespace KMCThinFilm {
+
+  class Simulation;
+  class SimulationState;
+  class Lattice;
+
+  /*! Class for running an ensemble of independent replicas of a
+    simulation, and for gathering statistics of observables of the
+    replicas.
+
+    In the serial version of the library, the replicas are spread
+    over several threads of a single process. In the parallel version
+    of the library, the processes of an MPI communicator (by default,
+    MPI_COMM_WORLD) are split into equal groups, each of which runs
+    one replica as a parallel simulation, so that many mid-size
+    replicas can be run at once rather than one lattice over-decomposed
+    over every process.
+
+    Each replica is a Simulation object created by a user-supplied
+    factory function, which sets up the events, periodic actions, and
+    solver of the replica just as they would be set up for a single
+    simulation, except that the random-number generator of the replica
+    is instead set by the EnsembleRunner, from a second user-supplied
+    function. That function should return a distinct stream of a
+    parallel random-number generator for each replica (and in the
+    parallel version of the library, for each process of a replica),
+    e.g.,
+
+    \code
+    #if KMC_PARALLEL
+    RandNumGenSharedPtr mkReplicaRNG(int replicaNum, int streamNum) {
+      return RandNumGenSharedPtr(new RandNumGenDCMT(streamNum, globalSeed, globalSeed + streamNum));
+    }
+    #else
+    RandNumGenSharedPtr mkReplicaRNG(int replicaNum) {
+      return RandNumGenSharedPtr(new RandNumGenDCMT(replicaNum, globalSeed, globalSeed + replicaNum));
+    }
+    #endif
+    \endcode
+
+    Since the random numbers of a replica depend only on its replica
+    number, the results of an ensemble do not depend on the number of
+    threads or on the order in which the replicas happen to be run.
+
+    Typical usage for this class is something like this:
+
+    \code
+    #if KMC_PARALLEL
+    Simulation * mkReplica(int replicaNum, MPI_Comm replicaComm) {
+      LatticeParams latParams;
+
+      // Set values of latParams
+
+      latParams.latticeCommInitial = replicaComm;
+    #else
+    Simulation * mkReplica(int replicaNum) {
+      LatticeParams latParams;
+
+      // Set values of latParams
+    #endif
+
+      Simulation * sim = new Simulation(latParams);
+
+      sim->setSolver(SolverId::BINARY_TREE);
+
+      // Add events, periodic actions, etc.
+
+      return sim;
+    }
+
+    void coverage(const SimulationState & simState, const Lattice & lattice,
+                  std::vector<double> & vals) {
+      // Set vals[0] to the number of occupied local cells
+    }
+
+    void collectResult(Simulation & sim, int replicaNum) {
+      // Record any other results of replica number replicaNum
+    }
+
+    ...
+
+    EnsembleRunner ensemble(numReplicas, mkReplica, mkReplicaRNG);
+
+    ensemble.addObservable(COVERAGE_ACTION_ID, samplingPeriod, 1, coverage);
+
+    ensemble.run(runTime, collectResult);
+
+    std::vector<double> means, stdDevs;
+    std::vector<int> numSampled;
+    ensemble.getObservableStats(COVERAGE_ACTION_ID, means, stdDevs, numSampled);
+    \endcode
+
+    Only the replicas themselves run concurrently. In the serial
+    version of the library, the factory functions are called for one
+    replica at a time, so that they (and random-number generators
+    such as RandNumGenRngStreams, whose streams are created from
+    shared state) need not be thread-safe, and the function collecting
+    the results is also called for one replica at a time. Any objects
+    that are shared by the replicas, such as those passed to the
+    events, periodic actions, and observables of more than one
+    replica, must be safe to use from several threads at once.
+
+    In the serial version of the library, this class only exists if
+    the library was built with Boost.Thread.
+  */
+  class EnsembleRunner : private boost::noncopyable {
+  public:
+
+#if KMC_PARALLEL
+    /*! Type of the function that creates replica number
+      <VAR>replicaNum</VAR>, which must use <VAR>replicaComm</VAR> as
+      the LatticeParams::latticeCommInitial of its lattice. It is
+      called on every process of the replica, and the replica is
+      deleted by the EnsembleRunner once its results have been
+      collected. */
+    typedef boost::function<Simulation * (int replicaNum, MPI_Comm replicaComm)> SimulationFactory;
+
+    /*! Type of the function that returns the random-number generator
+      of the local process of replica number <VAR>replicaNum</VAR>.
+      The number <VAR>streamNum</VAR> is different for every process
+      of the ensemble, and is suitable for use as the stream number
+      of a parallel random-number generator, e.g., the
+      <VAR>rank</VAR> argument of the RandNumGenDCMT and
+      RandNumGenRngStreams constructors. */
+    typedef boost::function<RandNumGenSharedPtr (int replicaNum, int streamNum)> RNGFactory;
+#else
+    /*! Type of the function that creates replica number
+      <VAR>replicaNum</VAR>, which is deleted by the EnsembleRunner
+      once its results have been collected. */
+    typedef boost::function<Simulation * (int replicaNum)> SimulationFactory;
+
+    /*! Type of the function that returns the random-number generator
+      for replica number <VAR>replicaNum</VAR>. */
+    typedef boost::function<RandNumGenSharedPtr (int replicaNum)> RNGFactory;
+#endif
+
+    /*! Type of the function that collects the results of replica
+      number <VAR>replicaNum</VAR> after it has finished running. In
+      the parallel version of the library, it is called on every
+      process of the replica. */
+    typedef boost::function<void (Simulation & sim, int replicaNum)> ResultCollector;
+
+    /*! Type of the function that measures an observable of a replica,
+      by setting each of the values in <VAR>vals</VAR>, which has the
+      length given to addObservable() and is initially filled with
+      zeroes. In the parallel version of the library, it is called on
+      every process of the replica, and should only measure the local
+      part of the lattice, since the values from each process of a
+      replica are summed to get the values for the replica. */
+    typedef boost::function<void (const SimulationState & simState,
+				  const Lattice & lattice,
+				  std::vector<double> & vals)> Observable;
+
+#if KMC_PARALLEL
+    /*! Constructor. Splits the processes of <VAR>comm</VAR> into
+      <VAR>numReplicas</VAR> groups of equal size, with replica number
+      <EM>r</EM> run on the processes whose ranks in <VAR>comm</VAR>
+      range from <EM>r</EM> times the group size up to, but not
+      including, <EM>r</EM> + 1 times the group size. The number of
+      processes in <VAR>comm</VAR> must be a multiple of
+      <VAR>numReplicas</VAR>. This is a collective call over
+      <VAR>comm</VAR>, and the EnsembleRunner must be destroyed
+      before MPI_Finalize() is called. */
+    EnsembleRunner(int numReplicas /*!< Number of replicas in the ensemble */,
+		   const SimulationFactory & mkSimulation /*!< Creates each replica */,
+		   const RNGFactory & mkRNG /*!< Returns the random-number generator of each process of each replica */,
+		   MPI_Comm comm = MPI_COMM_WORLD /*!< Communicator whose processes run the ensemble */);
+#else
+    /*! Constructor. */
+    EnsembleRunner(int numReplicas /*!< Number of replicas in the ensemble */,
+		   const SimulationFactory & mkSimulation /*!< Creates each replica */,
+		   const RNGFactory & mkRNG /*!< Returns the random-number generator of each replica */);
+#endif
+
+    //! \cond HIDE_FROM_DOXYGEN
+    ~EnsembleRunner();
+    //! \endcond
+
+#if KMC_PARALLEL
+    /*! The number of the replica run by the local process. <STRONG>Not
+      available in the serial version of the ARL KMCThinFilm
+      library.</STRONG> */
+    int replicaNum() const;
+
+    /*! The communicator of the processes running the same replica as
+      the local process. <STRONG>Not available in the serial version
+      of the ARL KMCThinFilm library.</STRONG> */
+    const MPI_Comm & replicaComm() const;
+#else
+    /*! Sets the number of threads on which the replicas are run. By
+      default, this is the number of hardware threads available, as
+      reported by Boost.Thread. No more threads than replicas are
+      used. <STRONG>Not available in the parallel version of the
+      ARL KMCThinFilm library.</STRONG> */
+    void setNumThreads(int numThreads);
+#endif
+
+    /*! Adds an observable, which is measured in every replica every
+      <VAR>period</VAR> units of simulation time, by a time-periodic
+      action with the ID <VAR>actionId</VAR> that the EnsembleRunner
+      adds to each replica. This ID must therefore differ from those
+      of the time-periodic actions added by the factory function.
+
+      The <EM>k</EM>-th sample of the observable is its value at the
+      first global time step at or after time <EM>k</EM> times
+      <VAR>period</VAR>, for <EM>k</EM> = 1, 2, ..., up to the run
+      time passed to run(). The samples are reduced across the
+      replicas once they have all finished running, rather than as
+      they are taken, so that no replica has to wait for the others
+      in the meantime.
+
+      \see getObservableStats()
+    */
+    void addObservable(int actionId /*!< Unique integer ID for the observable */,
+		       double period /*!< Period of sampling the observable */,
+		       int numVals /*!< Number of values making up the observable */,
+		       const Observable & measure /*!< Measures the observable */);
+
+    /*! Creates each replica, adds the observables to it, runs it for
+      <VAR>runTime</VAR> units of simulation time (see
+      Simulation::run()), passes it to <VAR>collectResult</VAR>, and
+      then deletes it. In the serial version of the library, at most
+      the number of threads set by setNumThreads() replicas exist at
+      any one time. This function returns once every replica has been
+      run and the samples of the observables have been reduced. In the
+      parallel version of the library, this is a collective call over
+      the communicator passed to the constructor. */
+    void run(double runTime, const ResultCollector & collectResult);
+
+    /*! Gets the statistics of the samples of an observable taken
+      during the last call to run(). Element <EM>k</EM> times
+      <EM>n</EM> plus <EM>i</EM> of <VAR>means</VAR> and
+      <VAR>stdDevs</VAR>, where <EM>n</EM> is the number of values
+      making up the observable, are the mean and sample standard
+      deviation over the replicas of value <EM>i</EM> of sample
+      <EM>k</EM> + 1. Element <EM>k</EM> of <VAR>numSampled</VAR> is
+      the number of replicas that took sample <EM>k</EM> + 1, which
+      is less than the number of replicas only if some of them ran
+      out of events in a serial simulation. In the parallel version of
+      the library, the statistics are available on every process. */
+    void getObservableStats(int actionId /*!< ID passed to addObservable() */,
+			    std::vector<double> & means,
+			    std::vector<double> & stdDevs,
+			    std::vector<int> & numSampled) const;
+
+    /*! Returns the number of replicas in the ensemble. */
+    int numReplicas() const;
+
+  private:
+    struct Impl_;
+    boost::scoped_ptr<Impl_> pImpl_;
+  };
+
+}
+
+#endif /* ENSEMBLE_RUNNER_HPP */
@@ -2,11 +2,10 @@
 
 #include <boost/functional/hash.hpp>
 
+#include <limits>
+
 namespace KMCThinFilm {
   
-  boost::array<int,3> EventId::dimsForFlattening_ = {{0,0,0}};
-  boost::array<int,2> EventId::ciMin_ = {{0,0}};
-
   std::size_t hash_value(const EventId & eId) {
     std::size_t seed = 0;
     boost::hash_combine(seed, eId.e1_);
@@ -18,27 +17,33 @@ namespace KMCThinFilm {
 
 using namespace KMCThinFilm;
 
-void EventId::getEventInfo(CellInds & ci, int & cellCenEventIndex) const {
-  boost::array<int,3> r;
+void EventIdFlattening::getEventInfo(const EventId & eId, CellInds & ci, int & cellCenEventIndex) const {
+  boost::array<EventId::FlatIndex,3> r;
 
   // Reversing the column-major style flattening. Note deliberate use
   // of the truncation feature of integer division.
-  r[0] = e1_/dimsForFlattening_[0];
-  r[1] = r[0]/dimsForFlattening_[1];
-  r[2] = r[1]/dimsForFlattening_[2];
+  r[0] = eId.e1_/dims_[0];
+  r[1] = r[0]/dims_[1];
+  r[2] = r[1]/dims_[2];
 
-  ci.i = e1_ - dimsForFlattening_[0]*r[0] + ciMin_[0];
-  ci.j = r[0] - dimsForFlattening_[1]*r[1] + ciMin_[1];
-  cellCenEventIndex =  r[1] - dimsForFlattening_[2]*r[2];
+  ci.i = static_cast<int>(eId.e1_ - dims_[0]*r[0]) + ciMin_[0];
+  ci.j = static_cast<int>(r[0] - dims_[1]*r[1]) + ciMin_[1];
+  cellCenEventIndex = static_cast<int>(r[1] - dims_[2]*r[2]);
         
-  ci.k = e2_;
+  ci.k = eId.e2_;
+}
+
+bool EventIdFlattening::canFlatten() const {
+  // Using floating point, since the product may overflow any integer type.
+  double numFlatIndices = static_cast<double>(dims_[0])*dims_[1]*dims_[2];
+  return !(numFlatIndices > static_cast<double>(std::numeric_limits<EventId::FlatIndex>::max()));
 }
 
 
-std::string EventId::toString() const {
-  if (isForOverLattice()) {
+std::string EventIdFlattening::toString(const EventId & eId) const {
+  if (eId.isForOverLattice()) {
     int overLatticeEventIndex, sectNum;    
-    getEventInfo(overLatticeEventIndex, sectNum);
+    eId.getEventInfo(overLatticeEventIndex, sectNum);
 
     return "OverLatticeEvent(Sector=" + boost::lexical_cast<std::string>(sectNum) +
       "; Event index=" + boost::lexical_cast<std::string>(overLatticeEventIndex) + ")";
@@ -46,7 +51,7 @@ std::string EventId::toString() const {
   else {
     CellInds ci;
     int cellCenEventIndex;
-    getEventInfo(ci, cellCenEventIndex);
+    getEventInfo(eId, ci, cellCenEventIndex);
 
     return "CellCenteredEvent(Cell indices=[" +
       boost::lexical_cast<std::string>(ci.i) + "," +
@@ -1,25 +1,31 @@
 #ifndef EVENT_ID_HPP
 #define EVENT_ID_HPP
 
+#include "KMC_Config.hpp"
 #include "CellInds.hpp"
 
 #include <boost/array.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/lexical_cast.hpp>
 
 namespace KMCThinFilm {
 
   struct EventId {
 
+    // Type of the flattened index of a cell-centered event, which
+    // must be able to hold the number of cells in a plane of a sector
+    // times the number of cell-centered events. A 64-bit index allows
+    // larger sectors, but makes each EventId twice as large.
+#if KMC_64BIT_EVENT_IDS
+    typedef boost::int64_t FlatIndex;
+#else
+    typedef int FlatIndex;
+#endif
+
     EventId()
       : e1_(0), e2_(0)
     {}
 
-    // This constructor should not be called until dimsForFlattening_ array is defined.
-    EventId(const CellInds & ci, int cellCenEventIndex)
-      : e1_((ci.i - ciMin_[0]) + dimsForFlattening_[0]*((ci.j - ciMin_[1]) + dimsForFlattening_[1]*cellCenEventIndex)),
-	e2_(ci.k)
-    {}
-
     EventId(int overLatticeEventIndex, int sectNum)
       : e1_(overLatticeEventIndex), e2_(-(sectNum + 1))
     {}
@@ -27,7 +33,7 @@ namespace KMCThinFilm {
     bool isForOverLattice() const {return e2_ < 0;}
 
     void getEventInfo(int & overLatticeEventIndex, int & sectNum) const {
-      overLatticeEventIndex = e1_;
+      overLatticeEventIndex = static_cast<int>(e1_);
       sectNum = -(e2_ + 1);
     }
 
@@ -41,16 +47,87 @@ namespace KMCThinFilm {
       return (e1_ < rhs.e1_) || ((e1_ == rhs.e1_) && (e2_ < rhs.e2_));
     }
 
-    std::string toString() const;
+    FlatIndex e1_;
+    int e2_;
+  };
+
+  std::size_t hash_value(const EventId & eId);
+
+  //! \cond HIDE_FROM_DOXYGEN
+
+  // Maps the cell indices and event index of a cell-centered event to
+  // an EventId and back. The indices are flattened relative to the
+  // local planar bounding box of a particular Simulation, so each
+  // Simulation keeps its own instance of this, and passes a copy to
+  // its solver through Solver::setEventIdFlattening(). Nothing about
+  // the flattening is shared between Simulation objects, so that
+  // several of them can be run in the same process, even concurrently.
+  class EventIdFlattening {
+  public:
+    EventIdFlattening() {
+      dims_[0] = dims_[1] = dims_[2] = 0;
+      ciMin_[0] = ciMin_[1] = 0;
+    }
+
+    EventIdFlattening(int iMin, int jMin,
+		      int numCellsI, int numCellsJ,
+		      int numCellCenEvents) {
+      dims_[0] = numCellsI;
+      dims_[1] = numCellsJ;
+      dims_[2] = numCellCenEvents;
+      ciMin_[0] = iMin;
+      ciMin_[1] = jMin;
+    }
+
+    EventId eventId(const CellInds & ci, int cellCenEventIndex) const {
+      EventId eId;
+      eId.e1_ = ((ci.i - ciMin_[0]) +
+		 static_cast<EventId::FlatIndex>(dims_[0])*((ci.j - ciMin_[1]) +
+							    static_cast<EventId::FlatIndex>(dims_[1])*cellCenEventIndex));
+      eId.e2_ = ci.k;
+      return eId;
+    }
 
-    void getEventInfo(CellInds & ci, int & cellCenEventIndex) const;
+    void getEventInfo(const EventId & eId, CellInds & ci, int & cellCenEventIndex) const;
 
-    int e1_, e2_;
-    static boost::array<int,3> dimsForFlattening_;
-    static boost::array<int,2> ciMin_;
+    // Number of distinct flattened indices of the cell-centered
+    // events in a lattice plane.
+    EventId::FlatIndex numFlatIndicesPerPlane() const {
+      return static_cast<EventId::FlatIndex>(dims_[0])*dims_[1]*dims_[2];
+    }
+
+    // Number of distinct flattened indices of the cells in a lattice
+    // plane, which is the stride between the flattened indices of
+    // successive cell-centered events.
+    EventId::FlatIndex numCellsPerPlane() const {
+      return static_cast<EventId::FlatIndex>(dims_[0])*dims_[1];
+    }
+
+    int numCellCenEvents() const {return dims_[2];}
+
+    // The same flattening, but for a single cell-centered event, so
+    // that the events of one type can be stored apart from the others
+    // with the index of their type subtracted from their IDs.
+    EventIdFlattening forSingleCellCenEvent() const {
+      return EventIdFlattening(ciMin_[0], ciMin_[1], dims_[0], dims_[1], 1);
+    }
+
+    // Lower bounds of the cell indices i and j of the bounding box.
+    int iMin() const {return ciMin_[0];}
+    int jMin() const {return ciMin_[1];}
+
+    std::string toString(const EventId & eId) const;
+
+    // Returns true if every cell-centered event in a sector with the
+    // given dimensions has a flattened index that fits in FlatIndex.
+    bool canFlatten() const;
+
+  private:
+    boost::array<int,3> dims_;
+    boost::array<int,2> ciMin_;
   };
 
-  std::size_t hash_value(const EventId & eId);
+  //! \endcond
 
 }
 
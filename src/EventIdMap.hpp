@@ -3,16 +3,20 @@
 
 #include "EventId.hpp"
 
+#include <boost/noncopyable.hpp>
+
 #include <vector>
+#include <cstddef>
+#include <algorithm>
 
 namespace KMCThinFilm {
   
   template<typename T>
-  class EventIdMap {
+  class EventIdMap : private boost::noncopyable {
   public:
 
-    // WARNING: EventId::dimsForFlattening_ *must* be defined before using this
-    EventIdMap(int numSectors, 
+    EventIdMap(const EventIdFlattening & eIdFlattening,
+               int numSectors, 
                int numOverLatticeEvents,
                int numReservedLatticePlanes,
                const T & defaultVal)
@@ -25,26 +29,66 @@ namespace KMCThinFilm {
         overLatticeEIdMap_.push_back(std::vector<T>(numOverLatticeEvents, defaultVal_));
       }
 
-      cellCenteredEIdMap_.clear();
-      cellCenteredEIdMap_.reserve(numReservedLatticePlanes);
-      cellCenteredEIdMapSize_ = EventId::dimsForFlattening_[0]*EventId::dimsForFlattening_[1]*EventId::dimsForFlattening_[2];
+      cellCenteredEIdMapSize_ = eIdFlattening.numFlatIndicesPerPlane();
+
+      // Using the smallest power of two that holds a plane (up to
+      // MAX_PAGE_SIZE_), so that finding a page and the position
+      // within it takes a shift and a mask rather than a division.
+      pageShift_ = 0;
+      while (((std::size_t(1) << pageShift_) < static_cast<std::size_t>(cellCenteredEIdMapSize_)) &&
+             ((std::size_t(1) << pageShift_) < MAX_PAGE_SIZE_)) {
+        ++pageShift_;
+      }
+
+      pageSize_ = std::size_t(1) << pageShift_;
+      pageMask_ = pageSize_ - 1;
+      pagesPerPlane_ = (cellCenteredEIdMapSize_ + pageSize_ - 1) >> pageShift_;
+
+      cellCenteredEIdPages_.clear();
+      cellCenteredEIdPages_.reserve(numReservedLatticePlanes*pagesPerPlane_);
+      pageStorage_.clear();
+      pageStorage_.reserve(numReservedLatticePlanes*pagesPerPlane_);
+      numAllocatedPages_ = 0;
+      sparePages_.reserve(pagesPerPlane_);
+    }
+
+    ~EventIdMap() {
+      for (std::size_t i = 0; i < pageStorage_.size(); ++i) {
+        delete pageStorage_[i];
+      }
+
+      for (std::size_t i = 0; i < sparePages_.size(); ++i) {
+        delete sparePages_[i];
+      }
     }
 
     // This checks if there is a value corresponding to eId. If not it
-    // returns NULL. Note that a call to addOrUpdate could invalidate
-    // the returned pointer.
+    // returns NULL. Note that a call to remove could invalidate the
+    // returned pointer.
     T* getPtrToVal(const EventId & eId) {
       T* outPtr = NULL;
 
       if (eId.isForOverLattice()) {
         int overLatticeEventIndex, sectNum;
         eId.getEventInfo(overLatticeEventIndex, sectNum);
-        
-        outPtr = &(overLatticeEIdMap_[sectNum][overLatticeEventIndex]);
+
+        // Over-lattice events may have been added since the map was
+        // made, in which case their entries don't exist yet.
+        if (overLatticeEventIndex < static_cast<int>(overLatticeEIdMap_[sectNum].size())) {
+          outPtr = &(overLatticeEIdMap_[sectNum][overLatticeEventIndex]);
+        }
       }
       else {
-        if ((eId.e2_ < static_cast<int>(cellCenteredEIdMap_.size())) && (eId.e1_ < cellCenteredEIdMapSize_)) {
-          outPtr = &(cellCenteredEIdMap_[eId.e2_][eId.e1_]);
+        if (eId.e1_ < cellCenteredEIdMapSize_) {
+          std::size_t pageInd = pageIndex_(eId);
+
+          if (pageInd < cellCenteredEIdPages_.size()) {
+            T * page = cellCenteredEIdPages_[pageInd];
+
+            if (page != NULL) {
+              outPtr = page + pageOffset_(eId);
+            }
+          }
         }
       }
 
@@ -62,7 +106,7 @@ namespace KMCThinFilm {
         return overLatticeEIdMap_[sectNum][overLatticeEventIndex];
       }
       else {
-        return cellCenteredEIdMap_[eId.e2_][eId.e1_];
+        return cellCenteredEIdPages_[pageIndex_(eId)][pageOffset_(eId)];
       }
 
     }
@@ -72,26 +116,169 @@ namespace KMCThinFilm {
       if (eId.isForOverLattice()) {
         int overLatticeEventIndex, sectNum;
         eId.getEventInfo(overLatticeEventIndex, sectNum);
-        overLatticeEIdMap_[sectNum][overLatticeEventIndex] = val;
+
+        std::vector<T> & overLatticeVals = overLatticeEIdMap_[sectNum];
+
+        if (overLatticeEventIndex >= static_cast<int>(overLatticeVals.size())) {
+          overLatticeVals.resize(overLatticeEventIndex + 1, defaultVal_);
+        }
+
+        overLatticeVals[overLatticeEventIndex] = val;
       }
       else {
         
-        // This checks if space for eId is already available, and if not,
-        // adds it.
-        while (eId.e2_ >= static_cast<int>(cellCenteredEIdMap_.size())) {
-          cellCenteredEIdMap_.push_back(std::vector<T>(cellCenteredEIdMapSize_, defaultVal_));
+        // This checks if space for eId is already available, and if
+        // not, adds it. Only the page containing eId is allocated, so
+        // that memory is not spent on parts of planes without events.
+        std::size_t pageInd = pageIndex_(eId);
+
+        if (pageInd >= cellCenteredEIdPages_.size()) {
+          cellCenteredEIdPages_.resize((eId.e2_ + 1)*pagesPerPlane_, NULL);
+          pageStorage_.resize(cellCenteredEIdPages_.size(), NULL);
+        }
+
+        Page_ * & page = pageStorage_[pageInd];
+
+        if (page == NULL) {
+          if (sparePages_.empty()) {
+            page = new Page_(pageSize_, defaultVal_);
+          }
+          else {
+            page = sparePages_.back();
+            sparePages_.pop_back();
+          }
+
+          cellCenteredEIdPages_[pageInd] = &(page->vals[0]);
+          ++numAllocatedPages_;
         }
 
-        cellCenteredEIdMap_[eId.e2_][eId.e1_] = val;
+        std::size_t offset = pageOffset_(eId);
+
+        if (!page->isLive[offset]) {
+          page->isLive[offset] = true;
+          ++(page->numLive);
+        }
+
+        page->vals[offset] = val;
       }
 
     }
 
+    // This resets the value corresponding to eId to the default
+    // value. Once every entry of a page of cell-centered entries has
+    // been removed, the page is released, so that the memory held by
+    // the map follows the number of live events rather than the
+    // number of planes that have ever held events. Note that this
+    // invalidates any pointer to the removed value.
+    void remove(const EventId & eId) {
+
+      if (eId.isForOverLattice()) {
+        int overLatticeEventIndex, sectNum;
+        eId.getEventInfo(overLatticeEventIndex, sectNum);
+
+        if (overLatticeEventIndex < static_cast<int>(overLatticeEIdMap_[sectNum].size())) {
+          overLatticeEIdMap_[sectNum][overLatticeEventIndex] = defaultVal_;
+        }
+      }
+      else {
+        std::size_t pageInd = pageIndex_(eId);
+
+        if ((pageInd < pageStorage_.size()) && (pageStorage_[pageInd] != NULL)) {
+          Page_ * page = pageStorage_[pageInd];
+          std::size_t offset = pageOffset_(eId);
+
+          page->vals[offset] = defaultVal_;
+
+          if (page->isLive[offset]) {
+            page->isLive[offset] = false;
+
+            if (--(page->numLive) == 0) {
+              releasePage_(pageInd);
+            }
+          }
+        }
+      }
+
+    }
+
+    // Estimate of the heap memory held by the map.
+    std::size_t memoryUsage() const {
+      std::size_t numBytes =
+        cellCenteredEIdPages_.capacity()*sizeof(T*) + pageStorage_.capacity()*sizeof(Page_*) +
+        sparePages_.capacity()*sizeof(Page_*) +
+        (numAllocatedPages_ + sparePages_.size())*(sizeof(Page_) + pageSize_*sizeof(T) + pageSize_/8);
+
+      for (std::size_t i = 0; i < overLatticeEIdMap_.size(); ++i) {
+        numBytes += overLatticeEIdMap_[i].capacity()*sizeof(T);
+      }
+
+      return numBytes;
+    }
+
   private:
-    std::vector<std::vector<T> > cellCenteredEIdMap_;
+    // Each plane of cell-centered entries is divided into pages of
+    // pageSize_ entries, which are only allocated when a value is
+    // added to them. The pages of each plane are stored contiguously,
+    // with the pages of plane k starting at index k*pagesPerPlane_.
+    //
+    // Lookups go through a table of raw pointers to the values of
+    // the pages (NULL for unallocated pages), which costs one load
+    // per lookup. The pages themselves are owned by pageStorage_,
+    // which has the same layout, and each keeps track of which of its
+    // entries are live, so that it can be released once none of them
+    // are.
+    //
+    // A released page has all of its entries at the default value
+    // already, and is kept in sparePages_ for reuse if there are
+    // fewer spare pages than pages in use (or than pages in a
+    // plane). Events near the surface of a film come and go at the
+    // same few pages, so freeing a page as soon as it empties would
+    // mean allocating it again a few events later.
+    enum {MAX_PAGE_SIZE_ = 1024}; // Must be a power of two
+
+    struct Page_ {
+      Page_(std::size_t pageSize, const T & defaultVal)
+        : vals(pageSize, defaultVal), isLive(pageSize, false), numLive(0) {}
+
+      std::vector<T> vals;
+      std::vector<bool> isLive;
+      std::size_t numLive;
+    };
+
+    std::vector<T*> cellCenteredEIdPages_;
+    std::vector<Page_*> pageStorage_;
+    std::size_t numAllocatedPages_;
+    std::vector<Page_*> sparePages_;
     std::vector<std::vector<T> > overLatticeEIdMap_;
-    int cellCenteredEIdMapSize_;
+    EventId::FlatIndex cellCenteredEIdMapSize_;
+    std::size_t pageSize_;
+    int pageShift_;
+    std::size_t pageMask_;
+    std::size_t pagesPerPlane_;
     T defaultVal_;
+
+    std::size_t pageIndex_(const EventId & eId) const {
+      return eId.e2_*pagesPerPlane_ + (static_cast<std::size_t>(eId.e1_) >> pageShift_);
+    }
+
+    std::size_t pageOffset_(const EventId & eId) const {
+      return static_cast<std::size_t>(eId.e1_) & pageMask_;
+    }
+
+    void releasePage_(std::size_t pageInd) {
+      Page_ * page = pageStorage_[pageInd];
+
+      pageStorage_[pageInd] = NULL;
+      cellCenteredEIdPages_[pageInd] = NULL;
+      --numAllocatedPages_;
+
+      if (sparePages_.size() < std::max(numAllocatedPages_, pagesPerPlane_)) {
+        sparePages_.push_back(page);
+      }
+      else {
+        delete page;
+      }
+    }
   };
 
 }
@@ -0,0 +1,128 @@
+#include "FenwickTree.hpp"
+
+using namespace KMCThinFilm;
+
+FenwickTree::FenwickTree()
+  : weights_(1, 0), partialSums_(2, 0), numUpdatesSinceRebuild_(0)
+{}
+
+void FenwickTree::assign(const std::vector<double> & weights) {
+  weights_ = weights;
+  reserveSlots(weights_.size());
+  rebuild_();
+}
+
+void FenwickTree::reserveSlots(std::size_t numSlots) {
+
+  std::size_t capacity = 1;
+  while (capacity < numSlots) {
+    capacity *= 2;
+  }
+
+  if (capacity != weights_.size()) {
+    weights_.resize(capacity, 0);
+    rebuild_();
+  }
+
+}
+
+void FenwickTree::rebuild_() {
+
+  std::size_t capacity = weights_.size();
+
+  partialSums_.assign(capacity + 1, 0);
+
+  for (std::size_t i = 0; i < capacity; ++i) {
+    partialSums_[i + 1] = weights_[i];
+  }
+
+  // Standard linear-time construction of a Fenwick tree
+  for (std::size_t i = 1; i < capacity; ++i) {
+    std::size_t parentInd = i + (i & (~i + 1));
+    if (parentInd <= capacity) {
+      partialSums_[parentInd] += partialSums_[i];
+    }
+  }
+
+  numUpdatesSinceRebuild_ = 0;
+}
+
+void FenwickTree::setWeight(std::size_t slotInd, double w) {
+
+  double change = w - weights_[slotInd];
+  weights_[slotInd] = w;
+
+  std::size_t capacity = weights_.size();
+
+  if (++numUpdatesSinceRebuild_ > capacity) {
+    // Amortized over capacity updates, the rebuild costs O(1) per
+    // update, and it keeps roundoff from accumulating without bound.
+    rebuild_();
+  }
+  else {
+    for (std::size_t i = slotInd + 1; i <= capacity; i += (i & (~i + 1))) {
+      partialSums_[i] += change;
+    }
+  }
+
+}
+
+std::size_t FenwickTree::descend_(double R) const {
+
+  std::size_t capacity = weights_.size();
+  std::size_t pos = 0;
+
+  for (std::size_t step = capacity; step > 0; step /= 2) {
+    std::size_t nextPos = pos + step;
+    if ((nextPos <= capacity) && (partialSums_[nextPos] <= R)) {
+      pos = nextPos;
+      R -= partialSums_[pos];
+    }
+  }
+
+  return pos;
+}
+
+std::size_t FenwickTree::findSlot(double R) {
+
+  std::size_t slotInd = descend_(R);
+
+  if ((slotInd >= weights_.size()) || !(weights_[slotInd] > 0)) {
+    // Roundoff in the partial sums led to an empty slot, so
+    // rebuilding them and trying again, with R rescaled to the
+    // rebuilt total.
+    double oldTotal = total();
+    rebuild_();
+
+    if (oldTotal > 0) {
+      R *= total()/oldTotal;
+    }
+
+    slotInd = descend_(R);
+
+    // If roundoff is *still* a problem, falling back to the last
+    // non-empty slot at or below the chosen one.
+    if (slotInd >= weights_.size()) {
+      slotInd = weights_.size() - 1;
+    }
+
+    std::size_t chosenSlotInd = slotInd;
+
+    while ((slotInd > 0) && !(weights_[slotInd] > 0)) {
+      --slotInd;
+    }
+
+    // If there is no such slot (i.e., slot 0 is empty as well), then
+    // R fell below every non-empty slot, so taking the first
+    // non-empty slot above the chosen one instead.
+    if (!(weights_[slotInd] > 0)) {
+      slotInd = chosenSlotInd;
+
+      while (((slotInd + 1) < weights_.size()) && !(weights_[slotInd] > 0)) {
+        ++slotInd;
+      }
+    }
+  }
+
+  return slotInd;
+}
@@ -0,0 +1,60 @@
+#ifndef FENWICK_TREE_HPP
+#define FENWICK_TREE_HPP
+
+#include <vector>
+#include <cstddef>
+
+namespace KMCThinFilm {
+
+  // A Fenwick (binary indexed) tree over an array of non-negative
+  // weights, allowing both updating a weight and finding the slot
+  // corresponding to a given partial sum in O(log N) time.
+  class FenwickTree {
+  public:
+    FenwickTree();
+
+    // Replaces the weights and rebuilds the tree in O(N) time.
+    void assign(const std::vector<double> & weights);
+
+    // Grows the number of slots to at least numSlots, with the new
+    // slots having zero weight. Existing weights are kept.
+    void reserveSlots(std::size_t numSlots);
+
+    std::size_t numSlots() const {return weights_.size();}
+
+    double weight(std::size_t slotInd) const {return weights_[slotInd];}
+
+    void setWeight(std::size_t slotInd, double w);
+
+    double total() const {return partialSums_.back();}
+
+    // Finds the slot i with a non-zero weight such that (sum of
+    // weights of slots before i) <= R < (sum of weights through slot
+    // i), where R is expected to be in [0, total()). Even if roundoff
+    // puts R outside that range, a slot with a non-zero weight is
+    // returned, as long as total() > 0.
+    std::size_t findSlot(double R);
+
+    std::size_t memoryUsage() const {
+      return (weights_.capacity() + partialSums_.capacity())*sizeof(double);
+    }
+
+  private:
+    std::vector<double> weights_;
+
+    // One-based, with the number of slots covered always being a
+    // power of two, so that partialSums_.back() is the total.
+    std::vector<double> partialSums_;
+
+    // Incrementally updating partialSums_ accumulates roundoff, so
+    // it is periodically rebuilt from weights_.
+    std::size_t numUpdatesSinceRebuild_;
+
+    void rebuild_();
+
+    std::size_t descend_(double R) const;
+  };
+
+}
+
+#endif /* FENWICK_TREE_HPP */
@@ -2,8 +2,8 @@
 #define IDS_OF_SOLVERS_HPP
 
 // This file is named IdsOfSolvers.hpp rather than SolverIds.hpp
-// because the Doxygen documentation excludes files with the pattern
-// "Solver*.hpp".
+// because the Doxygen documentation used to exclude files with the
+// pattern "Solver*.hpp".
 
 /*!\file
   \brief Defines the enumeration SolverId::Type
@@ -30,9 +30,83 @@ namespace KMCThinFilm {
                      of an event to scale as \f$O(log_2 N)\f$, where
                      <VAR>N</VAR> is the number of possible
                      events. May be faster than DYNAMIC_SCHULZE in
-                     practice. */
+                     practice. */,
+
+      COMPOSITION_REJECTION /*!< A solver implementing the
+                               composition-rejection algorithm of
+                               Slepoy, Thompson, and Plimpton in
+                               <EM>Journal of Chemical Physics</EM>,
+                               vol. 128, 205101 (2008). Possible events
+                               are binned into groups whose
+                               propensities lie within a factor of two
+                               of each other. A group is chosen by a
+                               linear search over the non-empty groups,
+                               and an event within the group is chosen
+                               by rejection sampling, so that choosing
+                               and updating events take \f$O(1)\f$
+                               expected time with respect to the number
+                               of possible events. Likely to be the
+                               fastest solver when there are many
+                               possible events whose propensities span
+                               a modest range. */,
+
+      KARY_TREE /*!< Like BINARY_TREE, but each internal node of
+                   the tree has eight children rather than two, and
+                   each set of siblings occupies a single cache
+                   line. This makes the tree a third as deep as the
+                   binary tree, which reduces the number of cache
+                   misses when choosing and updating events, and
+                   should be faster than BINARY_TREE when there are
+                   very many possible events. */,
+
+      FENWICK_TREE /*!< A solver where the propensities of possible
+                      events are stored in a Fenwick (binary indexed)
+                      tree, so that choosing and updating an event
+                      both scale as \f$O(log_2 N)\f$. Unlike
+                      BINARY_TREE, an event keeps the same position
+                      in the tree while its propensity is non-zero,
+                      and the position of a removed event is simply
+                      given a zero propensity and reused later, so
+                      that removing events requires no reshuffling of
+                      other events. */,
+
+      REJECTION /*!< A solver where possible events are stored in a
+                   flat array, and an event is chosen by repeatedly
+                   picking an event uniformly at random and accepting
+                   it with probability equal to its propensity divided
+                   by an upper bound on all propensities. Rejected
+                   picks (or "null events") still advance time, so
+                   that the time between accepted events has the
+                   correct distribution. Adding, updating, and
+                   removing events take \f$O(1)\f$ time, and the
+                   expected number of picks per event is the ratio of
+                   the largest propensity to the average one. This
+                   can be the fastest solver for models where nearly
+                   all possible events have similar propensities, and
+                   the slowest for models where they don't. */,
+
+      AUTO /*!< Lets the simulation choose among the other solvers
+              listed here. After the event list is first built, and
+              then periodically as the simulation runs, short bursts
+              of choosing and updating events are timed on each of
+              them, using a copy of the actual event list and the CPU
+              time of the thread running the simulation (so that
+              other threads, e.g. other replicas run by
+              EnsembleRunner, don't distort the timings), and the
+              event list is moved to whichever solver was fastest. The
+              solvers all choose events with the same probabilities,
+              so this does not change the statistics of a simulation,
+              but since the choice depends on timings, two runs with
+              the same random-number seed are not guaranteed to give
+              the same results. While it benchmarks, up to three
+              copies of the event list are in memory at once. */
     };
 
+    /*! Smallest ID that may be given to a custom solver with
+        registerSolver(). Smaller IDs are reserved for the solvers
+        enumerated in SolverId::Type. */
+    const int MIN_CUSTOM_ID = 1000;
+
   }
 
 }
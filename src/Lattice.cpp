@@ -1,4 +1,5 @@
 #include "Lattice.hpp"
+#include "CellNeighOffsets.hpp"
 #include "ErrorHandling.hpp"
 #include "CallMemberFunction.hpp"
 
@@ -8,6 +9,7 @@
 #include <cassert>
 #include <stdexcept>
 #include <algorithm>
+#include <limits>
 
 #include <boost/multi_array.hpp>
 #include <boost/lexical_cast.hpp>
@@ -60,9 +62,42 @@ struct Lattice::Impl_ {
 			     // appendPlaneAndRecordChangedCellInds_.
 
   bool latticeModified_;
+  int lowestChangedPlane_;
   ChangedCellInds changedCellInds_;  
   OtherCheckedCellInds otherCheckedCellInds_;
 
+  // Neighbor counts kept up to date by the lattice itself. See
+  // Lattice::addNeighborCount().
+  struct NeighborCount_ {
+    int occupancyInt, countInt;
+    std::vector<CellIndsOffset> offsets;
+
+    // Offsets to the cells that have a given cell as a neighbor.
+    std::vector<CellIndsOffset> reversedOffsets;
+  };
+
+  std::vector<NeighborCount_> neighborCounts_;
+
+  // For each integer in a lattice cell, the indices into
+  // neighborCounts_ of the counts that depend on that integer.
+  std::vector<std::vector<std::size_t> > neighborCountIndsOfInt_;
+
+  SetInt_ setNeighborCount_; // This points to either setInt_ or
+			     // setIntAndRecordChangedCellInds_, the
+			     // latter so that changed counts are
+			     // recorded even when the other changes
+			     // to the lattice are tracked
+			     // semi-manually.
+
+  bool neighborCountsNeedRecount_;
+
+  void setIntAndUpdateNeighborCounts_(const CellInds & ci, int whichInt, int val);
+  void updateNeighborCounts_(const NeighborCount_ & nc, const CellInds & ci, int delta);
+  void setNeighborCountOfCell_(const CellInds & ci, int countInt, int val);
+  void countNeighbors_(const NeighborCount_ & nc, int kBegin, int kEnd, bool wGhost);
+  void countNeighborsForNewPlane_();
+  bool isInLocalArrays_(CellInds & ci) const;
+
   int nProcs_, procID_;
   
   /* These functions are here to minimize the dependence on the types
@@ -288,6 +323,14 @@ struct Lattice::Impl_ {
   void reExportIfNeededActual_();
   void reExportIfNeededFake_() {}
 
+  // Cells whose neighbor counts changed when received values were
+  // set, gathered here before they are appended to the indices of the
+  // received cells.
+  std::vector<IJK> recountedCellInds_;
+
+  void recountNeighborsOfRecvCells_(std::vector<std::vector<IJK> > & recvIndsBuffer);
+  bool recountNeighborsIfAllAreLocal_(const NeighborCount_ & nc, const CellInds & ci);
+
 #else
   // Used for getReceivedGhostInds() and getReceivedLocalInds() in serial mode.
   std::vector<std::vector<IJK> > dummyNullVector_;
@@ -303,7 +346,8 @@ Lattice::Impl_::Impl_(const LatticeParams & paramsForLattice,
     globalPlanarDims_(paramsForLattice.globalPlanarDims),
     ghostExtent_(paramsForLattice.ghostExtent),
     setEmptyCellVals_(paramsForLattice.setEmptyCellVals),
-    parallelDecomp_(paramsForLattice.parallelDecomp)
+    parallelDecomp_(paramsForLattice.parallelDecomp),
+    neighborCountsNeedRecount_(false)
  {
   
   exitOnCondition((nIntsPerCell_ < 1) && (nFloatsPerCell_ < 1),
@@ -321,6 +365,8 @@ Lattice::Impl_::Impl_(const LatticeParams & paramsForLattice,
   // Note: After paramsForLattice.latInit() has been run,
   // appendPlaneOnly_ may be changed to appendPlaneFake_.
 
+  neighborCountIndsOfInt_.resize(std::max(nIntsPerCell_, 0));
+
   assert(!(paramsForLattice.numPlanesToReserve < 0));
   // Need to call this before any instance of lattice_.capacity() is
   // called.
@@ -472,11 +518,13 @@ void Lattice::Impl_::setFloatOnly_(const CellInds & ci, int whichFloat, double v
 
 void Lattice::Impl_::setIntAndRecordThatChangeOccurred_(const CellInds & ci, int whichInt, int val) {
   latticeModified_ = true;
+  lowestChangedPlane_ = std::min(lowestChangedPlane_, ci.k);
   setIntOnly_(ci, whichInt, val);
 }
 
 void Lattice::Impl_::setFloatAndRecordThatChangeOccurred_(const CellInds & ci, int whichFloat, double val) {
   latticeModified_ = true;
+  lowestChangedPlane_ = std::min(lowestChangedPlane_, ci.k);
   setFloatOnly_(ci, whichFloat, val);
 }
 
@@ -493,7 +541,166 @@ void Lattice::Impl_::setFloatAndRecordChangedCellInds_(const CellInds & ci, int
 void Lattice::Impl_::addPlanes_(int numPlanesToAdd) {
   for (int i = 0; i < numPlanesToAdd; ++i) {
     KMC_CALL_MEMBER_FUNCTION(*this, appendPlane_)();
+
+    if (!neighborCounts_.empty()) {
+      countNeighborsForNewPlane_();
+    }
+  }
+}
+
+void Lattice::Impl_::setIntAndUpdateNeighborCounts_(const CellInds & ci, int whichInt, int val) {
+
+  const std::vector<std::size_t> & ncInds = neighborCountIndsOfInt_[whichInt];
+
+  if (ncInds.empty()) {
+    KMC_CALL_MEMBER_FUNCTION(*this, setInt_)(ci, whichInt, val);
+  }
+  else {
+    int delta = (val != 0) - (self_->getInt(ci, whichInt) != 0);
+
+    KMC_CALL_MEMBER_FUNCTION(*this, setInt_)(ci, whichInt, val);
+
+    if (delta != 0) {
+      for (std::vector<std::size_t>::const_iterator itr = ncInds.begin(),
+             itrEnd = ncInds.end(); itr != itrEnd; ++itr) {
+        updateNeighborCounts_(neighborCounts_[*itr], ci, delta);
+      }
+    }
+  }
+
+}
+
+void Lattice::Impl_::updateNeighborCounts_(const NeighborCount_ & nc, const CellInds & ci, int delta) {
+
+  int currHeight = lattice_.size();
+  CellInds ciNeigh;
+
+  for (std::vector<CellIndsOffset>::const_iterator itr = nc.reversedOffsets.begin(),
+         itrEnd = nc.reversedOffsets.end(); itr != itrEnd; ++itr) {
+
+    ciNeigh = ci + *itr;
+
+    if ((ciNeigh.k >= 0) && (ciNeigh.k < currHeight) && isInLocalArrays_(ciNeigh)) {
+      setNeighborCountOfCell_(ciNeigh, nc.countInt, self_->getInt(ciNeigh, nc.countInt) + delta);
+    }
+  }
+
+}
+
+void Lattice::Impl_::setNeighborCountOfCell_(const CellInds & ci, int countInt, int val) {
+#if KMC_PARALLEL
+  // Changes to the counts of ghosts are not recorded, so that they
+  // aren't exported. A ghost whose count changes may lie beyond the
+  // cells that the event being executed could otherwise change, and
+  // the processor that owns it recounts it anyway once it receives
+  // the change in occupancy.
+  if (cellParInfoArray_[ci.i][ci.j].sectNum < 0) {
+    setIntOnly_(ci, countInt, val);
+    return;
+  }
+#endif
+
+  KMC_CALL_MEMBER_FUNCTION(*this, setNeighborCount_)(ci, countInt, val);
+}
+
+void Lattice::Impl_::countNeighbors_(const NeighborCount_ & nc, int kBegin, int kEnd, bool wGhost) {
+
+  int imin, imaxP1, jmin, jmaxP1;
+#if KMC_PARALLEL
+  getLocalPlanarBBox_(wGhost, imin, imaxP1, jmin, jmaxP1);
+#else
+  imin = jmin = 0;
+  imaxP1 = globalPlanarDims_[0];
+  jmaxP1 = globalPlanarDims_[1];
+#endif
+
+  int currHeight = lattice_.size();
+  CellInds ci, ciNeigh;
+
+  for (ci.k = kBegin; ci.k < kEnd; ++(ci.k)) {
+    for (ci.i = imin; ci.i < imaxP1; ++(ci.i)) {
+      for (ci.j = jmin; ci.j < jmaxP1; ++(ci.j)) {
+
+        int count = 0;
+
+        for (std::vector<CellIndsOffset>::const_iterator itr = nc.offsets.begin(),
+               itrEnd = nc.offsets.end(); itr != itrEnd; ++itr) {
+
+          ciNeigh = ci + *itr;
+
+          if ((ciNeigh.k >= 0) && (ciNeigh.k < currHeight) && isInLocalArrays_(ciNeigh) &&
+              (self_->getInt(ciNeigh, nc.occupancyInt) != 0)) {
+            ++count;
+          }
+        }
+
+        setIntOnly_(ci, nc.countInt, count);
+      }
+    }
+  }
+
+}
+
+void Lattice::Impl_::countNeighborsForNewPlane_() {
+
+  int kNew = lattice_.size() - 1;
+
+  int imin, imaxP1, jmin, jmaxP1;
+#if KMC_PARALLEL
+  getLocalPlanarBBox_(true, imin, imaxP1, jmin, jmaxP1);
+#else
+  imin = jmin = 0;
+  imaxP1 = globalPlanarDims_[0];
+  jmaxP1 = globalPlanarDims_[1];
+#endif
+
+  for (std::vector<NeighborCount_>::const_iterator ncItr = neighborCounts_.begin(),
+         ncItrEnd = neighborCounts_.end(); ncItr != ncItrEnd; ++ncItr) {
+
+    // Counts of the cells in the new plane itself
+    countNeighbors_(*ncItr, kNew, kNew + 1, true);
+
+    // Counts of the cells in lower planes that have occupied cells of
+    // the new plane as neighbors. (Normally, a new plane is empty, so
+    // there are none of these.)
+    CellInds ci(0, 0, kNew), ciNeigh;
+
+    for (ci.i = imin; ci.i < imaxP1; ++(ci.i)) {
+      for (ci.j = jmin; ci.j < jmaxP1; ++(ci.j)) {
+
+        if (self_->getInt(ci, ncItr->occupancyInt) != 0) {
+
+          for (std::vector<CellIndsOffset>::const_iterator itr = ncItr->reversedOffsets.begin(),
+                 itrEnd = ncItr->reversedOffsets.end(); itr != itrEnd; ++itr) {
+
+            ciNeigh = ci + *itr;
+
+            if ((ciNeigh.k >= 0) && (ciNeigh.k < kNew) && isInLocalArrays_(ciNeigh)) {
+              setNeighborCountOfCell_(ciNeigh, ncItr->countInt, self_->getInt(ciNeigh, ncItr->countInt) + 1);
+            }
+          }
+
+        }
+
+      }
+    }
   }
+
+}
+
+bool Lattice::Impl_::isInLocalArrays_(CellInds & ci) const {
+#if KMC_PARALLEL
+  KMC_CALL_MEMBER_FUNCTION(*this, wrapIndsIfNeeded_)(ci.i, ci.j);
+
+  return ((ci.i >= globalOffsetMinusGhostExtent_[0]) &&
+          (ci.i < globalOffsetMinusGhostExtent_[0] + extentWGhost_[0]) &&
+          (ci.j >= globalOffsetMinusGhostExtent_[1]) &&
+          (ci.j < globalOffsetMinusGhostExtent_[1] + extentWGhost_[1]));
+#else
+  // Any indices are in the local arrays once periodic boundary
+  // conditions are accounted for.
+  return true;
+#endif
 }
 
 void Lattice::Impl_::appendPlaneFake_() {
@@ -549,6 +756,7 @@ void Lattice::Impl_::appendPlaneWithExplicitEmpty_() {
 
 void Lattice::Impl_::appendPlaneAndRecordThatChangeOccurred_() {
   latticeModified_ = true;
+  lowestChangedPlane_ = std::min(lowestChangedPlane_, static_cast<int>(lattice_.size()));
   KMC_CALL_MEMBER_FUNCTION(*this, appendPlaneOnly_)();
 }
 
@@ -2356,6 +2564,94 @@ void Lattice::Impl_::reExportIfNeededActual_() {
     }
   }
 }
+
+void Lattice::Impl_::recountNeighborsOfRecvCells_(std::vector<std::vector<IJK> > & recvIndsBuffer) {
+
+  if (neighborCounts_.empty()) {
+    return;
+  }
+
+  /* The received values overwrite whole cells, neighbor counts
+     included, without going through setInt(), so the counts of the
+     received cells and of the cells that have them as neighbors are
+     recounted here from the occupancies now in the local arrays. The
+     cells whose counts change this way are treated as if they had
+     been received as well, so that their propensities get
+     updated. */
+
+  int currHeight = lattice_.size();
+  CellInds ci, ciNeigh;
+
+  std::size_t recvIndsBufferSize = recvIndsBuffer.size();
+
+  for (std::size_t bufType = 0; bufType < recvIndsBufferSize; ++bufType) {
+
+    std::vector<IJK> & currInds = recvIndsBuffer[bufType];
+    recountedCellInds_.clear();
+
+    for (std::vector<IJK>::const_iterator itr = currInds.begin(),
+           itrEnd = currInds.end(); itr != itrEnd; ++itr) {
+
+      ci.i = itr->i;
+      ci.j = itr->j;
+      ci.k = itr->k;
+
+      for (std::vector<NeighborCount_>::const_iterator ncItr = neighborCounts_.begin(),
+             ncItrEnd = neighborCounts_.end(); ncItr != ncItrEnd; ++ncItr) {
+
+        recountNeighborsIfAllAreLocal_(*ncItr, ci);
+
+        for (std::vector<CellIndsOffset>::const_iterator oItr = ncItr->reversedOffsets.begin(),
+               oItrEnd = ncItr->reversedOffsets.end(); oItr != oItrEnd; ++oItr) {
+
+          ciNeigh = ci + *oItr;
+
+          if ((ciNeigh.k >= 0) && (ciNeigh.k < currHeight) && isInLocalArrays_(ciNeigh) &&
+              recountNeighborsIfAllAreLocal_(*ncItr, ciNeigh)) {
+            recountedCellInds_.push_back(ciNeigh);
+          }
+        }
+      }
+    }
+
+    currInds.insert(currInds.end(), recountedCellInds_.begin(), recountedCellInds_.end());
+  }
+
+}
+
+bool Lattice::Impl_::recountNeighborsIfAllAreLocal_(const NeighborCount_ & nc, const CellInds & ci) {
+
+  // A ghost on the edge of the ghost region has neighbors outside of
+  // the local arrays, so its count is left as it was received from
+  // the processor that owns it.
+
+  int currHeight = lattice_.size();
+  int count = 0;
+  CellInds ciNeigh;
+
+  for (std::vector<CellIndsOffset>::const_iterator itr = nc.offsets.begin(),
+         itrEnd = nc.offsets.end(); itr != itrEnd; ++itr) {
+
+    ciNeigh = ci + *itr;
+
+    if (!isInLocalArrays_(ciNeigh)) {
+      return false;
+    }
+
+    if ((ciNeigh.k >= 0) && (ciNeigh.k < currHeight) &&
+        (self_->getInt(ciNeigh, nc.occupancyInt) != 0)) {
+      ++count;
+    }
+  }
+
+  if (count == self_->getInt(ci, nc.countInt)) {
+    return false;
+  }
+
+  setIntOnly_(ci, nc.countInt, count);
+
+  return true;
+}
 #endif
 
 Lattice::Lattice(const LatticeParams & paramsForLattice)
@@ -2440,7 +2736,12 @@ double Lattice::getFloat(const CellInds & ci, int whichFloat) const {
 }
 
 void Lattice::setInt(const CellInds & ci, int whichInt, int val) {
-  KMC_CALL_MEMBER_FUNCTION(*pImpl_, pImpl_->setInt_)(ci, whichInt, val);
+  if (pImpl_->neighborCounts_.empty()) {
+    KMC_CALL_MEMBER_FUNCTION(*pImpl_, pImpl_->setInt_)(ci, whichInt, val);
+  }
+  else {
+    pImpl_->setIntAndUpdateNeighborCounts_(ci, whichInt, val);
+  }
 }
 
 void Lattice::setFloat(const CellInds & ci, int whichFloat, double val) {
@@ -2481,6 +2782,8 @@ void Lattice::recvGhostsUpdate(int sectNum) {
                                          pImpl_->ghostRecvIntBuffer_,
                                          pImpl_->ghostRecvFloatBuffer_,
                                          pImpl_->ghostRecvBufferBounds_[sectNum]);
+
+  pImpl_->recountNeighborsOfRecvCells_(pImpl_->ghostRecvIndsBuffer_);
 #endif
 }
 
@@ -2507,6 +2810,10 @@ void Lattice::sendGhostsUpdate(int sectNum) {
                                          pImpl_->localRecvBufferBounds_[sectNum]);
 
   KMC_CALL_MEMBER_FUNCTION(*pImpl_, pImpl_->reExportIfNeeded_)();
+
+  // This comes after any re-exporting, since only the received cells
+  // themselves need to be re-exported.
+  pImpl_->recountNeighborsOfRecvCells_(pImpl_->localRecvIndsBuffer_);
 #endif
 }
 
@@ -2580,14 +2887,24 @@ void Lattice::trackChanges(TrackType::Type trackType) {
     abortWithMsg("Bad track type value");
   }
   
+  if (trackType == TrackType::RECORD_ONLY_OTHER_CHANGED_CELL_INDS) {
+    pImpl_->setNeighborCount_ = &Impl_::setIntAndRecordChangedCellInds_;
+  }
+  else {
+    pImpl_->setNeighborCount_ = pImpl_->setInt_;
+  }
+
   // Disregarding any calls to setInt or setFloat up to this point
   pImpl_->latticeModified_ = false;
+  pImpl_->lowestChangedPlane_ = std::numeric_limits<int>::max();
   pImpl_->changedCellInds_.clear();
   pImpl_->otherCheckedCellInds_.clear();
 }
 
 bool Lattice::hasChanged() const {return pImpl_->latticeModified_;}
 
+int Lattice::lowestChangedPlane() const {return pImpl_->lowestChangedPlane_;}
+
 const Lattice::ChangedCellInds & Lattice::getChangedCellInds() const {
   return pImpl_->changedCellInds_;
 }
@@ -2604,6 +2921,70 @@ void Lattice::wrapIndsIfNeeded(CellInds & ci) const {
 #endif
 }
 
+void Lattice::addNeighborCount(int occupancyInt, int countInt, const CellNeighOffsets & neighOffsets) {
+
+  exitOnCondition((occupancyInt < 0) || (occupancyInt >= nIntsPerCell()) ||
+                  (countInt < 0) || (countInt >= nIntsPerCell()),
+                  "Lattice::addNeighborCount error: Integer array element out of range.");
+
+  exitOnCondition(occupancyInt == countInt,
+                  "Lattice::addNeighborCount error: A neighbor count cannot be stored in the integer that it counts.");
+
+  for (std::vector<Impl_::NeighborCount_>::const_iterator itr = pImpl_->neighborCounts_.begin(),
+         itrEnd = pImpl_->neighborCounts_.end(); itr != itrEnd; ++itr) {
+    exitOnCondition((itr->countInt == countInt) || (itr->countInt == occupancyInt) ||
+                    (itr->occupancyInt == countInt),
+                    "Lattice::addNeighborCount error: Integer array element " +
+                    boost::lexical_cast<std::string>(countInt) + " conflicts with an existing neighbor count.");
+  }
+
+  Impl_::NeighborCount_ nc;
+  nc.occupancyInt = occupancyInt;
+  nc.countInt = countInt;
+
+  // Offset zero is always the cell itself, which is not its own neighbor.
+  int numOffsets = neighOffsets.numOffsets();
+  nc.offsets.reserve(numOffsets - 1);
+  nc.reversedOffsets.reserve(numOffsets - 1);
+
+  for (int i = 1; i < numOffsets; ++i) {
+    nc.offsets.push_back(neighOffsets.getOffset(i));
+    nc.reversedOffsets.push_back(-neighOffsets.getOffset(i));
+  }
+
+  pImpl_->neighborCounts_.push_back(nc);
+  pImpl_->neighborCountIndsOfInt_[occupancyInt].push_back(pImpl_->neighborCounts_.size() - 1);
+
+  pImpl_->countNeighbors_(nc, 0, currHeight(), true);
+
+#if KMC_PARALLEL
+  // The counts near the edges of the local part of the lattice may
+  // depend on ghosts that have not been received yet.
+  pImpl_->neighborCountsNeedRecount_ = true;
+#endif
+}
+
+void Lattice::recountNeighborsIfNeeded() {
+#if KMC_PARALLEL
+  if (pImpl_->neighborCountsNeedRecount_) {
+
+    // This assumes that the ghosts are already up to date.
+    for (std::vector<Impl_::NeighborCount_>::const_iterator itr = pImpl_->neighborCounts_.begin(),
+           itrEnd = pImpl_->neighborCounts_.end(); itr != itrEnd; ++itr) {
+      pImpl_->countNeighbors_(*itr, 0, currHeight(), false);
+    }
+
+    // The counts in the ghosts themselves come from the processors
+    // that own them.
+    for (int i = 0; i < numSectors(); ++i) {
+      recvGhosts(i);
+    }
+
+    pImpl_->neighborCountsNeedRecount_ = false;
+  }
+#endif
+}
+
 int Lattice::wrapI(const CellInds & ci) const {
   return wrapInd(ci.i, pImpl_->globalPlanarDims_[0]);
 }
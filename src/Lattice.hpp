@@ -17,6 +17,7 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "CellInds.hpp"
+#include "SortedVectorSet.hpp"
 
 // Note: This header file is documented via Doxygen
 // <http://www.doxygen.org>. Comments for Doxygen begin with '/*!' or
@@ -33,6 +34,8 @@ namespace KMCThinFilm {
   class Lattice; // Need to forward declare this for the sake of the
 		 // following typedefs.
 
+  class CellNeighOffsets;
+
   /*! Signature of a function or function object to be used to set the
       integers and floating-point numbers in an empty lattice cell to
       their proper values.
@@ -576,6 +579,61 @@ namespace KMCThinFilm {
      */
     void setFloat(const CellInds & ci, int whichInt, double val);
 
+    /*! Declares that integer array element <VAR>countInt</VAR> of
+        each lattice cell holds the number of that cell's neighbors
+        that are occupied, where a cell is considered occupied if its
+        integer array element <VAR>occupancyInt</VAR> is non-zero.
+
+      The neighbors of a cell at indices <VAR>ci</VAR> are the cells
+      at <VAR>ci</VAR> + <VAR>neighOffsets</VAR>.getOffset(n) for n
+      from 1 to <VAR>neighOffsets</VAR>.numOffsets() - 1. (The offset
+      with the integer ID of zero, i.e. the cell itself, is not
+      counted.) Neighbors above the top plane or below the bottom
+      plane of the lattice are treated as unoccupied.
+
+      When this is called, the counts are calculated for the whole
+      lattice. From then on, the lattice keeps them up to date
+      itself: whenever setInt() changes whether a cell is occupied,
+      the counts of the cells that have that cell as a neighbor are
+      incremented or decremented by one, and the counts of cells in
+      newly added planes are calculated when those planes are
+      added. Changes to the counts trigger updates of propensities
+      like changes to any other integer. A propensity function then
+      only needs to read the value of <VAR>countInt</VAR> at a cell
+      rather than probe each of the neighbors of that cell.
+
+      In a parallel simulation, the counts of the cells owned by a
+      processor are recounted whenever the occupancy of ghosts
+      bordering them is received from other processors. The counts
+      of ghosts themselves are only kept up to date as far as the
+      local part of the lattice allows, so a propensity function
+      should only read the count of the cell whose propensity it
+      calculates.
+
+      The example in <TT>doc/example-code/testFractal_neighbor_count</TT>
+      is a version of the fractal example that uses a neighbor count,
+      and checks the counts against a recount during the simulation.
+
+      This is typically called from within the LatticeInitializer
+      given by LatticeParams::latInit, either before or after the
+      occupancy of the lattice cells is set.
+
+      Note that the value of integer array element
+      <VAR>countInt</VAR> should never be set directly with setInt(),
+      and that in a parallel simulation, the offsets in
+      <VAR>neighOffsets</VAR> should not reach beyond the ghost region.
+     */
+    void addNeighborCount(int occupancyInt /*!< Integer array element
+                                              indicating whether a
+                                              cell is occupied. */,
+                          int countInt /*!< Integer array element
+                                          in which the number of
+                                          occupied neighbors is
+                                          stored. */,
+                          const CellNeighOffsets & neighOffsets /*!< Offsets to the
+                                                                   neighbors of a
+                                                                   cell. */);
+
     /*! Returns a wrapped version of ci.i to account for periodic
         boundary conditions.
 
@@ -687,16 +745,28 @@ namespace KMCThinFilm {
     };
     //! \endcond
 
-    // Using a std::set turns out to be faster than a
+    // An ordered set turns out to be faster than a
     // boost::unordered_set for the purposes of this library (probably
-    // because there are usually so few elements in ChangedCellInds).
-    typedef std::set<CellInds> ChangedCellInds;
+    // because there are usually so few elements in
+    // ChangedCellInds). A sorted vector is used rather than a
+    // std::set, and a vector rather than a std::deque, so that
+    // recording the changes made by an event doesn't allocate memory
+    // once these have grown to their working sizes.
+    typedef SortedVectorSet<CellInds> ChangedCellInds;
 
-    typedef std::deque<CellInds> OtherCheckedCellInds;
+    typedef std::vector<CellInds> OtherCheckedCellInds;
 
     void trackChanges(TrackType::Type trackType);
     bool hasChanged() const;
 
+    // Lowest value of ci.k among the cells changed since the last
+    // call to trackChanges(), or std::numeric_limits<int>::max() if
+    // there are none. Only meaningful when trackChanges() is given
+    // CHECK_ONLY_IF_CHANGE_OCCURS or RECORD_CHANGED_CELL_INDS.
+    int lowestChangedPlane() const;
+
+    void recountNeighborsIfNeeded();
+
     const ChangedCellInds & getChangedCellInds() const;
     const OtherCheckedCellInds & getOtherCheckedCellInds() const;
 
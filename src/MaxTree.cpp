@@ -0,0 +1,67 @@
+#include "MaxTree.hpp"
+
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+MaxTree::MaxTree()
+  : nodes_(2, 0), capacity_(1)
+{}
+
+void MaxTree::assign(const std::vector<double> & values) {
+
+  capacity_ = 1;
+  while (capacity_ < values.size()) {
+    capacity_ *= 2;
+  }
+
+  nodes_.assign(2*capacity_, 0);
+  std::copy(values.begin(), values.end(), nodes_.begin() + capacity_);
+
+  rebuild_();
+}
+
+void MaxTree::reserveSlots(std::size_t numSlots) {
+
+  if (numSlots <= capacity_) {
+    return;
+  }
+
+  std::size_t capacity = capacity_;
+  while (capacity < numSlots) {
+    capacity *= 2;
+  }
+
+  std::vector<double> newNodes(2*capacity, 0);
+  std::copy(nodes_.begin() + capacity_, nodes_.end(), newNodes.begin() + capacity);
+
+  nodes_.swap(newNodes);
+  capacity_ = capacity;
+
+  rebuild_();
+}
+
+void MaxTree::rebuild_() {
+  for (std::size_t i = capacity_ - 1; i > 0; --i) {
+    nodes_[i] = std::max(nodes_[2*i], nodes_[2*i + 1]);
+  }
+}
+
+void MaxTree::setValue(std::size_t slotInd, double v) {
+
+  std::size_t nodeInd = capacity_ + slotInd;
+  nodes_[nodeInd] = v;
+
+  // Once an ancestor's maximum is unchanged, so are those of all the
+  // ancestors above it, so the walk up the tree can stop early.
+  for (nodeInd /= 2; nodeInd > 0; nodeInd /= 2) {
+    double newMax = std::max(nodes_[2*nodeInd], nodes_[2*nodeInd + 1]);
+
+    if (newMax == nodes_[nodeInd]) {
+      break;
+    }
+
+    nodes_[nodeInd] = newMax;
+  }
+
+}
@@ -0,0 +1,45 @@
+#ifndef MAX_TREE_HPP
+#define MAX_TREE_HPP
+
+#include <vector>
+#include <cstddef>
+
+namespace KMCThinFilm {
+
+  // A binary tree over an array of non-negative values, in which
+  // each internal node holds the maximum of its children, so that the
+  // maximum of all the values is always available in O(1) time, and
+  // changing a value takes O(log N) time at worst.
+  class MaxTree {
+  public:
+    MaxTree();
+
+    // Replaces the values and rebuilds the tree in O(N) time.
+    void assign(const std::vector<double> & values);
+
+    // Grows the number of slots to at least numSlots, with the new
+    // slots having value zero. Existing values are kept.
+    void reserveSlots(std::size_t numSlots);
+
+    std::size_t numSlots() const {return capacity_;}
+
+    double value(std::size_t slotInd) const {return nodes_[capacity_ + slotInd];}
+
+    void setValue(std::size_t slotInd, double v);
+
+    double max() const {return nodes_[1];}
+
+    std::size_t memoryUsage() const {return nodes_.capacity()*sizeof(double);}
+
+  private:
+    // One-based heap, with the leaves in [capacity_, 2*capacity_)
+    // and the number of leaves always being a power of two.
+    std::vector<double> nodes_;
+    std::size_t capacity_;
+
+    void rebuild_();
+  };
+
+}
+
+#endif /* MAX_TREE_HPP */
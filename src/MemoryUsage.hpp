@@ -0,0 +1,74 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstddef>
+
+namespace KMCThinFilm {
+
+  // Estimates of the heap memory held by standard containers, for
+  // use in implementations of Solver::memoryUsage(). These count the
+  // elements (or, for vectors, the reserved capacity) but not the
+  // allocator's own bookkeeping.
+
+  template<typename T, typename A>
+  std::size_t memoryUsageOf(const std::vector<T,A> & v) {
+    return v.capacity()*sizeof(T);
+  }
+
+  template<typename T, typename A>
+  std::size_t memoryUsageOf(const std::deque<T,A> & d) {
+    // Ignores partially filled blocks and the map of blocks.
+    return d.size()*sizeof(T);
+  }
+
+  template<typename K, typename V, typename C, typename A>
+  std::size_t memoryUsageOf(const std::map<K,V,C,A> & m) {
+    // A node of a red-black tree holds its value along with a color
+    // and pointers to its parent and two children.
+    return m.size()*(sizeof(typename std::map<K,V,C,A>::value_type) + 4*sizeof(void*));
+  }
+
+  template<typename T, typename A>
+  std::size_t memoryUsageOf(const std::vector<std::vector<T,A> > & v) {
+    std::size_t numBytes = v.capacity()*sizeof(std::vector<T,A>);
+
+    for (typename std::vector<std::vector<T,A> >::const_iterator itr = v.begin(),
+	   itrEnd = v.end(); itr != itrEnd; ++itr) {
+      numBytes += memoryUsageOf(*itr);
+    }
+
+    return numBytes;
+  }
+
+  template<typename T, typename A>
+  std::size_t memoryUsageOf(const std::vector<std::deque<T,A> > & v) {
+    std::size_t numBytes = v.capacity()*sizeof(std::deque<T,A>);
+
+    for (typename std::vector<std::deque<T,A> >::const_iterator itr = v.begin(),
+	   itrEnd = v.end(); itr != itrEnd; ++itr) {
+      numBytes += memoryUsageOf(*itr);
+    }
+
+    return numBytes;
+  }
+
+  // For vectors of classes that have their own memoryUsage() member
+  // function, such as MaxTree and FenwickTree.
+  template<typename T>
+  std::size_t memoryUsageOfEach(const std::vector<T> & v) {
+    std::size_t numBytes = v.capacity()*sizeof(T);
+
+    for (typename std::vector<T>::const_iterator itr = v.begin(),
+	   itrEnd = v.end(); itr != itrEnd; ++itr) {
+      numBytes += itr->memoryUsage();
+    }
+
+    return numBytes;
+  }
+
+}
+
+#endif /* MEMORY_USAGE_HPP */
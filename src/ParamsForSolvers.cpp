@@ -0,0 +1,67 @@
+#include "ParamsForSolvers.hpp"
+
+#include <map>
+
+using namespace KMCThinFilm;
+
+struct SolverParams::Impl_ {
+
+  typedef std::map<SolverParam::Type, double> ParamMap_;
+  ParamMap_ paramMap_;
+
+  bool get_(SolverParam::Type paramName, double & paramVal) const {
+    ParamMap_::const_iterator itr = paramMap_.find(paramName);
+
+    if (itr != paramMap_.end()) {
+      paramVal = itr->second;
+      return true;
+    }
+    else {
+      return false;
+    }
+
+  }
+
+};
+
+SolverParams::SolverParams()
+  : pImpl_(new Impl_)
+{}
+
+SolverParams::SolverParams(const SolverParams & params)
+  : pImpl_(new Impl_(*(params.pImpl_)))
+{}
+
+SolverParams & SolverParams::operator=(const SolverParams & rhs) {
+
+  if (this != &rhs) {
+    *pImpl_ = *(rhs.pImpl_);
+  }
+
+  return *this;
+}
+
+SolverParams::~SolverParams() {}
+
+void SolverParams::setParam(SolverParam::Type paramName, double paramVal) {
+  pImpl_->paramMap_[paramName] = paramVal;
+}
+
+double SolverParams::getParamIfAvailable(SolverParam::Type paramName,
+					 bool & isAvailable) const {
+  double retVal = -1.0; // Initializing to some default value. Doesn't
+			// matter what the value is.
+  isAvailable = pImpl_->get_(paramName, retVal);
+  return retVal;
+}
+
+double SolverParams::getParamOrReturnDefaultVal(SolverParam::Type paramName,
+						double defaultVal) const {
+  double retVal;
+  if (pImpl_->get_(paramName, retVal)) {
+    return retVal;
+  }
+  else {
+    return defaultVal;
+  }
+}
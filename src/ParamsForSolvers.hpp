@@ -0,0 +1,161 @@
+#ifndef PARAMS_FOR_SOLVERS_HPP
+#define PARAMS_FOR_SOLVERS_HPP
+
+// This file is named ParamsForSolvers.hpp rather than SolverParams.hpp
+// because the Doxygen documentation excludes files with the pattern
+// "Solver*.hpp".
+
+#include <boost/scoped_ptr.hpp>
+
+/*!\file
+  \brief Defines the SolverParams class and the SolverParam::Type enumeration
+ */
+
+namespace KMCThinFilm {
+
+  /*! Namespace to enclose the SolverParam::Type enumeration */
+  namespace SolverParam {
+
+    /*! Optional parameters that modify the behavior of a solver, or
+        of how the simulation uses it. A solver ignores parameters
+        that do not apply to it. */
+    enum Type {
+      PROPENSITY_CLASS_RATIO /*!< If set to a value <VAR>r</VAR>
+                                greater than one, then
+                                SolverId::DYNAMIC_SCHULZE groups
+                                possible events into classes whose
+                                propensities lie in the interval
+                                \f$[r^n, r^{n+1})\f$ for some integer
+                                <VAR>n</VAR>, rather than into
+                                classes of exactly equal
+                                propensity. A class is chosen with
+                                probability proportional to the sum
+                                of the propensities in it, and an
+                                event within the class is chosen
+                                exactly by rejection, at an expected
+                                cost of at most <VAR>r</VAR>
+                                trials. This keeps the number of
+                                classes small for models whose
+                                propensities vary continuously, which
+                                would otherwise have nearly one class
+                                per possible event. */,
+
+      AGGREGATE_EVENTS_PER_CELL /*!< If set to a nonzero value, then
+                                   instead of giving the solver one
+                                   entry for each cell-centered event
+                                   at each lattice cell, the
+                                   simulation gives it one entry per
+                                   cell, whose propensity is the sum
+                                   of the propensities of all the
+                                   cell-centered events at that
+                                   cell. Once the solver chooses a
+                                   cell, one of the events at that
+                                   cell is chosen by a linear search
+                                   over their (recalculated)
+                                   propensities. This divides the
+                                   number of solver entries by the
+                                   number of cell-centered events,
+                                   and each update of a cell becomes
+                                   a single update of the solver, at
+                                   the cost of recalculating the
+                                   propensities of the chosen cell
+                                   once per step. This applies to
+                                   every type of solver. */,
+
+      ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS /*!< If set to a nonzero
+                                             value, then over-lattice
+                                             events, whose
+                                             propensities do not
+                                             change while the
+                                             simulation runs, are
+                                             kept out of the solver
+                                             and placed into a
+                                             Walker alias table that
+                                             is built once, from
+                                             which one of them is
+                                             chosen in constant
+                                             time. The solver then
+                                             only holds the
+                                             cell-centered events,
+                                             and the alias table is
+                                             chosen over the solver
+                                             with probability
+                                             proportional to the sum
+                                             of the over-lattice
+                                             propensities. This
+                                             applies to every type of
+                                             solver, including
+                                             custom ones. */,
+
+      SPATIALLY_ORDERED_LEAVES /*!< If set to a nonzero value, then
+                                  SolverId::BINARY_TREE arranges its
+                                  leaves so that the events of
+                                  nearby cells are near each other
+                                  in the tree, in the Morton
+                                  (Z-order) of the cell indices. The
+                                  propensities updated after an
+                                  event then share more ancestors
+                                  and cache lines in the tree. To
+                                  keep this order, a removed event
+                                  leaves a zero-propensity leaf
+                                  behind, which the event reclaims
+                                  if it becomes possible again, and
+                                  the leaves are sorted again once
+                                  there are enough such leaves or
+                                  newly added events. */
+    };
+
+  }
+
+  /*! Type of object used to store optional parameters of a solver.
+
+    \see Simulation::setSolver(SolverId::Type, const SolverParams &)
+   */
+  class SolverParams {
+  public:
+
+    //! \cond HIDE_FROM_DOXYGEN
+    SolverParams();
+
+    SolverParams(const SolverParams & params);
+    SolverParams & operator=(const SolverParams & rhs);
+    //! \endcond
+
+    /*! Sets a parameter of the solver. */
+    void setParam(SolverParam::Type paramName /*!< Name of parameter */,
+		  double paramVal /*!< Value of parameter */);
+
+    /*! Returns the value of the parameter, if it has been set.
+
+      It is not an error if the parameter was not set, but if it
+      wasn't, then the return value is likely garbage.
+     */
+    double getParamIfAvailable(SolverParam::Type paramName /*!< Name of parameter */,
+			       bool & isAvailable /*!< If this is
+                                                     false, then the
+                                                     parameter was not
+                                                     set.*/) const;
+
+    /*! Returns the value of the parameter if it has been set, and
+        returns a default value otherwise. */
+    double getParamOrReturnDefaultVal(SolverParam::Type paramName /*!< Name of parameter */,
+				      double defaultVal /*!< The value
+                                                           to be
+                                                           returned if
+                                                           the
+                                                           parameter
+                                                           was not
+                                                           set.*/) const;
+
+    //! \cond HIDE_FROM_DOXYGEN
+    ~SolverParams();
+    //! \endcond
+
+  private:
+    class Impl_;
+    boost::scoped_ptr<Impl_> pImpl_;
+  };
+
+}
+
+#endif /* PARAMS_FOR_SOLVERS_HPP */
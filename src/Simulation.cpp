@@ -5,6 +5,7 @@
 #include "EventId.hpp"
 #include "Lattice.hpp"
 #include "SolverFactory.hpp"
+#include "SolverWithRateScales.hpp"
 
 #include <vector>
 #include <deque>
@@ -14,6 +15,9 @@
 #include <map>
 #include <cmath>
 #include <algorithm>
+#include <functional>
+#include <utility>
+#include <limits>
 
 #include <boost/array.hpp>
 #include <boost/lexical_cast.hpp>
@@ -38,9 +42,84 @@ struct Simulation::Impl_ {
   bool rngIsSet_;
   bool runHasBeenExecuted_;
 
+  // Only the top activeLayerDepth_ planes are rebuilt if this is
+  // positive. Otherwise, the planes that are rebuilt are inferred
+  // from lowestActivePlane_ and reversedOffsetsMinK_.
+  int activeLayerDepth_;
+
+  // All cells below this plane have zero propensity for every
+  // cell-centered event.
+  int lowestActivePlane_;
+
+  // The most negative value of k among reversedOffsetsVec_ (or zero).
+  int reversedOffsetsMinK_;
+
+  // If true, the solver gets one entry per cell, holding the sum of
+  // the propensities of all the cell-centered events at that cell,
+  // and the event at a chosen cell is chosen by
+  // chooseCellCenEventInCell_().
+  bool aggregateEventsPerCell_;
+
+  // Set when the rate scale of a cell-centered or an over-lattice
+  // event changes, so that the event list is updated after the
+  // periodic actions if the change was made during a run.
+  bool cellCenRateScalesChanged_;
+  bool overLatticeRateScalesChanged_;
+
+  // These record what has changed since the event list was last
+  // built, so that run() rebuilds no more of it than it must. The
+  // first is false until the solver has an event list. The second is
+  // set when the cell-centered event groups change, and the third
+  // when the over-lattice events change, which only requires the
+  // over-lattice entries to be replaced.
+  bool eventListIsBuilt_;
+  bool cellCenteredEventsChanged_;
+  bool overLatticeEventsChanged_;
+
+  // Indices into cellCenEventVec_ of the cell-centered events that
+  // have been added or removed since the event list was last built.
+  // Using an *ordered* set because an unordered set affects the
+  // reproducibility of simulations.
+  std::set<std::size_t> changedCellCenEventVecInds_;
+
+  // The size of cellCenEventVec_ when the event list was last built.
+  // The entries of the event list can only be updated in place if
+  // this is unchanged, since the cell-centered event IDs depend on
+  // it.
+  std::size_t numCellCenEventsInEventList_;
+
+  // The propensity of each over-lattice entry in the event list, per
+  // sector and indexed as overLatticeEventVec_, with zero for an
+  // event that has no entry. Comparing these with the current
+  // propensities finds the entries that must be updated when the
+  // over-lattice events change between runs.
+  std::vector<std::vector<double> > overLatticePropensitiesInEventList_;
+
+  // True if the solver implements Solver::appendEventList(), which
+  // is used to update parts of the event list in place without
+  // rebuilding the rest of it from the lattice.
+  bool solverCanAppendEventList_;
+
+  // Largest value of solver_->memoryUsage() seen so far. Since the
+  // solvers release little memory between rebuilds of the event
+  // list, sampling it around the rebuilds and at the end of each run
+  // catches the peak.
+  std::size_t peakSolverMemoryUsage_;
+
+  void recordSolverMemoryUsage_() {
+    peakSolverMemoryUsage_ = std::max(peakSolverMemoryUsage_, solver_->memoryUsage());
+  }
+
   CellNeighProbe cellNeighProbe_;
   boost::scoped_ptr<Solver> solver_;
 
+  // The same object as solver_ if the solver applies the rate scales
+  // of the cell-centered events itself, and NULL otherwise, in which
+  // case the entries of the event list hold the scaled propensities.
+  SolverWithRateScales * rateScalingSolver_;
+
+  void passRateScalesToSolver_();
+
 #ifdef KMC_AVOID_BOOST_BIMAP
   typedef MultiIndexBimap<int,std::size_t> IdIndexBimap_;
 #else
@@ -57,6 +136,11 @@ struct Simulation::Impl_ {
   std::vector<LatticePlanarBBox> sectorPlanarBBox_;
   LatticePlanarBBox localPlanarBBox_;
 
+  // Maps cell-centered events to their event IDs, relative to
+  // localPlanarBBox_. Set at the start of each run, and passed on to
+  // the solver.
+  EventIdFlattening eIdFlattening_;
+
   SimulationState simState_;
 
   struct CellCenteredGroupPropensities_ {
@@ -64,6 +148,9 @@ struct Simulation::Impl_ {
     std::vector<std::size_t> eventVecInds_;
     CellCenteredGroupPropensities propensities_;
 
+    // Indexed in the same way as eventVecInds_
+    std::vector<double> rateScales_;
+
     CellCenteredGroupPropensities_(const CellNeighOffsets & cno,
                                    CellCenteredGroupPropensities propensities);
   };
@@ -123,6 +210,7 @@ struct Simulation::Impl_ {
 
   struct OverLatticeEvent_ {
     std::vector<double> propensity_;
+    double rateScale_;
     EventExecutor_ execute_;
     
     OverLatticeEvent_(double propensityPerUnitArea,
@@ -146,14 +234,20 @@ struct Simulation::Impl_ {
 
       if ((simState.elapsed_time_ >= timeForNextAction_) ||
 	  (doAtSimEnd_ && (simState.elapsedTime() >= simState.maxTime()))) {
-
-	timeForNextAction_ += period_;
-
-	action_(simState, lattice);
+	doAction(simState, lattice);
       }
 
     }
 
+    void doAction(const SimulationState & simState,
+		  Lattice & lattice) {
+      timeForNextAction_ += period_;
+      action_(simState, lattice);
+    }
+
+    double nextKey() const {return timeForNextAction_;}
+    bool doAtSimEnd() const {return doAtSimEnd_;}
+
   private:
     double period_, timeForNextAction_;
     bool doAtSimEnd_;
@@ -176,20 +270,87 @@ struct Simulation::Impl_ {
 
       if ((simState.numGlobalSteps() >= nStepsForNextAction_) ||
 	  (doAtSimEnd_ && (simState.elapsedTime() >= simState.maxTime()))) {
-
-	nStepsForNextAction_ += period_;
-
-	action_(simState, lattice);
+	doAction(simState, lattice);
       }
 
     }
 
+    void doAction(const SimulationState & simState,
+		  Lattice & lattice) {
+      nStepsForNextAction_ += period_;
+      action_(simState, lattice);
+    }
+
+    unsigned long long nextKey() const {return nStepsForNextAction_;}
+    bool doAtSimEnd() const {return doAtSimEnd_;}
+
   private:
     unsigned long long period_, nStepsForNextAction_;
     bool doAtSimEnd_;
     PeriodicAction action_;
   };
 
+  // Min-heap of the periodic actions in actionVec, keyed on the
+  // time or step at which each is next due, so that the main loop
+  // only has to compare the current time and step against the tops
+  // of the heaps. Ties are broken by the index into actionVec, and
+  // due actions are executed in the order of actionVec, as they would
+  // be by looping over actionVec.
+  template <typename PeriodicActionT, typename KeyT>
+  class PeriodicActionSchedule_ {
+  public:
+    PeriodicActionSchedule_(std::vector<PeriodicActionT> * actionVec)
+      : actionVec_(actionVec)
+    {}
+
+    // Must be called whenever actionVec changes.
+    void rebuild() {
+      heap_.clear();
+      heap_.reserve(actionVec_->size());
+
+      for (std::size_t i = 0; i < actionVec_->size(); ++i) {
+        heap_.push_back(Entry_((*actionVec_)[i].nextKey(), i));
+      }
+
+      std::make_heap(heap_.begin(), heap_.end(), std::greater<Entry_>());
+    }
+
+    bool isDue(KeyT now) const {
+      return (!heap_.empty()) && (heap_.front().first <= now);
+    }
+
+    void doDueActions(KeyT now,
+                      const SimulationState & simState,
+                      Lattice & lattice) {
+
+      dueInds_.clear();
+
+      while (isDue(now)) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry_>());
+        dueInds_.push_back(heap_.back().second);
+        heap_.pop_back();
+      }
+
+      std::sort(dueInds_.begin(), dueInds_.end());
+
+      for (std::vector<std::size_t>::const_iterator itr = dueInds_.begin(),
+             itrEnd = dueInds_.end(); itr != itrEnd; ++itr) {
+        PeriodicActionT & action = (*actionVec_)[*itr];
+        action.doAction(simState, lattice);
+
+        heap_.push_back(Entry_(action.nextKey(), *itr));
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry_>());
+      }
+    }
+
+  private:
+    typedef std::pair<KeyT, std::size_t> Entry_;
+
+    std::vector<PeriodicActionT> * actionVec_;
+    std::vector<Entry_> heap_;
+    std::vector<std::size_t> dueInds_; // Workspace for doDueActions()
+  };
+
   Lattice::TrackType::Type changeTrackingForPeriodicAction_;
 
   std::vector<CellCenteredGroupPropensities_> cellCenGroupPropensitiesVec_;
@@ -198,10 +359,18 @@ struct Simulation::Impl_ {
   std::vector<TimePeriodicAction_> timePeriodicActionVec_;
   std::vector<StepPeriodicAction_> stepPeriodicActionVec_;
 
+  PeriodicActionSchedule_<TimePeriodicAction_, double> timePeriodicActionSchedule_;
+  PeriodicActionSchedule_<StepPeriodicAction_, unsigned long long> stepPeriodicActionSchedule_;
+
+  // True if any periodic action is to be done at the end of a run.
+  bool periodicActionsAtSimEnd_;
+
   std::deque<std::size_t> freeCellCenEventVecInds_;
 
   std::vector<CellIndsOffset> reversedOffsetsVec_;
 
+  const Lattice::OtherCheckedCellInds noOtherCheckedCellInds_; // Always empty
+
   std::size_t bimapIdToIndex_(int id,
 			      const IdIndexBimap_ & idIndexBimap,
 			      const std::string & callingFunc,
@@ -259,9 +428,25 @@ struct Simulation::Impl_ {
   void updateEventAndAddrMapsAfterPeriodicActionsWTrack_();
   void updateEventAndAddrMapsAfterPeriodicActionsNoTrack_();
 
+  void schedulePeriodicActions_();
+
+  bool periodicActionsAreDue_() const {
+    return (timePeriodicActionSchedule_.isDue(simState_.elapsed_time_) ||
+            stepPeriodicActionSchedule_.isDue(simState_.num_global_steps_) ||
+            (periodicActionsAtSimEnd_ && (simState_.elapsedTime() >= simState_.maxTime())) ||
+            cellCenRateScalesChanged_ || overLatticeRateScalesChanged_);
+  }
+
   void runPeriodicActions_();
 
-  void rebuildEventAndAddrMaps_();
+  int lowestPlaneToRebuild_(int lowestChangedPlane) const;
+  void rebuildEventAndAddrMaps_(int kmin);
+  void rebuildOverLatticeEntriesOfEventList_();
+  void updateOverLatticeEntriesOfEventList_();
+  void updateChangedCellCenteredEntriesOfEventList_();
+  void updateEventListForRateScales_();
+  void addOverLatticeEntriesToEventList_(int sectNum);
+  void updateEventListForRun_();
 
   void run_(double maxTime);
 
@@ -273,10 +458,54 @@ struct Simulation::Impl_ {
                                            // vector for calculating
                                            // propensities.
 
+  // Workspace vectors for chooseCellCenEventInCell_()
+  std::vector<double> cellPropensityPartialSums_;
+  std::vector<std::size_t> cellEventVecInds_;
+
+  std::size_t chooseCellCenEventInCell_(const CellInds & ci);
+
+  void applyRateScales_(const CellCenteredGroupPropensities_ & ccgp) {
+    if (rateScalingSolver_ != NULL) {
+      return;
+    }
+
+    const std::vector<double> & rateScales = ccgp.rateScales_;
+    for (std::size_t i = 0; i < rateScales.size(); ++i) {
+      tmpPropensitiesVec_[i] *= rateScales[i];
+    }
+  }
+
+  // Puts the propensities of the events of ccgp at ci into
+  // tmpPropensitiesVec_, scaled unless the solver scales them.
+  void calcGroupPropensities_(const CellInds & ci,
+                              const CellCenteredGroupPropensities_ & ccgp) {
+
+    std::size_t eventVecIndsSize = ccgp.eventVecInds_.size();
+
+    // This ensures that all entries in tmpPropensitiesVec_ are initialized to zero.
+    tmpPropensitiesVec_.clear();
+    tmpPropensitiesVec_.resize(eventVecIndsSize, 0.0);
+
+    cellNeighProbe_.attachCellInds(&ci, &(ccgp.cioVec_));
+    ccgp.propensities_(cellNeighProbe_, tmpPropensitiesVec_);
+    applyRateScales_(ccgp);
+
+    if (ci.k < lowestActivePlane_) {
+      for (std::size_t i = 0; i < eventVecIndsSize; ++i) {
+        if (tmpPropensitiesVec_[i] > 0) {
+          lowestActivePlane_ = ci.k;
+          break;
+        }
+      }
+    }
+  }
+
   template<typename T>
   void doForCellCenteredGroupPropensities_(const CellInds & ci,
                                            int sectNum,
                                            const T & solverFunc) {
+
+    double cellPropensity = 0;
   
     for (std::vector<CellCenteredGroupPropensities_>::const_iterator ccGPropItr = cellCenGroupPropensitiesVec_.begin(),
            ccGPropItrEnd = cellCenGroupPropensitiesVec_.end(); ccGPropItr != ccGPropItrEnd; ++ccGPropItr) {
@@ -284,34 +513,65 @@ struct Simulation::Impl_ {
 
       std::size_t eventVecIndsSize = eventVecInds.size();
 
-      // This ensures that all entries in tmpPropensitiesVec_ are initialized to zero.
-      tmpPropensitiesVec_.clear();
-      tmpPropensitiesVec_.resize(eventVecIndsSize, 0.0);
-            
-      cellNeighProbe_.attachCellInds(&ci, &(ccGPropItr->cioVec_));
-      ccGPropItr->propensities_(cellNeighProbe_, tmpPropensitiesVec_);
+      calcGroupPropensities_(ci, *ccGPropItr);
 
-      for (std::size_t i = 0; i < eventVecIndsSize; ++i) {
-        solverFunc(*solver_, ci, eventVecInds[i], tmpPropensitiesVec_[i], sectNum);
+      if (aggregateEventsPerCell_) {
+        for (std::size_t i = 0; i < eventVecIndsSize; ++i) {
+          cellPropensity += tmpPropensitiesVec_[i];
+        }
+      }
+      else {
+        for (std::size_t i = 0; i < eventVecIndsSize; ++i) {
+          solverFunc(*solver_, ci, eventVecInds[i], tmpPropensitiesVec_[i], sectNum);
+        }
       }
     }
 
+    if (aggregateEventsPerCell_) {
+      solverFunc(*solver_, ci, 0, cellPropensity, sectNum);
+    }
+
   }
 
   // Function objects for use with doForCellCenteredGroupPropensities_:
 
   struct AddOrUpdateCellCenteredEntryToEventList_ {
+    const EventIdFlattening & eIdFlattening;
+
+    AddOrUpdateCellCenteredEntryToEventList_(const EventIdFlattening & myEIdFlattening)
+      : eIdFlattening(myEIdFlattening)
+    {}
+
     void operator()(Solver & solver,
                     const CellInds & ci,
                     std::size_t eventVecInd,
                     double propensity,
                     int sectNum) const {
-      solver.addOrUpdateCellCenteredEntryToEventList(EventId(ci, eventVecInd),
+      solver.addOrUpdateCellCenteredEntryToEventList(eIdFlattening.eventId(ci, eventVecInd),
                                                      propensity, sectNum);
     }
   } addOrUpdateCellCenteredEntryToEventList_;
 
-  struct AddCellCenteredEntryToEventList_ {
+  // Collects the cell-centered entries of a rebuild into the
+  // vectors eIds and propensities, which are passed to the solver in
+  // batches, so that the solver can build its event list from a
+  // batch at a time (see Solver::addCellCenteredEntriesToEventList()).
+  struct CollectCellCenteredEntriesForEventList_ {
+
+    // Large enough that the per-batch work of a solver is negligible,
+    // and small enough that a batch fits into the cache.
+    static const std::size_t BATCH_SIZE = 4096;
+
+    const EventIdFlattening & eIdFlattening;
+    std::vector<EventId> & eIds;
+    std::vector<double> & propensities;
+
+    CollectCellCenteredEntriesForEventList_(const EventIdFlattening & myEIdFlattening,
+                                            std::vector<EventId> & myEIds,
+                                            std::vector<double> & myPropensities)
+      : eIdFlattening(myEIdFlattening), eIds(myEIds), propensities(myPropensities)
+    {}
+
     void operator()(Solver & solver,
                     const CellInds & ci,
                     std::size_t eventVecInd,
@@ -319,12 +579,36 @@ struct Simulation::Impl_ {
                     int sectNum) const {
 
       if (propensity > 0) {
-        solver.addCellCenteredEntryToEventList(EventId(ci, eventVecInd),
-                                               propensity, sectNum);
+        add(solver, eIdFlattening.eventId(ci, eventVecInd), propensity, sectNum);
+      }
+
+    }
+
+    void add(Solver & solver,
+             const EventId & eId,
+             double propensity,
+             int sectNum) const {
+
+      eIds.push_back(eId);
+      propensities.push_back(propensity);
+
+      if (eIds.size() == BATCH_SIZE) {
+        flush(solver, sectNum);
       }
+    }
 
+    void flush(Solver & solver, int sectNum) const {
+      if (!eIds.empty()) {
+        solver.addCellCenteredEntriesToEventList(eIds, propensities, sectNum);
+        eIds.clear();
+        propensities.clear();
+      }
     }
-  } addCellCenteredEntryToEventList_;
+  };
+
+  // Workspace vectors for CollectCellCenteredEntriesForEventList_
+  std::vector<EventId> batchEIds_;
+  std::vector<double> batchPropensities_;
 
   void updateEventAndAddrMapsFromChangedCell_(int currHeight, const CellInds & ci);
 
@@ -352,7 +636,8 @@ Simulation::Impl_::CellCenteredGroupPropensities_::CellCenteredGroupPropensities
 Simulation::Impl_::OverLatticeEvent_::OverLatticeEvent_(double propensityPerUnitArea,
 							const std::vector<LatticePlanarBBox> & sectorPlanarBBox,
 							EventExecutor_ eventExecutor)
-  : execute_(eventExecutor) {
+  : rateScale_(1),
+    execute_(eventExecutor) {
   
   propensity_.reserve(sectorPlanarBBox.size());
 
@@ -446,6 +731,17 @@ void Simulation::Impl_::RunEventExecutor_::operator()(EventExecutorSemiManualTra
                                                           impl_->lattice_.getOtherCheckedCellInds());
   }
 
+  // Neighbor counts kept by the lattice (see
+  // Lattice::addNeighborCount()) are not changed via the
+  // CellsToChange objects, so the lattice records the cells where
+  // they changed.
+  const Lattice::ChangedCellInds & neighborCountChanges = impl_->lattice_.getChangedCellInds();
+
+  if (!neighborCountChanges.empty()) {
+    impl_->updateEventAndAddrMapsFromChangedCellInds_(neighborCountChanges,
+                                                      impl_->noOtherCheckedCellInds_);
+  }
+
   impl_->lattice_.trackChanges(Lattice::TrackType::NONE);
 }
 
@@ -454,10 +750,28 @@ Simulation::Impl_::Impl_(const LatticeParams & paramsForLattice)
     tIncrSchemeIsSet_(false),
     rngIsSet_(false),
     runHasBeenExecuted_(false),
+    activeLayerDepth_(0),
+    lowestActivePlane_(0),
+    reversedOffsetsMinK_(0),
+    aggregateEventsPerCell_(false),
+    cellCenRateScalesChanged_(false),
+    overLatticeRateScalesChanged_(false),
+    eventListIsBuilt_(false),
+    cellCenteredEventsChanged_(true),
+    overLatticeEventsChanged_(true),
+    numCellCenEventsInEventList_(0),
+    solverCanAppendEventList_(false),
+    peakSolverMemoryUsage_(0),
     cellNeighProbe_(&lattice_),
-    runEventExecutor_(this) {
+    rateScalingSolver_(NULL),
+    runEventExecutor_(this),
+    timePeriodicActionSchedule_(&timePeriodicActionVec_),
+    stepPeriodicActionSchedule_(&stepPeriodicActionVec_),
+    periodicActionsAtSimEnd_(false),
+    addOrUpdateCellCenteredEntryToEventList_(eIdFlattening_) {
 
   sectorPlanarBBox_.resize(lattice_.numSectors());
+  overLatticePropensitiesInEventList_.resize(lattice_.numSectors());
 
   lattice_.getLocalPlanarBBox(false, localPlanarBBox_);
 
@@ -487,6 +801,8 @@ std::size_t Simulation::Impl_::bimapIdToIndex_(int id,
 
 void Simulation::Impl_::removeCellCenteredEventGroup_(int eventGroupId, const std::string & callingFunc) {
 
+  cellCenteredEventsChanged_ = true;
+
   std::size_t indexToBeOverwritten = bimapIdToIndex_(eventGroupId,
                                                      cellCenGroupPropensitiesIdIndexBimap_,
                                                      callingFunc,
@@ -502,6 +818,7 @@ void Simulation::Impl_::removeCellCenteredEventGroup_(int eventGroupId, const st
 
     for (std::vector<std::size_t>::const_iterator itr = ccgp.eventVecInds_.begin(),
            itrEnd = ccgp.eventVecInds_.end(); itr != itrEnd; ++itr) {
+      changedCellCenEventVecInds_.insert(*itr);
       freeCellCenEventVecInds_.push_back(*itr);
       boost::apply_visitor(clearEventExecutor_, cellCenEventVec_[freeCellCenEventVecInds_.back()]);
     }
@@ -549,9 +866,12 @@ void Simulation::Impl_::mkReversedOffsets_() {
   reversedOffsetsVec_.clear();  
   reversedOffsetsVec_.reserve(reversedOffsetsSet.size());
 
+  reversedOffsetsMinK_ = 0;
+
   for (std::set<CellIndsOffset>::const_iterator itr = reversedOffsetsSet.begin(),
 	 itrEnd = reversedOffsetsSet.end(); itr != itrEnd; ++itr) {
     reversedOffsetsVec_.push_back(*itr);
+    reversedOffsetsMinK_ = std::min(reversedOffsetsMinK_, itr->k);
   }
 
 }
@@ -675,7 +995,35 @@ void Simulation::Impl_::updateEventAndAddrMapsFromAffectedCellOffsets_(const Cel
 
 }
 
-void Simulation::Impl_::rebuildEventAndAddrMaps_() {
+int Simulation::Impl_::lowestPlaneToRebuild_(int lowestChangedPlane) const {
+
+  int kmin;
+
+  if (activeLayerDepth_ > 0) {
+    kmin = lattice_.currHeight() - activeLayerDepth_;
+  }
+  else {
+    // Cells below lowestActivePlane_ had no events before the lattice
+    // changed, and a changed cell can only affect the propensities of
+    // cells that are within the reach of the reversed offsets.
+    // (Note that reversedOffsetsMinK_ is never positive, so this
+    // doesn't overflow when lowestChangedPlane is the maximum integer.)
+    kmin = std::min(lowestActivePlane_, lowestChangedPlane + reversedOffsetsMinK_);
+  }
+
+  kmin = std::max(kmin, 0);
+
+#if KMC_PARALLEL
+  // Ghosts received during the rebuild may affect planes as low as
+  // those changed on other processors.
+  int kminLocal = kmin;
+  MPI_Allreduce(&kminLocal, &kmin, 1, MPI_INT, MPI_MIN, lattice_.comm());
+#endif
+
+  return kmin;
+}
+
+void Simulation::Impl_::rebuildEventAndAddrMaps_(int kmin) {
   
   int numSectors = lattice_.numSectors();
 
@@ -683,11 +1031,27 @@ void Simulation::Impl_::rebuildEventAndAddrMaps_() {
   for (int i = 0; i < numSectors; ++i) {
     lattice_.recvGhosts(i);
   }
+
+  lattice_.recountNeighborsIfNeeded();
 #endif
 
+  recordSolverMemoryUsage_();
+
+  // The rebuild picks up the current rate scales.
+  passRateScalesToSolver_();
+  cellCenRateScalesChanged_ = false;
+  overLatticeRateScalesChanged_ = false;
+
   solver_->beginBuildingEventList(overLatticeEventVec_.size(),
                                   lattice_.planesReserved());
 
+  eventListIsBuilt_ = true;
+  numCellCenEventsInEventList_ = cellCenEventVec_.size();
+
+  // Since the planes below kmin have no events, the lowest active
+  // plane is found by the rebuild itself.
+  lowestActivePlane_ = lattice_.currHeight();
+
   for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
 
     int kmaxP1 = lattice_.currHeight();
@@ -695,33 +1059,293 @@ void Simulation::Impl_::rebuildEventAndAddrMaps_() {
     CellInds ci;
     //std::vector<double> propensitiesVec;
 
-    for (ci.k = 0; ci.k < kmaxP1; ++(ci.k)) {
+    CollectCellCenteredEntriesForEventList_ collectEntries(eIdFlattening_, batchEIds_, batchPropensities_);
+
+    for (ci.k = kmin; ci.k < kmaxP1; ++(ci.k)) {
       for (ci.i = sectorPlanarBBox_[sectNum].imin; ci.i < sectorPlanarBBox_[sectNum].imaxP1; ++(ci.i)) {
         for (ci.j = sectorPlanarBBox_[sectNum].jmin; ci.j < sectorPlanarBBox_[sectNum].jmaxP1; ++(ci.j)) {
 
           doForCellCenteredGroupPropensities_(ci,
                                               sectNum,
-                                              addCellCenteredEntryToEventList_);
+                                              collectEntries);
 
         }
       }
     }
 
-    for (int overLatticeEventIndex = 0; overLatticeEventIndex < overLatticeEventVec_.size();
-	 ++overLatticeEventIndex) {
+    collectEntries.flush(*solver_, sectNum);
+
+    addOverLatticeEntriesToEventList_(sectNum);
+  }
+
+  solver_->endBuildingEventList();
+
+  recordSolverMemoryUsage_();
+}
+
+void Simulation::Impl_::addOverLatticeEntriesToEventList_(int sectNum) {
+
+  std::vector<double> & propensitiesInEventList = overLatticePropensitiesInEventList_[sectNum];
+  propensitiesInEventList.resize(overLatticeEventVec_.size());
+
+  for (int overLatticeEventIndex = 0; overLatticeEventIndex < overLatticeEventVec_.size();
+       ++overLatticeEventIndex) {
+
+    const OverLatticeEvent_ & overLatticeEvent = overLatticeEventVec_[overLatticeEventIndex];
+    double p = overLatticeEvent.rateScale_*overLatticeEvent.propensity_[sectNum];
+
+    propensitiesInEventList[overLatticeEventIndex] = p;
+
+    if (p > 0) {
+      EventId eId(overLatticeEventIndex, sectNum);
+      solver_->addOverLatticeEntryToEventList(eId, p, sectNum);
+    }
+  }
+
+}
+
+void Simulation::Impl_::rebuildOverLatticeEntriesOfEventList_() {
 
-      double p = overLatticeEventVec_[overLatticeEventIndex].propensity_[sectNum];
+  // The cell-centered entries are taken from the solver itself
+  // rather than from the lattice, which is much faster than
+  // recalculating their propensities.
 
-      if (p > 0) {
-	EventId eId(overLatticeEventIndex, sectNum);
-	solver_->addOverLatticeEntryToEventList(eId, p, sectNum);
+  int numSectors = lattice_.numSectors();
+
+  std::vector<std::vector<EventId> > eIdsPerSector(numSectors);
+  std::vector<std::vector<double> > propensitiesPerSector(numSectors);
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+    solver_->appendEventList(sectNum, eIdsPerSector[sectNum], propensitiesPerSector[sectNum]);
+  }
+
+  recordSolverMemoryUsage_();
+
+  solver_->beginBuildingEventList(overLatticeEventVec_.size(),
+                                  lattice_.planesReserved());
+
+  // The over-lattice entries are added with the current rate scales.
+  overLatticeRateScalesChanged_ = false;
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+
+    CollectCellCenteredEntriesForEventList_ collectEntries(eIdFlattening_, batchEIds_, batchPropensities_);
+
+    std::vector<EventId> & eIds = eIdsPerSector[sectNum];
+    std::vector<double> & propensities = propensitiesPerSector[sectNum];
+
+    for (std::size_t i = 0; i < eIds.size(); ++i) {
+      if (!eIds[i].isForOverLattice()) {
+        collectEntries.add(*solver_, eIds[i], propensities[i], sectNum);
       }
     }
- 
+
+    collectEntries.flush(*solver_, sectNum);
+
+    // Release the copy of this sector's event list as soon as
+    // possible, since the solver is now holding it again.
+    std::vector<EventId>().swap(eIds);
+    std::vector<double>().swap(propensities);
+
+    addOverLatticeEntriesToEventList_(sectNum);
   }
 
   solver_->endBuildingEventList();
 
+  recordSolverMemoryUsage_();
+}
+
+void Simulation::Impl_::updateOverLatticeEntriesOfEventList_() {
+
+  // Only the over-lattice entries whose propensities differ from
+  // those in the event list are passed to the solver, so the
+  // cell-centered entries are left alone. An event that has been
+  // removed, or that has moved to another index because a removed
+  // event took its place, shows up as such a difference.
+
+  int numSectors = lattice_.numSectors();
+  std::size_t numOverLatticeEvents = overLatticeEventVec_.size();
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+
+    std::vector<double> & propensitiesInEventList = overLatticePropensitiesInEventList_[sectNum];
+    std::size_t numEntriesToCheck = std::max(numOverLatticeEvents, propensitiesInEventList.size());
+    propensitiesInEventList.resize(numEntriesToCheck, 0);
+
+    for (std::size_t overLatticeEventIndex = 0; overLatticeEventIndex < numEntriesToCheck;
+         ++overLatticeEventIndex) {
+
+      double p = 0;
+      if (overLatticeEventIndex < numOverLatticeEvents) {
+        const OverLatticeEvent_ & overLatticeEvent = overLatticeEventVec_[overLatticeEventIndex];
+        p = overLatticeEvent.rateScale_*overLatticeEvent.propensity_[sectNum];
+      }
+
+      if (p != propensitiesInEventList[overLatticeEventIndex]) {
+
+        EventId eId(overLatticeEventIndex, sectNum);
+
+        if (!solver_->addOrUpdateOverLatticeEntryToEventList(eId, p, sectNum)) {
+          // The solver only takes over-lattice entries while the
+          // event list is built, as is the case for a custom solver
+          // that keeps the default Solver implementation. Rebuilding
+          // adds every over-lattice entry afresh, whichever of them
+          // were already updated.
+          if (solverCanAppendEventList_) {
+            rebuildOverLatticeEntriesOfEventList_();
+          }
+          else {
+            // The lattice has not changed, so lowestActivePlane_ is up to date.
+            rebuildEventAndAddrMaps_(lowestPlaneToRebuild_(std::numeric_limits<int>::max()));
+          }
+          return;
+        }
+
+        propensitiesInEventList[overLatticeEventIndex] = p;
+      }
+    }
+
+    propensitiesInEventList.resize(numOverLatticeEvents);
+  }
+
+  // The over-lattice entries now have the current rate scales.
+  overLatticeRateScalesChanged_ = false;
+}
+
+void Simulation::Impl_::updateChangedCellCenteredEntriesOfEventList_() {
+
+  // Only the entries of the events in changedCellCenEventVecInds_
+  // are touched. Their old entries are found from the solver itself,
+  // which also catches any that lie below the planes rebuilt below.
+
+  int numSectors = lattice_.numSectors();
+
+  std::vector<EventId> eIds;
+  std::vector<double> propensities;
+
+  CellInds ci;
+  int cellCenEventIndex;
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+
+    eIds.clear();
+    propensities.clear();
+    solver_->appendEventList(sectNum, eIds, propensities);
+
+    for (std::vector<EventId>::const_iterator itr = eIds.begin(),
+           itrEnd = eIds.end(); itr != itrEnd; ++itr) {
+
+      if (!itr->isForOverLattice()) {
+        eIdFlattening_.getEventInfo(*itr, ci, cellCenEventIndex);
+
+        if (changedCellCenEventVecInds_.count(cellCenEventIndex) > 0) {
+          solver_->addOrUpdateCellCenteredEntryToEventList(*itr, 0, sectNum);
+        }
+      }
+    }
+  }
+
+  recordSolverMemoryUsage_();
+
+  // A group is either wholly new or untouched, since the events of a
+  // group are added together.
+  std::vector<const CellCenteredGroupPropensities_ *> changedGroups;
+
+  for (std::vector<CellCenteredGroupPropensities_>::iterator ccGPropItr = cellCenGroupPropensitiesVec_.begin(),
+         ccGPropItrEnd = cellCenGroupPropensitiesVec_.end(); ccGPropItr != ccGPropItrEnd; ++ccGPropItr) {
+    if ((!ccGPropItr->eventVecInds_.empty()) &&
+        (changedCellCenEventVecInds_.count(ccGPropItr->eventVecInds_.front()) > 0)) {
+      changedGroups.push_back(&(*ccGPropItr));
+    }
+  }
+
+  if (changedGroups.empty()) {
+    return;
+  }
+
+  // A new group takes the indices of removed events, and so the rate
+  // scales that the solver applies to them must be replaced by those
+  // of the new group.
+  passRateScalesToSolver_();
+
+  // The same planes are covered as in a full rebuild, since a new
+  // group may have events below lowestActivePlane_.
+  int kmin = lowestPlaneToRebuild_(0);
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+
+    int kmaxP1 = lattice_.currHeight();
+
+    for (ci.k = kmin; ci.k < kmaxP1; ++(ci.k)) {
+      for (ci.i = sectorPlanarBBox_[sectNum].imin; ci.i < sectorPlanarBBox_[sectNum].imaxP1; ++(ci.i)) {
+        for (ci.j = sectorPlanarBBox_[sectNum].jmin; ci.j < sectorPlanarBBox_[sectNum].jmaxP1; ++(ci.j)) {
+
+          for (std::vector<const CellCenteredGroupPropensities_ *>::const_iterator gItr = changedGroups.begin(),
+                 gItrEnd = changedGroups.end(); gItr != gItrEnd; ++gItr) {
+
+            const std::vector<std::size_t> & eventVecInds = (*gItr)->eventVecInds_;
+
+            calcGroupPropensities_(ci, **gItr);
+
+            for (std::size_t i = 0; i < eventVecInds.size(); ++i) {
+              if (tmpPropensitiesVec_[i] > 0) {
+                solver_->addOrUpdateCellCenteredEntryToEventList(eIdFlattening_.eventId(ci, eventVecInds[i]),
+                                                                 tmpPropensitiesVec_[i], sectNum);
+              }
+            }
+          }
+
+        }
+      }
+    }
+  }
+
+  recordSolverMemoryUsage_();
+}
+
+void Simulation::Impl_::passRateScalesToSolver_() {
+
+  if (rateScalingSolver_ == NULL) {
+    return;
+  }
+
+  for (std::vector<CellCenteredGroupPropensities_>::const_iterator ccGPropItr = cellCenGroupPropensitiesVec_.begin(),
+         ccGPropItrEnd = cellCenGroupPropensitiesVec_.end(); ccGPropItr != ccGPropItrEnd; ++ccGPropItr) {
+
+    const std::vector<std::size_t> & eventVecInds = ccGPropItr->eventVecInds_;
+    const std::vector<double> & rateScales = ccGPropItr->rateScales_;
+
+    for (std::size_t i = 0; i < eventVecInds.size(); ++i) {
+      rateScalingSolver_->setRateScale(static_cast<int>(eventVecInds[i]), rateScales[i]);
+    }
+  }
+
+}
+
+void Simulation::Impl_::updateEventListForRateScales_() {
+
+  if (cellCenRateScalesChanged_) {
+    if (rateScalingSolver_ != NULL) {
+      // The solver multiplies the total propensity of each type of
+      // event by its rate scale, so no entries are touched.
+      passRateScalesToSolver_();
+      cellCenRateScalesChanged_ = false;
+    }
+    else {
+      // An aggregated entry holds the sum of the propensities of all
+      // the events at a cell, which cannot be rescaled event by
+      // event, and a custom solver doesn't apply rate scales itself.
+      // In either case, the planes that may have events are rebuilt,
+      // which picks up all the current rate scales.
+      rebuildEventAndAddrMaps_(lowestPlaneToRebuild_(std::numeric_limits<int>::max()));
+      return;
+    }
+  }
+
+  if (overLatticeRateScalesChanged_) {
+    updateOverLatticeEntriesOfEventList_();
+  }
+
 }
 
 void Simulation::Impl_::doPreRunChecks_() const {
@@ -787,7 +1411,11 @@ void Simulation::Impl_::executeEvent_(const EventId & chosenEventID) {
   else {
 
     int cellCenEventIndex;
-    chosenEventID.getEventInfo(runEventExecutor_.ci, cellCenEventIndex);
+    eIdFlattening_.getEventInfo(chosenEventID, runEventExecutor_.ci, cellCenEventIndex);
+
+    if (aggregateEventsPerCell_) {
+      cellCenEventIndex = chooseCellCenEventInCell_(runEventExecutor_.ci);
+    }
 
     EventExecutor_ & chosenEvent = cellCenEventVec_[cellCenEventIndex];
 
@@ -797,6 +1425,58 @@ void Simulation::Impl_::executeEvent_(const EventId & chosenEventID) {
   
 }
 
+std::size_t Simulation::Impl_::chooseCellCenEventInCell_(const CellInds & ci) {
+
+  // The propensities of the events at ci are recalculated here rather
+  // than stored, since storing them for every cell would undo the
+  // memory savings from aggregating them.
+
+  cellPropensityPartialSums_.clear();
+  cellEventVecInds_.clear();
+
+  double cellPropensity = 0;
+
+  for (std::vector<CellCenteredGroupPropensities_>::const_iterator ccGPropItr = cellCenGroupPropensitiesVec_.begin(),
+         ccGPropItrEnd = cellCenGroupPropensitiesVec_.end(); ccGPropItr != ccGPropItrEnd; ++ccGPropItr) {
+    const std::vector<std::size_t> & eventVecInds = ccGPropItr->eventVecInds_;
+
+    std::size_t eventVecIndsSize = eventVecInds.size();
+
+    tmpPropensitiesVec_.clear();
+    tmpPropensitiesVec_.resize(eventVecIndsSize, 0.0);
+
+    cellNeighProbe_.attachCellInds(&ci, &(ccGPropItr->cioVec_));
+    ccGPropItr->propensities_(cellNeighProbe_, tmpPropensitiesVec_);
+    applyRateScales_(*ccGPropItr);
+
+    for (std::size_t i = 0; i < eventVecIndsSize; ++i) {
+      if (tmpPropensitiesVec_[i] > 0) {
+        cellPropensity += tmpPropensitiesVec_[i];
+        cellPropensityPartialSums_.push_back(cellPropensity);
+        cellEventVecInds_.push_back(eventVecInds[i]);
+      }
+    }
+  }
+
+  exitOnCondition(cellEventVecInds_.empty(),
+                  "Solver chose a cell that has no possible cell-centered events");
+
+  double R = cellPropensity*(rng_->getNumInOpenIntervalFrom0To1());
+
+  // Defaulting to the last event in case roundoff makes R exceed the
+  // final partial sum.
+  std::size_t chosenInd = cellEventVecInds_.size() - 1;
+
+  for (std::size_t i = 0; i < cellPropensityPartialSums_.size(); ++i) {
+    if (R < cellPropensityPartialSums_[i]) {
+      chosenInd = i;
+      break;
+    }
+  }
+
+  return cellEventVecInds_[chosenInd];
+}
+
 void Simulation::Impl_::updateEventAndAddrMapsAfterPeriodicActionsWTrack_() {
 
   const Lattice::ChangedCellInds & ccInds = lattice_.getChangedCellInds();
@@ -880,61 +1560,153 @@ void Simulation::Impl_::updateEventAndAddrMapsAfterPeriodicActionsWTrack_() {
 }
 
 void Simulation::Impl_::updateEventAndAddrMapsAfterPeriodicActionsNoTrack_() {
-  rebuildEventAndAddrMaps_();
+  rebuildEventAndAddrMaps_(lowestPlaneToRebuild_(lattice_.lowestChangedPlane()));
 }
 
-void Simulation::Impl_::runPeriodicActions_() {
+void Simulation::Impl_::schedulePeriodicActions_() {
 
-  lattice_.trackChanges(changeTrackingForPeriodicAction_);
+  timePeriodicActionSchedule_.rebuild();
+  stepPeriodicActionSchedule_.rebuild();
 
-  for (std::vector<TimePeriodicAction_>::iterator itr = timePeriodicActionVec_.begin(),
+  periodicActionsAtSimEnd_ = false;
+
+  for (std::vector<TimePeriodicAction_>::const_iterator itr = timePeriodicActionVec_.begin(),
 	 itrEnd = timePeriodicActionVec_.end(); itr != itrEnd; ++itr) {
-    itr->doActionIfEndOfPeriod(simState_, lattice_);
+    periodicActionsAtSimEnd_ = periodicActionsAtSimEnd_ || itr->doAtSimEnd();
   }
 
-  for (std::vector<StepPeriodicAction_>::iterator itr = stepPeriodicActionVec_.begin(),
-	 itrEnd = stepPeriodicActionVec_.end(); itr != itrEnd; ++itr) {    
-    itr->doActionIfEndOfPeriod(simState_, lattice_);
+  for (std::vector<StepPeriodicAction_>::const_iterator itr = stepPeriodicActionVec_.begin(),
+	 itrEnd = stepPeriodicActionVec_.end(); itr != itrEnd; ++itr) {
+    periodicActionsAtSimEnd_ = periodicActionsAtSimEnd_ || itr->doAtSimEnd();
+  }
+
+}
+
+void Simulation::Impl_::runPeriodicActions_() {
+
+  lattice_.trackChanges(changeTrackingForPeriodicAction_);
+
+  if (simState_.elapsedTime() >= simState_.maxTime()) {
+
+    // At the end of a run, actions that are done at the end of a run
+    // are done along with those that are due, and so all of them are
+    // checked.
+
+    for (std::vector<TimePeriodicAction_>::iterator itr = timePeriodicActionVec_.begin(),
+	   itrEnd = timePeriodicActionVec_.end(); itr != itrEnd; ++itr) {
+      itr->doActionIfEndOfPeriod(simState_, lattice_);
+    }
+
+    for (std::vector<StepPeriodicAction_>::iterator itr = stepPeriodicActionVec_.begin(),
+	   itrEnd = stepPeriodicActionVec_.end(); itr != itrEnd; ++itr) {    
+      itr->doActionIfEndOfPeriod(simState_, lattice_);
+    }
+
+    schedulePeriodicActions_();
+  }
+  else {
+    timePeriodicActionSchedule_.doDueActions(simState_.elapsed_time_, simState_, lattice_);
+    stepPeriodicActionSchedule_.doDueActions(simState_.num_global_steps_, simState_, lattice_);
   }
 
   if (lattice_.hasChanged()) {
     KMC_CALL_MEMBER_FUNCTION(*this, updateEventAndAddrMapsAfterPeriodicActions_)();
   }
 
+  if (cellCenRateScalesChanged_ || overLatticeRateScalesChanged_) {
+    // Any changes to the lattice have already been accounted for
+    // above, so the event list is otherwise up to date.
+    updateEventListForRateScales_();
+  }
+
   lattice_.trackChanges(Lattice::TrackType::NONE);
 }
 
-void Simulation::Impl_::run_(double runTime) {
+void Simulation::Impl_::updateEventListForRun_() {
 
-  doPreRunChecks_();
+  if (cellCenteredEventsChanged_ || overLatticeEventsChanged_) {
 
-  simState_.maxTime_ += runTime;
+    if (cellCenteredEventsChanged_) {
+      mkReversedOffsets_();
+    }
 
-  mkReversedOffsets_();
+    SetEventExecutorAffectedCellOffsets_ setEventExecutorAffectedCellOffsets_(&reversedOffsetsVec_);
 
-  SetEventExecutorAffectedCellOffsets_ setEventExecutorAffectedCellOffsets_(&reversedOffsetsVec_);
+    if (cellCenteredEventsChanged_) {
+      for (std::vector<EventExecutor_>::iterator itr = cellCenEventVec_.begin(),
+             itrEnd = cellCenEventVec_.end(); itr != itrEnd; ++itr) {
+        boost::apply_visitor(setEventExecutorAffectedCellOffsets_, *itr);
+      }
+    }
 
-  for (std::vector<EventExecutor_>::iterator itr = cellCenEventVec_.begin(),
-         itrEnd = cellCenEventVec_.end(); itr != itrEnd; ++itr) {
-    boost::apply_visitor(setEventExecutorAffectedCellOffsets_, *itr);
+    for (std::vector<OverLatticeEvent_>::iterator itr = overLatticeEventVec_.begin(),
+           itrEnd = overLatticeEventVec_.end(); itr != itrEnd; ++itr) {
+      boost::apply_visitor(setEventExecutorAffectedCellOffsets_, itr->execute_);
+    }
   }
 
-  for (std::vector<OverLatticeEvent_>::iterator itr = overLatticeEventVec_.begin(),
-         itrEnd = overLatticeEventVec_.end(); itr != itrEnd; ++itr) {
-    boost::apply_visitor(setEventExecutorAffectedCellOffsets_, itr->execute_);
+  eIdFlattening_ = EventIdFlattening(localPlanarBBox_.imin,
+				     localPlanarBBox_.jmin,
+				     localPlanarBBox_.imaxP1 - localPlanarBBox_.imin,
+				     localPlanarBBox_.jmaxP1 - localPlanarBBox_.jmin,
+				     (aggregateEventsPerCell_ ? 1 : cellCenEventVec_.size()));
+
+  exitOnCondition(!eIdFlattening_.canFlatten(),
+		  "Too many cells per lattice plane times cell-centered events for event IDs. "
+		  "Either use more processes, or rebuild the library with KMC_64BIT_EVENT_IDS turned on.");
+
+  solver_->setEventIdFlattening(eIdFlattening_);
+
+  // The lattice only changes during a run, and any such changes have
+  // already been accounted for in the event list. If nothing else
+  // has changed either, the event list is used as is, so that a
+  // series of runs proceeds just as a single run would.
+
+  // The entries of changed event groups can be updated in place
+  // unless the event IDs of the other groups would change, or the
+  // entries of several groups are summed into one.
+  bool canUpdateCellCenteredEntriesInPlace = (solverCanAppendEventList_ &&
+                                              !aggregateEventsPerCell_ &&
+                                              (numCellCenEventsInEventList_ == cellCenEventVec_.size()));
+
+  if ((!eventListIsBuilt_) ||
+      (cellCenteredEventsChanged_ && !canUpdateCellCenteredEntriesInPlace)) {
+    // Since the event groups may have changed since the last run,
+    // all planes that may have events are rebuilt.
+    rebuildEventAndAddrMaps_(lowestPlaneToRebuild_(0));
   }
+  else {
+    if (cellCenteredEventsChanged_) {
+      updateChangedCellCenteredEntriesOfEventList_();
+    }
+
+    if (overLatticeEventsChanged_) {
+      updateOverLatticeEntriesOfEventList_();
+    }
+
+    // This comes after the above, which use the current rate scales
+    // for the entries they add.
+    if (cellCenRateScalesChanged_ || overLatticeRateScalesChanged_) {
+      updateEventListForRateScales_();
+    }
+  }
+
+  cellCenteredEventsChanged_ = false;
+  overLatticeEventsChanged_ = false;
+  changedCellCenEventVecInds_.clear();
+}
+
+void Simulation::Impl_::run_(double runTime) {
+
+  doPreRunChecks_();
 
-  // Initializing ciMin_ array used by EventId.  
-  EventId::ciMin_[0] = localPlanarBBox_.imin;
-  EventId::ciMin_[1] = localPlanarBBox_.jmin;
+  simState_.maxTime_ += runTime;
 
-  // Initializing dimsForFlattening_ array used by EventId.
-  EventId::dimsForFlattening_[0] = localPlanarBBox_.imaxP1 - localPlanarBBox_.imin;
-  EventId::dimsForFlattening_[1] = localPlanarBBox_.jmaxP1 - localPlanarBBox_.jmin;
-  EventId::dimsForFlattening_[2] = cellCenEventVec_.size();
+  updateEventListForRun_();
 
-  // Initializing the event maps
-  rebuildEventAndAddrMaps_();
+  // The periodic actions may have been added, changed, or removed
+  // since the last run.
+  schedulePeriodicActions_();
 
   EventId chosenEventID;
 
@@ -1048,7 +1820,9 @@ void Simulation::Impl_::run_(double runTime) {
     simState_.elapsed_time_ += simState_.t_stop_;
     ++(simState_.num_global_steps_);
 
-    runPeriodicActions_();
+    if (periodicActionsAreDue_()) {
+      runPeriodicActions_();
+    }
 
     solver_->updateTStop(lattice_.comm(), simState_.t_stop_);
 #else
@@ -1064,11 +1838,15 @@ void Simulation::Impl_::run_(double runTime) {
 
     ++(simState_.num_global_steps_);
 
-    runPeriodicActions_();
+    if (periodicActionsAreDue_()) {
+      runPeriodicActions_();
+    }
 #endif
 
   }
 
+  recordSolverMemoryUsage_();
+
   runHasBeenExecuted_ = true;
 }
 
@@ -1146,6 +1924,7 @@ void Simulation::getLatticeGlobalPlanarBBox(LatticePlanarBBox & bbox) const {
 double Simulation::elapsedTime() const {return pImpl_->simState_.elapsed_time_;}
 unsigned long long Simulation::numLocalEvents() const {return pImpl_->simState_.num_local_events_;}
 unsigned long long Simulation::numGlobalSteps() const {return pImpl_->simState_.num_global_steps_;}
+std::size_t Simulation::peakSolverMemoryUsage() const {return pImpl_->peakSolverMemoryUsage_;}
 
 void Simulation::reserveCellCenteredEventGroups(int numGroups, int numTotEvents) {
   pImpl_->cellCenGroupPropensitiesVec_.reserve(numGroups);
@@ -1157,6 +1936,8 @@ void Simulation::addCellCenteredEventGroup(int eventGroupId,
                                            CellCenteredGroupPropensities propensities,
                                            const EventExecutorGroup & eventExecutorGroup) {
 
+  pImpl_->cellCenteredEventsChanged_ = true;
+
   pImpl_->cellCenGroupPropensitiesIdIndexBimap_.insert(Impl_::IdIndexBimap_::value_type(eventGroupId,
                                                                                         pImpl_->cellCenGroupPropensitiesVec_.size()));
 
@@ -1166,6 +1947,7 @@ void Simulation::addCellCenteredEventGroup(int eventGroupId,
   Impl_::CellCenteredGroupPropensities_ & ccgp = pImpl_->cellCenGroupPropensitiesVec_.back();
 
   ccgp.eventVecInds_.reserve(eventExecutorGroup.numEventExecutors());
+  ccgp.rateScales_.assign(eventExecutorGroup.numEventExecutors(), 1.0);
 
   for (int i = 0; i < eventExecutorGroup.numEventExecutors(); ++i) {
 
@@ -1181,6 +1963,7 @@ void Simulation::addCellCenteredEventGroup(int eventGroupId,
     }
 
     ccgp.eventVecInds_.push_back(eventVecInd);
+    pImpl_->changedCellCenEventVecInds_.insert(eventVecInd);
 
     switch (eventExecutorGroup.getEventExecutorType(i)) {
     case EventExecutorGroup::EventExecEnum::AUTO:
@@ -1211,6 +1994,26 @@ void Simulation::removeCellCenteredEventGroup(int eventGroupId) {
   pImpl_->removeCellCenteredEventGroup_(eventGroupId, "removeCellCenteredEventGroup");
 }
 
+void Simulation::setEventRateScale(int eventGroupId, int eventIdx, double factor) {
+
+  std::size_t groupIndex = pImpl_->bimapIdToIndex_(eventGroupId,
+                                                   pImpl_->cellCenGroupPropensitiesIdIndexBimap_,
+                                                   "setEventRateScale",
+                                                   "eventGroupId");
+
+  std::vector<double> & rateScales = pImpl_->cellCenGroupPropensitiesVec_[groupIndex].rateScales_;
+
+  exitOnCondition((eventIdx < 0) || (eventIdx >= static_cast<int>(rateScales.size())),
+                  "setEventRateScale error: event index " + boost::lexical_cast<std::string>(eventIdx) +
+                  " is out of range for eventGroupId " + boost::lexical_cast<std::string>(eventGroupId));
+  exitOnCondition(factor < 0, "setEventRateScale error: factor must not be negative");
+
+  if (rateScales[eventIdx] != factor) {
+    rateScales[eventIdx] = factor;
+    pImpl_->cellCenRateScalesChanged_ = true;
+  }
+}
+
 void Simulation::reserveOverLatticeEvents(int num) {
   pImpl_->overLatticeEventVec_.reserve(num);
 }
@@ -1218,6 +2021,8 @@ void Simulation::reserveOverLatticeEvents(int num) {
 void Simulation::addOverLatticeEvent(int eventId,
 				     double propensityPerUnitArea,
 				     EventExecutorAutoTrack eventExecutor) {
+  pImpl_->overLatticeEventsChanged_ = true;
+
   pImpl_->overLatticeEventIdIndexBimap_.insert(Impl_::IdIndexBimap_::value_type(eventId,
 										pImpl_->overLatticeEventVec_.size()));
 
@@ -1230,6 +2035,8 @@ void Simulation::addOverLatticeEvent(int eventId,
 				     double propensityPerUnitArea,
                                      EventExecutorSemiManualTrack eventExecutor,
                                      const std::vector<CellNeighOffsets> & cnoVec) {
+  pImpl_->overLatticeEventsChanged_ = true;
+
   pImpl_->overLatticeEventIdIndexBimap_.insert(Impl_::IdIndexBimap_::value_type(eventId,
 										pImpl_->overLatticeEventVec_.size()));
 
@@ -1249,6 +2056,8 @@ void Simulation::changeOverLatticeEvent(int eventId,
 								 pImpl_->overLatticeEventIdIndexBimap_,
 								 "changeOverLatticeEvent",
 								 "eventId");
+
+  pImpl_->overLatticeEventsChanged_ = true;
   
   pImpl_->overLatticeEventVec_.at(overLatticeEventVecIndex) = Impl_::OverLatticeEvent_(propensityPerUnitArea,
 										       pImpl_->sectorPlanarBBox_,
@@ -1265,6 +2074,8 @@ void Simulation::changeOverLatticeEvent(int eventId,
 								 pImpl_->overLatticeEventIdIndexBimap_,
 								 "changeOverLatticeEvent",
 								 "eventId");
+
+  pImpl_->overLatticeEventsChanged_ = true;
   
   pImpl_->overLatticeEventVec_.at(overLatticeEventVecIndex) = Impl_::OverLatticeEvent_(propensityPerUnitArea,
 										       pImpl_->sectorPlanarBBox_,
@@ -1276,6 +2087,8 @@ void Simulation::changeOverLatticeEvent(int eventId,
 
 void Simulation::removeOverLatticeEvent(int eventId) {
 
+  pImpl_->overLatticeEventsChanged_ = true;
+
   pImpl_->removeEntryFromVecWithBimap_(eventId,
 				       pImpl_->overLatticeEventIdIndexBimap_,
 				       pImpl_->overLatticeEventVec_,
@@ -1283,6 +2096,23 @@ void Simulation::removeOverLatticeEvent(int eventId) {
 				       "eventId");
 }
 
+void Simulation::setEventRateScale(int eventId, double factor) {
+
+  std::size_t overLatticeEventVecIndex = pImpl_->bimapIdToIndex_(eventId,
+								 pImpl_->overLatticeEventIdIndexBimap_,
+								 "setEventRateScale",
+								 "eventId");
+
+  exitOnCondition(factor < 0, "setEventRateScale error: factor must not be negative");
+
+  double & rateScale = pImpl_->overLatticeEventVec_[overLatticeEventVecIndex].rateScale_;
+
+  if (rateScale != factor) {
+    rateScale = factor;
+    pImpl_->overLatticeRateScalesChanged_ = true;
+  }
+}
+
 void Simulation::trackCellsChangedByPeriodicActions(bool doTrack) {
   if (doTrack) {
     pImpl_->changeTrackingForPeriodicAction_ = Lattice::TrackType::RECORD_CHANGED_CELL_INDS;
@@ -1294,6 +2124,10 @@ void Simulation::trackCellsChangedByPeriodicActions(bool doTrack) {
   }
 }
 
+void Simulation::setActiveLayerDepth(int numPlanes) {
+  pImpl_->activeLayerDepth_ = numPlanes;
+}
+
 void Simulation::reserveTimePeriodicActions(int num) {
   pImpl_->timePeriodicActionVec_.reserve(num);
 }
@@ -1373,7 +2207,40 @@ void Simulation::removeStepPeriodicAction(int actionId) {
 }
 
 void Simulation::setSolver(SolverId::Type sId) {
-  pImpl_->solver_.reset(mkSolver(sId, &(pImpl_->lattice_)));
+  setSolver(sId, SolverParams());
+}
+
+void Simulation::setSolver(SolverId::Type sId, const SolverParams & params) {
+  setSolver(static_cast<int>(sId), params);
+}
+
+void Simulation::setSolver(int sId) {
+  setSolver(sId, SolverParams());
+}
+
+void Simulation::setSolver(int sId, const SolverParams & params) {
+
+  pImpl_->aggregateEventsPerCell_ = (params.getParamOrReturnDefaultVal(SolverParam::AGGREGATE_EVENTS_PER_CELL, 0) != 0);
+
+  // The built-in solvers are wrapped so that they apply the rate
+  // scales of the cell-centered events themselves, unless the events
+  // of a cell are aggregated into a single entry.
+  if ((sId < SolverId::MIN_CUSTOM_ID) && !(pImpl_->aggregateEventsPerCell_)) {
+    pImpl_->rateScalingSolver_ = new SolverWithRateScales(&(pImpl_->lattice_), sId, params);
+    pImpl_->solver_.reset(pImpl_->rateScalingSolver_);
+  }
+  else {
+    pImpl_->rateScalingSolver_ = NULL;
+    pImpl_->solver_.reset(mkSolver(sId, &(pImpl_->lattice_), params));
+  }
+
+  pImpl_->peakSolverMemoryUsage_ = 0;
+
+  // The new solver starts with an empty event list. Only the
+  // built-in solvers are known to implement
+  // Solver::appendEventList().
+  pImpl_->eventListIsBuilt_ = false;
+  pImpl_->solverCanAppendEventList_ = (sId < SolverId::MIN_CUSTOM_ID);
 
   // Even if the time increment scheme and random number generator
   // have been set before, they'll need to be reset after the solver
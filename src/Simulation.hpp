@@ -10,6 +10,8 @@
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <cstddef>
+
 #include "CellCenteredGroupPropensities.hpp"
 #include "EventExecutorGroup.hpp"
 #include "PeriodicAction.hpp"
@@ -17,6 +19,7 @@
 #include "RandNumGen.hpp"
 #include "TimeIncrSchemeVars.hpp"
 #include "IdsOfSolvers.hpp"
+#include "ParamsForSolvers.hpp"
 
 /*! \file
   \brief Defines the Simulation class.
@@ -212,6 +215,16 @@ namespace KMCThinFilm {
     */
     unsigned long long numGlobalSteps() const;
 
+    /*! Estimate of the largest amount of memory, in bytes, held by the
+        solver's event list since the solver was set. This is sampled
+        when the event list is rebuilt and at the end of each call to
+        run(), and in the parallel version of the library, is the
+        value for the calling process alone.
+
+	\see Solver::memoryUsage()
+    */
+    std::size_t peakSolverMemoryUsage() const;
+
     /*! Sets the number of possible cell-centered event groups for the
         simulation to <VAR>numGroups</VAR>, and the number of
         individual possible cell-centered events to
@@ -258,6 +271,14 @@ namespace KMCThinFilm {
     /*! Changes a possible cell-centered event group that has been
         previously added to the simulation.
 
+	At the next call to run(), only the events of the changed
+	group are updated in the event list, provided that the group
+	has no more events than before, that the solver is one of
+	those in SolverId::Type, and that
+	SolverParam::AGGREGATE_EVENTS_PER_CELL is not set. Otherwise,
+	the event list is rebuilt. The same holds for
+	removeCellCenteredEventGroup().
+
 	\see addCellCenteredEventGroup()
     */
     void changeCellCenteredEventGroup(int eventGroupId /*!< Unique integer ID of event group*/,
@@ -298,6 +319,38 @@ namespace KMCThinFilm {
     */
     void removeCellCenteredEventGroup(int eventGroupId /*!< Integer ID of event group to be removed. */);
 
+    /*! Multiplies the propensity of one event in a cell-centered
+        event group by <VAR>factor</VAR>, e.g. to follow a temperature
+        ramp without replacing the group.
+
+      The factor applies to the propensities calculated by the
+      group's CellCenteredGroupPropensities function, and replaces
+      any factor set before. It is one when the group is added, and
+      is reset to one by changeCellCenteredEventGroup().
+
+      This may be called between runs or from within a periodic
+      action (e.g. one bound to a pointer to this Simulation). In the
+      latter case, the event list is updated once the periodic actions
+      have finished, which is much cheaper than stopping and restarting
+      run(). The built-in solvers keep the events of each type apart
+      once a factor other than one has been set, and multiply the
+      total propensity of each type by its factor, so that a change
+      of factor touches no entries of the event list. (The first such
+      factor moves the entries to where they are kept by type, which
+      takes time proportional to their number, but only once.) If
+      SolverParam::AGGREGATE_EVENTS_PER_CELL is set, or a custom
+      solver is used, the event list is rebuilt instead. In the
+      parallel version of the library, it must be called with the
+      same arguments on every process.
+    */
+    void setEventRateScale(int eventGroupId /*!< Integer ID of event group */,
+                           int eventIdx /*!< Index of the event within
+                                           the group, ranging from 0 to
+                                           EventExecutorGroup::numEventExecutors() - 1 */,
+                           double factor /*!< Non-negative factor
+                                            multiplying the event's
+                                            propensity */);
+
     /*! Sets the number of "over-lattice" possible events for the
         simulation, that is, events that occur at a random site over
         the lattice (e.g. deposition of an atom), to <VAR>num</VAR>.
@@ -401,10 +454,30 @@ namespace KMCThinFilm {
 
     /*! Removes a previously added possible "over-lattice" from the simulation. 
 
+	At the next call to run(), only the over-lattice entries of the
+	event list are updated, unless a custom solver that cannot
+	update them in place is used, in which case the event list is
+	rebuilt. The same holds for addOverLatticeEvent() and
+	changeOverLatticeEvent().
+
 	\see addOverLatticeEvent() changeOverLatticeEvent()
     */
     void removeOverLatticeEvent(int eventId /*!< Integer ID of event to be removed. */);
 
+    /*! Multiplies the propensity of an "over-lattice" event by
+        <VAR>factor</VAR>, e.g. to change a deposition flux without
+        replacing the event.
+
+      The factor replaces any factor set before. It is one when the
+      event is added, and is reset to one by changeOverLatticeEvent().
+
+      \see setEventRateScale(int, int, double) for when this may be called.
+    */
+    void setEventRateScale(int eventId /*!< Integer ID of over-lattice event */,
+                           double factor /*!< Non-negative factor
+                                            multiplying the event's
+                                            propensity */);
+
     /*! [<STRONG>ADVANCED</STRONG>] If <VAR>doTrack</VAR> is true,
         store indices of the lattice cells changed by the periodic
         actions that occur.
@@ -423,6 +496,48 @@ namespace KMCThinFilm {
      */
     void trackCellsChangedByPeriodicActions(bool doTrack);
 
+    /*! [<STRONG>ADVANCED</STRONG>] Declares that cell-centered
+        events can only occur in the top <VAR>numPlanes</VAR> planes
+        of the lattice.
+
+       When the event list is rebuilt from the lattice, the
+       propensities of all the cells in the lattice from the bottom
+       plane up are normally calculated. This happens at the
+       beginning of the first run(), and after a periodic action
+       changes the lattice (unless trackCellsChangedByPeriodicActions()
+       has been given a value of true). It also happens when the
+       event list cannot be updated in place: at the beginning of a
+       later run() if the cell-centered event groups have changed in
+       a way that changes the event IDs, if
+       SolverParam::AGGREGATE_EVENTS_PER_CELL is set, or if a custom
+       solver is used, and after setEventRateScale(int, int, double)
+       in the last two cases or setEventRateScale(int, double) in the
+       last one. Otherwise, a later run() only updates the entries that
+       have changed, and the cells below the active layer are not
+       visited at all. If
+       <VAR>numPlanes</VAR> is positive, then only the propensities
+       of cells in the top <VAR>numPlanes</VAR> planes are calculated,
+       so that the cost of a rebuild scales with the area of the
+       lattice rather than its volume. Any events that would have
+       occurred in lower planes are silently ignored, so
+       <VAR>numPlanes</VAR> must be at least as large as the depth of
+       the surface roughness plus the reach of the offsets used to
+       calculate propensities.
+
+       If <VAR>numPlanes</VAR> is zero or negative (the default), then
+       the planes that are rebuilt after a periodic action are
+       inferred instead, from the lowest plane that had a non-zero
+       propensity before the periodic action, the lowest plane changed
+       by the periodic action, and the reach of the offsets used to
+       calculate propensities. A rebuild at the beginning of run()
+       then includes all the planes of the lattice.
+
+       A changed <VAR>numPlanes</VAR> does not itself cause a rebuild,
+       and only takes effect at the next one. Until then, the event
+       list keeps any events below the new active layer.
+     */
+    void setActiveLayerDepth(int numPlanes);
+
      /*! Sets the number of time-periodic actions for the
        simulation to <VAR>num</VAR>.
 
@@ -530,6 +645,27 @@ namespace KMCThinFilm {
     /*! Sets the type of solver, i.e. the means of storing and choosing events, for the simulation. */
     void setSolver(SolverId::Type sId);
 
+    /*! Sets the type of solver, along with optional parameters that
+        modify its behavior.
+
+	\see SolverParam::Type
+     */
+    void setSolver(SolverId::Type sId, const SolverParams & params);
+
+    /*! Sets the solver to a custom solver registered with
+        registerSolver(), or to one of the solvers in SolverId::Type.
+
+	\see registerSolver()
+     */
+    void setSolver(int sId);
+
+    /*! Like setSolver(int), but with optional parameters that modify
+        the behavior of the solver.
+
+	\see registerSolver() SolverParam::Type
+     */
+    void setSolver(int sId, const SolverParams & params);
+
     /*! Sets the parallel time-incrementing scheme.
 
       If KMC_PARALLEL equals zero, this does nothing. This must be
@@ -541,7 +677,12 @@ namespace KMCThinFilm {
       This must be called <STRONG>after</STRONG> setSolver() has been called. */
     void setRNG(RandNumGenSharedPtr rng);
 
-    /*! Runs the simulation */
+    /*! Runs the simulation.
+
+      The event list is kept from one call to the next, and is only
+      rebuilt as far as the events, rate scales, or solver have been
+      changed in between, so a series of short runs costs about as
+      much as one long run. */
     void run(double runTime /*!< Length of simulation time */);
   private:
     class Impl_;
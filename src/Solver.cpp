@@ -6,6 +6,31 @@
 
 using namespace KMCThinFilm;
 
+void Solver::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+					       const std::vector<double> & propensities,
+					       int sectNum) {
+  for (std::size_t i = 0; i < eIds.size(); ++i) {
+    addCellCenteredEntryToEventList(eIds[i], propensities[i], sectNum);
+  }
+}
+
+bool Solver::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+						    double propensity,
+						    int sectNum) {
+  return false;
+}
+
+void Solver::appendEventList(int sectNum,
+			     std::vector<EventId> & eIds,
+			     std::vector<double> & propensities) const {
+  exitWithMsg("This solver cannot pass on its event list to another solver");
+}
+
+double Solver::totalPropensity(int sectNum) {
+  exitWithMsg("This solver cannot report the total propensity of its events");
+  return 0;
+}
+
 #if KMC_PARALLEL
 
 void Solver::getTstopFromLocalPropensities_(double propensityMaxLocal,
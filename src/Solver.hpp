@@ -1,14 +1,25 @@
 #ifndef SOLVER_HPP
 #define SOLVER_HPP
 
+/*!\file
+  \brief Defines the Solver class, the interface that every solver
+  implements.
+
+  Solvers other than those enumerated in SolverId::Type can be
+  derived from Solver and made available to Simulation::setSolver()
+  through registerSolver(), and then checked against the interface
+  with checkSolverConformance().
+*/
+
 #include "KMC_Config.hpp"
 
 #if KMC_PARALLEL
 #include <mpi.h>
-#include <vector>
 #endif
 
+#include <vector>
 #include <string>
+#include <cstddef>
 
 #include "EventId.hpp"
 #include "RandNumGen.hpp"
@@ -18,79 +29,256 @@ namespace KMCThinFilm {
 
   class Lattice;
 
+  /*! Interface of a solver, i.e. the means of storing the possible
+    events of a simulation along with their propensities, and of
+    choosing which event to execute next.
+
+    Events are identified by EventId objects, which a solver should
+    treat as opaque keys, apart from EventId::isForOverLattice(). A
+    solver only needs to distinguish over-lattice events from
+    cell-centered events in the parallel version of the library,
+    where only the latter count towards the propensities used by the
+    time-incrementing schemes.
+
+    Events are kept separately for each sector of the lattice, with
+    the sector numbered by the <VAR>sectNum</VAR> argument of the
+    member functions below. In the serial version of the library,
+    there is only one sector, numbered zero.
+
+    The Simulation class uses a solver in two phases:
+
+    1. The event list is built from scratch, by calling
+       beginBuildingEventList(), then
+       addCellCenteredEntriesToEventList() for batches of
+       cell-centered events and addOverLatticeEntryToEventList() for
+       each over-lattice event, and
+       then endBuildingEventList(). This happens at the start of the
+       first call to Simulation::run() after the solver is set, at
+       the start of a later call if the cell-centered events have
+       changed in a way that the event list cannot be updated for in
+       place, and after any periodic action that changes the lattice
+       without tracking the changed cells.
+
+    2. Events are then repeatedly chosen by
+       chooseEventIDAndUpdateTime(), and after each chosen event is
+       executed, the propensities of all events that it may have
+       affected are passed to addOrUpdateCellCenteredEntryToEventList().
+       If over-lattice events are added, changed, or removed between
+       runs, then their entries are passed to
+       addOrUpdateOverLatticeEntryToEventList(), and the event list is
+       only built again if the solver cannot update them in place.
+
+    A solver must choose each event with a probability proportional
+    to its propensity, and must draw its random numbers from rng_,
+    which is set by setRNG() before the event list is first built.
+   */
   class Solver {
   public:
 
-#if KMC_PARALLEL
+    /*! Constructor. The lattice outlives the solver, and may be
+      used to look up, e.g., the number of sectors and their
+      bounding boxes. */
     Solver(const Lattice * lattice)
+#if KMC_PARALLEL
       : lattice_(lattice),
 	tIncrSchemeName_(TimeIncr::SchemeName::BAD_VALUE)
+#endif
     {}
+
+    //! \cond HIDE_FROM_DOXYGEN
+#if !KMC_PARALLEL
+    Solver() {}
 #endif
+    //! \endcond
 
     virtual ~Solver() {};
 
-    void setRNG(RandNumGenSharedPtr rng) {rng_ = rng;}
-  
-    // This does any preliminary work for adding to the event list, such
-    // as clearing any previous contents of the event list.
+    /*! Sets the random-number generator used by the solver. A solver
+      that delegates to other solvers should override this to pass the
+      generator on to them as well. */
+    virtual void setRNG(RandNumGenSharedPtr rng) {rng_ = rng;}
+
+    //! \cond HIDE_FROM_DOXYGEN
+    // Sets the mapping between cell-centered events and their event
+    // IDs, which Simulation does before each build of the event
+    // list. A solver that delegates to other solvers overrides this
+    // to pass the mapping on to them as well.
+    virtual void setEventIdFlattening(const EventIdFlattening & eIdFlattening) {
+      eIdFlattening_ = eIdFlattening;
+    }
+    //! \endcond
+
+    /*! Does any preliminary work for building the event list, such as
+      clearing any previous contents of it.
+
+      \param numOverLatticeEvents Number of types of over-lattice
+      events, so that the over-lattice event IDs passed to the solver
+      identify one of numOverLatticeEvents events per sector.
+
+      \param numReservedLatticePlanes Number of lattice planes for
+      which the lattice has reserved storage. Since events are
+      usually found only near the surface of a film, reserving
+      storage for every possible event in this many planes would
+      mostly be wasted, and so the built-in solvers instead size
+      their storage from the number of events actually added.
+    */
     virtual void beginBuildingEventList(int numOverLatticeEvents,
                                         int numReservedLatticePlanes) = 0;
 
-    // Used to add entries to the event list being built. Should ONLY be
-    // called in between calls to beginBuildingEventList() and
-    // endBuildingEventList().
+    /*! Adds a cell-centered event with non-zero propensity to the
+      event list being built. Should <STRONG>only</STRONG> be called
+      in between calls to beginBuildingEventList() and
+      endBuildingEventList(), and at most once per event. */
     virtual void addCellCenteredEntryToEventList(const EventId & eId,
 						 double propensity,
 						 int sectNum) = 0;
 
+    /*! Adds a batch of cell-centered events with non-zero
+      propensities to the event list being built, with the same effect
+      as calling addCellCenteredEntryToEventList() for each element of
+      eIds and propensities in turn. Simulation adds the cell-centered
+      events of a rebuild in batches of this kind, so that a solver
+      may, e.g., sort a batch by propensity and then build its
+      structures from the sorted batch in a single pass. The default
+      implementation just calls addCellCenteredEntryToEventList() for
+      each event. */
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    /*! Like addCellCenteredEntryToEventList(), but for an
+      over-lattice event. The propensities of over-lattice events only
+      change after the event list is built through
+      addOrUpdateOverLatticeEntryToEventList(). */
     virtual void addOverLatticeEntryToEventList(const EventId & eId,
 						double propensity,
 						int sectNum) = 0;
 
-    // This does any work needed after entries to event list have all
-    // been added.
+    /*! Does any work needed after the entries to the event list have
+      all been added. */
     virtual void endBuildingEventList() = 0;
 
+    /*! Sets the propensity of a cell-centered event after the event
+      list has been built. If the event is not yet in the list and the
+      propensity is non-zero, then the event is added. If the event
+      is in the list and the propensity is zero, then the event is
+      removed. If the event is not in the list and the propensity is
+      zero, then nothing happens. */
     virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
 							 double propensity,
 							 int sectNum) = 0;
 
+    /*! Like addOrUpdateCellCenteredEntryToEventList(), but for an
+      over-lattice event, which Simulation uses when over-lattice
+      events are added, changed, or removed between runs. The index of
+      the event may be beyond the numOverLatticeEvents passed to
+      beginBuildingEventList(), if over-lattice events have been added
+      since then. Returns false if the solver cannot update its
+      over-lattice entries in place, in which case Simulation builds
+      the event list again instead. The default implementation just
+      returns false. */
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    /*! Chooses an event in sector sectNum with probability
+      proportional to its propensity, and advances time by an
+      exponentially distributed time step whose mean is the
+      reciprocal of the total propensity of the sector. This is only
+      called if noMoreEvents() returns false for the sector. */
     virtual void chooseEventIDAndUpdateTime(int sectNum,
 					    EventId & chosenEventID,
 					    double & time) = 0;
 
+    /*! Returns true if there are no events with non-zero propensity in sector sectNum. */
     virtual bool noMoreEvents(int sectNum) const = 0;
 
+    /*! Returns the sum of the propensities of all the events in
+      sector sectNum. This is not const, so that a solver may bring
+      any deferred bookkeeping up to date before answering. It is
+      needed to combine the solver with an alias table for
+      over-lattice events (see
+      SolverParam::ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS). The default
+      implementation exits with an error message. */
+    virtual double totalPropensity(int sectNum);
+
+    /*! Returns an estimate of the number of bytes of memory held by
+      the event list, which Simulation uses to report the peak memory
+      used by the solver. The default implementation returns zero.
+
+      \see Simulation::peakSolverMemoryUsage()
+    */
+    virtual std::size_t memoryUsage() const {return 0;}
+
+    /*! Appends the IDs and propensities of all the events in sector
+      sectNum, in no particular order, to eIds and propensities. This
+      allows the event list to be handed over to another solver, as
+      is done for SolverId::AUTO. The default implementation exits
+      with an error message. */
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
 #if KMC_PARALLEL
+    /*! Returns true if there are no cell-centered events with
+      non-zero propensity in sector sectNum. Only exists in the
+      parallel version of the library. */
     virtual bool noCellCenteredEvents(int sectNum) const = 0;
 
+    //! \cond HIDE_FROM_DOXYGEN
     void setTimeIncrScheme(const TimeIncr::SchemeVars & vars);
     TimeIncr::SchemeName::Type getTimeIncrSchemeName() const {return tIncrSchemeName_;}
     bool timeIncrSchemeIsAdaptive() const;
     void updateTStop(const MPI_Comm & comm, double & tStop);
+    //! \endcond
 #endif
 
   protected:
+    /*! The random-number generator set by setRNG(). */
     RandNumGenSharedPtr rng_;
+
+    //! \cond HIDE_FROM_DOXYGEN
+    // Set by setEventIdFlattening(), and used by the built-in solvers
+    // to size their maps of event IDs.
+    EventIdFlattening eIdFlattening_;
+    //! \endcond
+
 #if KMC_PARALLEL
-    // To be used in calculating getLocalMaxAvgPropensityPerInPlaneCell()
-    std::vector<int> numSitesPerSector_;
+    /*! Returns the maximum, over all sectors, of the total
+      propensity of the cell-centered events in a sector divided by
+      the number of such events. Used by the time-incrementing scheme
+      TimeIncr::SchemeName::MAX_AVG_PROPENSITY_PER_POSS_EVENT, and
+      only exists in the parallel version of the library. */
+    virtual double getLocalMaxAvgPropensityPerPossEvent() = 0;
+
+    /*! Returns the largest propensity of any cell-centered event in
+      any sector. Used by the time-incrementing scheme
+      TimeIncr::SchemeName::MAX_SINGLE_PROPENSITY, and only exists in
+      the parallel version of the library. */
+    virtual double getLocalMaxSinglePropensity() = 0;
+
+    //! \cond HIDE_FROM_DOXYGEN
+    // These allow a solver that delegates to another solver to call
+    // the above functions of that solver.
+    static double localMaxAvgPropensityPerPossEventOf(Solver & solver) {
+      return solver.getLocalMaxAvgPropensityPerPossEvent();
+    }
+
+    static double localMaxSinglePropensityOf(Solver & solver) {
+      return solver.getLocalMaxSinglePropensity();
+    }
+    //! \endcond
 #endif
 
   private:
-    
-#if KMC_PARALLEL    
-    const Lattice * lattice_;    
+
+#if KMC_PARALLEL
+    const Lattice * lattice_;
     TimeIncr::SchemeName::Type tIncrSchemeName_;
 
     double nStop_, tStopFixed_, tStopMax_;
     bool timeIncrSchemeIsAdaptive_;
 
-    // Used in calculating time step schemes
-    virtual double getLocalMaxAvgPropensityPerPossEvent() const = 0;
-    virtual double getLocalMaxSinglePropensity() const = 0;
-
     typedef void (Solver::*UpdateTStop_)(const MPI_Comm & comm,
 					 double & tStop);
 
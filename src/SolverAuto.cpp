@@ -0,0 +1,408 @@
+#include "SolverAuto.hpp"
+#include "SolverFactory.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+#include "RandNumGenMT19937.hpp"
+
+#include <ctime>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  const int CANDIDATE_IDS[] = {SolverId::DYNAMIC_SCHULZE,
+			       SolverId::BINARY_TREE,
+			       SolverId::COMPOSITION_REJECTION,
+			       SolverId::KARY_TREE,
+			       SolverId::FENWICK_TREE,
+			       SolverId::REJECTION};
+
+  const std::size_t NUM_CANDIDATES = sizeof(CANDIDATE_IDS)/sizeof(CANDIDATE_IDS[0]);
+
+  // Solver used until the first benchmark
+  const int INITIAL_SOLVER_ID = SolverId::BINARY_TREE;
+
+  // Number of events chosen in each burst
+  const std::size_t BURST_LENGTH = 2000;
+
+  // A burst that has already taken longer than the fastest burst so
+  // far is abandoned. The clock is only checked this often, since
+  // reading it isn't free.
+  const std::size_t NUM_CHOSEN_PER_CLOCK_CHECK = 64;
+
+  // Rebuilding the event list of every candidate takes time
+  // proportional to the number of entries, so the number of events
+  // chosen between benchmarks is made proportional to it as well.
+  const std::size_t NUM_CHOSEN_PER_ENTRY_BETWEEN_BENCHMARKS = 20;
+  const std::size_t MIN_NUM_CHOSEN_BETWEEN_BENCHMARKS = 100000;
+
+  // Used before there are any counts of updates and choices from the
+  // simulation itself.
+  const double DEFAULT_UPDATES_PER_CHOICE = 8;
+
+  // SolverId::REJECTION is not tried if the expected number of picks
+  // per chosen event is larger than this, since a single choice could
+  // then take longer than a whole burst on any other solver.
+  const double MAX_EXPECTED_REJECTION_PICKS = 32;
+
+  // Any fixed seed will do, since the benchmarks only need the
+  // propensities of the events that they choose and update to be
+  // typical of the event list.
+  const unsigned int BENCHMARK_SEED = 5489;
+
+  // Returns the CPU time, in seconds, used by the calling thread. The
+  // bursts are timed with this rather than with std::clock(), which
+  // counts the CPU time of every thread in the process, and so would
+  // also count the other replicas of an EnsembleRunner.
+  double threadCPUTime() {
+#if defined(_POSIX_THREAD_CPUTIME) && (_POSIX_THREAD_CPUTIME >= 0)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+#else
+    return static_cast<double>(std::clock())/CLOCKS_PER_SEC;
+#endif
+  }
+
+}
+
+SolverAuto::SolverAuto(const Lattice * lattice, const SolverParams & params)
+  : Solver(lattice),
+    lattice_(lattice),
+    params_(params),
+    solverId_(INITIAL_SOLVER_ID),
+    numOverLatticeEvents_(0),
+    numReservedLatticePlanes_(0),
+    benchmarkIsDue_(true),
+    numChosenSinceBenchmark_(0),
+    numUpdatedSinceBenchmark_(0),
+    numChosenBetweenBenchmarks_(MIN_NUM_CHOSEN_BETWEEN_BENCHMARKS),
+    updatesPerChoice_(DEFAULT_UPDATES_PER_CHOICE),
+    benchmarkRNG_(new RandNumGenMT19937(BENCHMARK_SEED)),
+    eIds_(lattice->numSectors()),
+    propensities_(lattice->numSectors())
+{
+  // The alias table, if any, wraps this solver rather than each of
+  // the candidates.
+  params_.setParam(SolverParam::ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS, 0);
+
+  solver_.reset(mkSolver(solverId_, lattice_, params_));
+}
+
+void SolverAuto::setRNG(RandNumGenSharedPtr rng) {
+  Solver::setRNG(rng);
+  solver_->setRNG(rng);
+}
+
+void SolverAuto::setEventIdFlattening(const EventIdFlattening & eIdFlattening) {
+  Solver::setEventIdFlattening(eIdFlattening);
+  solver_->setEventIdFlattening(eIdFlattening);
+}
+
+void SolverAuto::beginBuildingEventList(int numOverLatticeEvents,
+					int numReservedLatticePlanes) {
+  numOverLatticeEvents_ = numOverLatticeEvents;
+  numReservedLatticePlanes_ = numReservedLatticePlanes;
+
+  solver_->beginBuildingEventList(numOverLatticeEvents, numReservedLatticePlanes);
+}
+
+void SolverAuto::addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum) {
+  solver_->addCellCenteredEntryToEventList(eId, propensity, sectNum);
+}
+
+void SolverAuto::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum) {
+  solver_->addCellCenteredEntriesToEventList(eIds, propensities, sectNum);
+}
+
+void SolverAuto::addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum) {
+  solver_->addOverLatticeEntryToEventList(eId, propensity, sectNum);
+}
+
+void SolverAuto::endBuildingEventList() {
+  solver_->endBuildingEventList();
+
+  if (benchmarkIsDue_) {
+    benchmarkAndMigrate_();
+  }
+}
+
+void SolverAuto::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum) {
+  ++numUpdatedSinceBenchmark_;
+  solver_->addOrUpdateCellCenteredEntryToEventList(eId, propensity, sectNum);
+}
+
+bool SolverAuto::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum) {
+
+  // So that a candidate built to replace the solver has room for
+  // over-lattice events added since the event list was built.
+  int overLatticeEventIndex, eIdSectNum;
+  eId.getEventInfo(overLatticeEventIndex, eIdSectNum);
+  numOverLatticeEvents_ = std::max(numOverLatticeEvents_, overLatticeEventIndex + 1);
+
+  return solver_->addOrUpdateOverLatticeEntryToEventList(eId, propensity, sectNum);
+}
+
+void SolverAuto::chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time) {
+
+  if (++numChosenSinceBenchmark_ > numChosenBetweenBenchmarks_) {
+    benchmarkAndMigrate_();
+  }
+
+  solver_->chooseEventIDAndUpdateTime(sectNum, chosenEventID, time);
+}
+
+bool SolverAuto::noMoreEvents(int sectNum) const {
+  return solver_->noMoreEvents(sectNum);
+}
+
+double SolverAuto::totalPropensity(int sectNum) {
+  return solver_->totalPropensity(sectNum);
+}
+
+std::size_t SolverAuto::memoryUsage() const {
+  return solver_->memoryUsage() + memoryUsageOf(eIds_) + memoryUsageOf(propensities_) +
+    memoryUsageOf(cellCenteredSectNums_) + memoryUsageOf(cellCenteredInds_) +
+    memoryUsageOf(touchedInds_) + memoryUsageOf(nonEmptySectNums_);
+}
+
+void SolverAuto::appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const {
+  solver_->appendEventList(sectNum, eIds, propensities);
+}
+
+void SolverAuto::benchmarkAndMigrate_() {
+
+  if (numChosenSinceBenchmark_ > 0) {
+    updatesPerChoice_ = static_cast<double>(numUpdatedSinceBenchmark_)/numChosenSinceBenchmark_;
+  }
+
+  benchmarkIsDue_ = false;
+  numChosenSinceBenchmark_ = numUpdatedSinceBenchmark_ = 0;
+
+  std::size_t numEntries = 0;
+
+  cellCenteredSectNums_.clear();
+  cellCenteredInds_.clear();
+  nonEmptySectNums_.clear();
+
+  for (int sectNum = 0; sectNum < static_cast<int>(eIds_.size()); ++sectNum) {
+    std::vector<EventId> & eIds = eIds_[sectNum];
+
+    eIds.clear();
+    propensities_[sectNum].clear();
+    solver_->appendEventList(sectNum, eIds, propensities_[sectNum]);
+
+    numEntries += eIds.size();
+
+    if (!eIds.empty()) {
+      nonEmptySectNums_.push_back(sectNum);
+    }
+
+    for (std::size_t i = 0; i < eIds.size(); ++i) {
+      if (!eIds[i].isForOverLattice()) {
+	cellCenteredSectNums_.push_back(sectNum);
+	cellCenteredInds_.push_back(i);
+      }
+    }
+  }
+
+  numChosenBetweenBenchmarks_ = std::max(MIN_NUM_CHOSEN_BETWEEN_BENCHMARKS,
+					 NUM_CHOSEN_PER_ENTRY_BETWEEN_BENCHMARKS*numEntries);
+
+  // With no cell-centered events, there's nothing to update, and the
+  // choice of solver hardly matters.
+  if (!cellCenteredInds_.empty()) {
+
+    // The current solver is timed first, since it is the one most
+    // likely to win, and the others can then be abandoned early.
+
+    boost::scoped_ptr<Solver> bestSolver(mkCandidate_(solverId_));
+    int bestId = solverId_;
+    double bestTime = timeBurst_(*bestSolver, -1);
+
+    for (std::size_t i = 0; i < NUM_CANDIDATES; ++i) {
+      int sId = CANDIDATE_IDS[i];
+
+      if ((sId == solverId_) ||
+	  ((sId == SolverId::REJECTION) && rejectionIsHopeless_())) {
+	continue;
+      }
+
+      boost::scoped_ptr<Solver> candidate(mkCandidate_(sId));
+      double candidateTime = timeBurst_(*candidate, bestTime);
+
+      if ((candidateTime >= 0) && (candidateTime < bestTime)) {
+	bestSolver.swap(candidate);
+	bestId = sId;
+	bestTime = candidateTime;
+      }
+    }
+
+    // The winner has the same event list as the current solver, and
+    // so can simply replace it.
+    bestSolver->setRNG(rng_);
+    solver_.swap(bestSolver);
+    solverId_ = bestId;
+  }
+
+  // Benchmarks are infrequent, so the copy of the event list isn't
+  // worth keeping around in between them.
+  for (std::size_t i = 0; i < eIds_.size(); ++i) {
+    std::vector<EventId>().swap(eIds_[i]);
+    std::vector<double>().swap(propensities_[i]);
+  }
+  std::vector<int>().swap(cellCenteredSectNums_);
+  std::vector<std::size_t>().swap(cellCenteredInds_);
+  std::vector<std::size_t>().swap(touchedInds_);
+}
+
+Solver * SolverAuto::mkCandidate_(int sId) {
+
+  Solver * candidate = mkSolver(sId, lattice_, params_);
+
+  candidate->setRNG(benchmarkRNG_);
+  candidate->setEventIdFlattening(eIdFlattening_);
+
+  candidate->beginBuildingEventList(numOverLatticeEvents_, numReservedLatticePlanes_);
+
+  for (int sectNum = 0; sectNum < static_cast<int>(eIds_.size()); ++sectNum) {
+    const std::vector<EventId> & eIds = eIds_[sectNum];
+    const std::vector<double> & propensities = propensities_[sectNum];
+
+    for (std::size_t i = 0; i < eIds.size(); ++i) {
+      if (eIds[i].isForOverLattice()) {
+	candidate->addOverLatticeEntryToEventList(eIds[i], propensities[i], sectNum);
+      }
+      else {
+	candidate->addCellCenteredEntryToEventList(eIds[i], propensities[i], sectNum);
+      }
+    }
+  }
+
+  candidate->endBuildingEventList();
+
+  return candidate;
+}
+
+double SolverAuto::timeBurst_(Solver & candidate, double timeToBeat) {
+
+  std::size_t numCellCentered = cellCenteredInds_.size();
+
+  touchedInds_.clear();
+
+  EventId chosenEventID;
+  double unusedTime = 0;
+  double updateCredit = 0;
+
+  double startTime = threadCPUTime();
+
+  for (std::size_t n = 0; n < BURST_LENGTH; ++n) {
+
+    int sectNum = nonEmptySectNums_[n % nonEmptySectNums_.size()];
+    candidate.chooseEventIDAndUpdateTime(sectNum, chosenEventID, unusedTime);
+
+    // Each update gives a randomly picked cell-centered event the
+    // propensity of another randomly picked one, so that the
+    // propensities stay distributed like those of the actual event
+    // list.
+    updateCredit += updatesPerChoice_;
+
+    while (updateCredit >= 1) {
+      std::size_t toInd = std::min(static_cast<std::size_t>(numCellCentered*benchmarkRNG_->getNumInOpenIntervalFrom0To1()),
+				   numCellCentered - 1);
+      std::size_t fromInd = std::min(static_cast<std::size_t>(numCellCentered*benchmarkRNG_->getNumInOpenIntervalFrom0To1()),
+				     numCellCentered - 1);
+
+      int toSectNum = cellCenteredSectNums_[toInd];
+
+      candidate.addOrUpdateCellCenteredEntryToEventList(eIds_[toSectNum][cellCenteredInds_[toInd]],
+							propensities_[cellCenteredSectNums_[fromInd]][cellCenteredInds_[fromInd]],
+							toSectNum);
+      touchedInds_.push_back(toInd);
+
+      updateCredit -= 1;
+    }
+
+    if ((timeToBeat >= 0) && ((n + 1) % NUM_CHOSEN_PER_CLOCK_CHECK == 0) &&
+	(threadCPUTime() - startTime > timeToBeat)) {
+      return -1;
+    }
+  }
+
+  double burstTime = threadCPUTime() - startTime;
+
+  // Restoring the original propensities, so that the candidate's
+  // event list is again the same as the current solver's.
+  for (std::vector<std::size_t>::const_iterator itr = touchedInds_.begin(),
+	 itrEnd = touchedInds_.end(); itr != itrEnd; ++itr) {
+    int sectNum = cellCenteredSectNums_[*itr];
+    std::size_t ind = cellCenteredInds_[*itr];
+
+    candidate.addOrUpdateCellCenteredEntryToEventList(eIds_[sectNum][ind],
+						      propensities_[sectNum][ind],
+						      sectNum);
+  }
+
+  return burstTime;
+}
+
+bool SolverAuto::rejectionIsHopeless_() const {
+
+  // The expected number of picks per chosen event is the ratio of
+  // the largest propensity to the average one.
+
+  for (std::size_t sectNum = 0; sectNum < propensities_.size(); ++sectNum) {
+    const std::vector<double> & propensities = propensities_[sectNum];
+
+    if (!propensities.empty()) {
+      double maxPropensity = 0, sumOfPropensities = 0;
+
+      for (std::vector<double>::const_iterator itr = propensities.begin(),
+	     itrEnd = propensities.end(); itr != itrEnd; ++itr) {
+	maxPropensity = std::max(maxPropensity, *itr);
+	sumOfPropensities += *itr;
+      }
+
+      if (maxPropensity*propensities.size() > MAX_EXPECTED_REJECTION_PICKS*sumOfPropensities) {
+	return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+#if KMC_PARALLEL
+
+bool SolverAuto::noCellCenteredEvents(int sectNum) const {
+  return solver_->noCellCenteredEvents(sectNum);
+}
+
+double SolverAuto::getLocalMaxAvgPropensityPerPossEvent() {
+  return localMaxAvgPropensityPerPossEventOf(*solver_);
+}
+
+double SolverAuto::getLocalMaxSinglePropensity() {
+  return localMaxSinglePropensityOf(*solver_);
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef SOLVER_AUTO_HPP
+#define SOLVER_AUTO_HPP
+
+#include "Solver.hpp"
+#include "ParamsForSolvers.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Implements SolverId::AUTO. This delegates to one of the built-in
+  // solvers, which it chooses by timing short bursts of choosing and
+  // updating events on each of them, using a copy of the actual event
+  // list. This happens after the event list is first built, and then
+  // again after a number of events proportional to the size of the
+  // event list have been chosen. The event list is then migrated to
+  // the fastest solver, which draws from the same random-number
+  // generator as before, so that the trajectory remains a correct
+  // sample of the same process.
+  class SolverAuto : public Solver {
+  public:
+    SolverAuto(const Lattice * lattice, const SolverParams & params);
+
+    virtual void setRNG(RandNumGenSharedPtr rng);
+
+    virtual void setEventIdFlattening(const EventIdFlattening & eIdFlattening);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList();
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+#endif
+
+    const Lattice * lattice_;
+
+    // Parameters passed on to the candidate solvers.
+    SolverParams params_;
+
+    boost::scoped_ptr<Solver> solver_;
+    int solverId_;
+
+    // Saved from beginBuildingEventList(), for building the event
+    // lists of the candidate solvers.
+    int numOverLatticeEvents_, numReservedLatticePlanes_;
+
+    // Counts used to decide when to benchmark again, and to give the
+    // bursts the same ratio of updates to choices as the simulation.
+    bool benchmarkIsDue_;
+    std::size_t numChosenSinceBenchmark_, numUpdatedSinceBenchmark_;
+    std::size_t numChosenBetweenBenchmarks_;
+    double updatesPerChoice_;
+
+    // The bursts draw their random numbers from this rather than from
+    // rng_, so that benchmarking doesn't perturb the sequence of
+    // random numbers used by the simulation.
+    RandNumGenSharedPtr benchmarkRNG_;
+
+    // Copy of the event list, one vector per sector, and the indices
+    // (into the concatenation of all sectors) of the cell-centered
+    // entries, which are the only ones that can be updated.
+    std::vector<std::vector<EventId> > eIds_;
+    std::vector<std::vector<double> > propensities_;
+    std::vector<int> cellCenteredSectNums_;
+    std::vector<std::size_t> cellCenteredInds_, touchedInds_;
+    std::vector<int> nonEmptySectNums_;
+
+    void benchmarkAndMigrate_();
+
+    Solver * mkCandidate_(int sId);
+
+    // Returns the CPU time taken by a burst on the given solver, or
+    // gives up and returns a negative number once the burst has taken
+    // longer than timeToBeat (if timeToBeat is non-negative).
+    double timeBurst_(Solver & candidate, double timeToBeat);
+
+    bool rejectionIsHopeless_() const;
+  };
+
+}
+
+#endif /* SOLVER_AUTO_HPP */
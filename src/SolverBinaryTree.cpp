@@ -1,5 +1,7 @@
 #include "SolverBinaryTree.hpp"
+#include "MemoryUsage.hpp"
 #include "Lattice.hpp"
+#include "ParamsForSolvers.hpp"
 
 #include <cmath>
 #include <algorithm>
@@ -7,39 +9,45 @@
 
 using namespace KMCThinFilm;
 
-SolverBinaryTree::SolverBinaryTree(const Lattice * lattice)
+SolverBinaryTree::SolverBinaryTree(const Lattice * lattice,
+				   const SolverParams & params)
   : 
 #if KMC_PARALLEL
   Solver(lattice),
 #endif
   events_(lattice->numSectors()),
   treeNodes_(lattice->numSectors()),
-  lattice_(lattice)
+  spatiallyOrdered_(params.getParamOrReturnDefaultVal(SolverParam::SPATIALLY_ORDERED_LEAVES, 0) != 0),
+  numHoles_(lattice->numSectors(), 0),
+  numUnsortedLeaves_(lattice->numSectors(), 0),
+  dirtyNodes_(lattice->numSectors())
 #if KMC_PARALLEL
   , numOverLatticeEvents_(lattice->numSectors(),0),
-  totOverLatticePropensity_(lattice->numSectors(),0)
+  totOverLatticePropensity_(lattice->numSectors(),0),
+  cellCenteredMaxTrees_(lattice->numSectors())
 #endif
 {}
 
 void SolverBinaryTree::beginBuildingEventList(int numOverLatticeEvents,
                                               int numReservedLatticePlanes) {
 
-  // WARNING: EventId::dimsForFlattening_ *must* be defined before using this.
-  evIdToNodeId_.reset(new EventIdMap<NodeId>(events_.size(),
+  evIdToNodeId_.reset(new EventIdMap<NodeId>(eIdFlattening_,
+                                             events_.size(),
                                              numOverLatticeEvents,
                                              numReservedLatticePlanes,
                                              -1));
 
+  // Storage for the tree is not reserved here, since reserving it
+  // for every possible event of every reserved plane wastes memory on
+  // planes far below the surface, which have no events. Instead,
+  // clearing the tree keeps the capacity it had, which was sized by
+  // the number of events actually found, and the tree grows
+  // geometrically from there if needed.
   for (std::size_t i = 0; i < events_.size(); ++i) {
     events_[i].clear();
     treeNodes_[i].clear();
-
-    LatticePlanarBBox sectorBBox;
-    lattice_->getSectorPlanarBBox(i, sectorBBox);
-    treeNodes_[i].reserve(numReservedLatticePlanes*
-                          (sectorBBox.imaxP1 - sectorBBox.imin)*
-                          (sectorBBox.jmaxP1 - sectorBBox.jmin)*
-                          EventId::dimsForFlattening_[2]);
+    dirtyNodes_[i].clear();
+    numHoles_[i] = numUnsortedLeaves_[i] = 0;
 
 #if KMC_PARALLEL
     numOverLatticeEvents_[i] = 0;
@@ -65,6 +73,18 @@ void SolverBinaryTree::addCellCenteredEntryToEventList(const EventId & eId,
   appendLeafRaw_(eId, propensity, sectNum);
 }
 
+void SolverBinaryTree::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+							 const std::vector<double> & propensities,
+							 int sectNum) {
+
+  // The whole batch is appended to the leaves at once. Nothing else
+  // is done until endBuildingEventList(), when the internal nodes
+  // are built over all the leaves by a single pass of
+  // makeIntNodes_(), so building the tree takes O(N) time.
+  events_[sectNum].insert(events_[sectNum].end(), eIds.begin(), eIds.end());
+  treeNodes_[sectNum].insert(treeNodes_[sectNum].end(), propensities.begin(), propensities.end());
+}
+
 void SolverBinaryTree::addOverLatticeEntryToEventList(const EventId & eId,
 						      double propensity,
 						      int sectNum) {
@@ -79,7 +99,13 @@ void SolverBinaryTree::addOverLatticeEntryToEventList(const EventId & eId,
 void SolverBinaryTree::endBuildingEventList() {
 
   for (int i = 0; i < static_cast<int>(events_.size()); ++i) {
-    makeIntNodes_(i);
+    if (spatiallyOrdered_) {
+      // The propensities are still at the start of treeNodes_[i].
+      sortLeaves_(i, 0);
+    }
+    else {
+      makeIntNodes_(i);
+    }
   }
 
 }
@@ -97,7 +123,24 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
        address maps now. */
 
     if (currPropensity > 0) {
-      appendLeaf_(eId, currPropensity, sectNum);
+
+      if ((nodeIdPtr != NULL) && (*nodeIdPtr < -1)) {
+	// Reclaiming the hole left when this event was removed.
+	std::size_t nodeInd = nodeIndOfHoleCode_(*nodeIdPtr);
+
+	treeNodes_[sectNum][nodeInd] = currPropensity;
+	*nodeIdPtr = nodeInd;
+	--(numHoles_[sectNum]);
+	markNodeAsDirty_(nodeInd, sectNum);
+
+#if KMC_PARALLEL
+	cellCenteredMaxTrees_[sectNum].setValue(nodeInd, currPropensity);
+#endif
+      }
+      else {
+	appendLeaf_(eId, currPropensity, sectNum);
+      }
+
     }
     
   }
@@ -114,7 +157,11 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
            entries need to be updated. */
 
 	origPropensity = currPropensity;
-	updateAncestorsOfLeafNode_(origNodeInd, sectNum);
+	markNodeAsDirty_(origNodeInd, sectNum);
+
+#if KMC_PARALLEL
+	cellCenteredMaxTrees_[sectNum].setValue(origNodeInd, currPropensity);
+#endif
       }
 
     }
@@ -127,12 +174,32 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
          ID list and then its associated entry in the address map.
       */
 
+      if (spatiallyOrdered_) {
+	// Leaving a hole, so as not to move any other leaf.
+	*nodeIdPtr = holeCode_(origNodeInd);
+	origPropensity = 0;
+	++(numHoles_[sectNum]);
+	markNodeAsDirty_(origNodeInd, sectNum);
+
+#if KMC_PARALLEL
+	cellCenteredMaxTrees_[sectNum].setValue(origNodeInd, 0);
+#endif
+	return;
+      }
+
       std::size_t origLeafInd = origNodeInd - (events_[sectNum].size() - 1);
       EventId & origEventId = events_[sectNum][origLeafInd];
 
-      // "Erasing" the map entry corresponding to the element to be
-      // removed by setting it to an invalid (i.e. negative) value.
-      *nodeIdPtr = -1;
+      // Erasing the map entry corresponding to the element to be
+      // removed. This may free the page holding it, so nodeIdPtr
+      // isn't used after this.
+      evIdToNodeId_->remove(eId);
+
+#if KMC_PARALLEL
+      // Zeroing this first, so that it isn't left behind if the
+      // removed leaf is the last one.
+      cellCenteredMaxTrees_[sectNum].setValue(origNodeInd, 0);
+#endif
       
       if ((origLeafInd + 1) != events_[sectNum].size()) {
 	// "Removing" the event by replacing it with a copy of the event
@@ -141,7 +208,11 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
         origPropensity = treeNodes_[sectNum].back();
 
 	evIdToNodeId_->getRefToVal(origEventId) = origNodeInd;
-	updateAncestorsOfLeafNode_(origNodeInd, sectNum);
+	markNodeAsDirty_(origNodeInd, sectNum);
+
+#if KMC_PARALLEL
+	moveCellCenteredMax_(treeNodes_[sectNum].size() - 1, origNodeInd, sectNum);
+#endif
       }
 
       // Removing the last leaf, which is now redundant with any copy made above.
@@ -156,6 +227,11 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
         // 2*events_[sectNum].size(). The index of the last non-leaf
         // node, then, is events_[sectNum].size() - 1.
         treeNodes_[sectNum][events_[sectNum].size() - 1] = treeNodes_[sectNum].back();
+
+#if KMC_PARALLEL
+        moveCellCenteredMax_(treeNodes_[sectNum].size() - 1, events_[sectNum].size() - 1, sectNum);
+#endif
+
         treeNodes_[sectNum].pop_back();
 
         events_[sectNum].push_front(events_[sectNum].back());
@@ -166,7 +242,7 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
 
 	evIdToNodeId_->getRefToVal(events_[sectNum].front()) = events_[sectNum].size() - 1;
 
-	updateAncestorsOfLeafNode_(events_[sectNum].size() - 1, sectNum);
+	markNodeAsDirty_(events_[sectNum].size() - 1, sectNum);
       }
 
     }
@@ -175,26 +251,73 @@ void SolverBinaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & e
 
 }
 
+bool SolverBinaryTree::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							      double currPropensity,
+							      int sectNum) {
+
+  // There are few over-lattice events, so rather than being updated
+  // in place, the old entry is removed and the new one added. Both
+  // go through the same code as for a cell-centered entry, apart
+  // from the bookkeeping of the over-lattice entries.
+
+  NodeId * nodeIdPtr = evIdToNodeId_->getPtrToVal(eId);
+
+  if ((nodeIdPtr != NULL) && (*nodeIdPtr >= 0)) {
+
+#if KMC_PARALLEL
+    --(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] -= treeNodes_[sectNum][*nodeIdPtr];
+#endif
+
+    addOrUpdateCellCenteredEntryToEventList(eId, 0, sectNum);
+  }
+
+  if (currPropensity > 0) {
+    addOrUpdateCellCenteredEntryToEventList(eId, currPropensity, sectNum);
+
+#if KMC_PARALLEL
+    ++(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] += currPropensity;
+    cellCenteredMaxTrees_[sectNum].setValue(evIdToNodeId_->getRefToVal(eId), 0);
+#endif
+  }
+
+  return true;
+}
+
 void SolverBinaryTree::chooseEventIDAndUpdateTime(int sectNum,
                                                   EventId & chosenEventID,
                                                   double & time) {
 
+  if (spatiallyOrdered_ &&
+      ((numUnsortedLeaves_[sectNum] + numHoles_[sectNum]) > events_[sectNum].size())) {
+    sortLeaves_(sectNum, events_[sectNum].size() - 1);
+  }
+
+  updateDirtyAncestors_(sectNum);
+
   double R;
   
-  std::size_t chosenChildInd = 0;
+  std::size_t chosenChildInd;
   std::size_t numIntNodes = events_[sectNum].size() - 1;
 
-  // The first "if" is factored out from the "while" loop so that R is
-  // not calculated unless events_[sectNum].size() > 1.
+  // Holes have zero propensity, and so can only be reached through
+  // roundoff in R, in which case the choice is simply made again.
+  do {
+    chosenChildInd = 0;
 
-  if (chosenChildInd < numIntNodes) {      
-    R = (treeNodes_[sectNum].front())*(rng_->getNumInOpenIntervalFrom0To1());      
-    chooseChildInd_(sectNum, chosenChildInd, R); 
-  }
+    // The first "if" is factored out from the "while" loop so that R is
+    // not calculated unless events_[sectNum].size() > 1.
 
-  while (chosenChildInd < numIntNodes) {      
-    chooseChildInd_(sectNum, chosenChildInd, R); 
-  }
+    if (chosenChildInd < numIntNodes) {      
+      R = (treeNodes_[sectNum].front())*(rng_->getNumInOpenIntervalFrom0To1());      
+      chooseChildInd_(sectNum, chosenChildInd, R); 
+    }
+
+    while (chosenChildInd < numIntNodes) {      
+      chooseChildInd_(sectNum, chosenChildInd, R); 
+    }
+  } while ((numHoles_[sectNum] > 0) && !(treeNodes_[sectNum][chosenChildInd] > 0));
 
   chosenEventID = events_[sectNum][chosenChildInd - numIntNodes];
 
@@ -202,30 +325,106 @@ void SolverBinaryTree::chooseEventIDAndUpdateTime(int sectNum,
 }
 
 bool SolverBinaryTree::noMoreEvents(int sectNum) const {
-  return events_[sectNum].empty();
+  return (events_[sectNum].size() == numHoles_[sectNum]);
+}
+
+double SolverBinaryTree::totalPropensity(int sectNum) {
+  updateDirtyAncestors_(sectNum);
+
+  // If every leaf is a hole, then the root is zero (up to roundoff).
+  if (noMoreEvents(sectNum)) {
+    return 0;
+  }
+
+  return (events_[sectNum].empty() ? 0 : treeNodes_[sectNum].front());
+}
+
+std::size_t SolverBinaryTree::memoryUsage() const {
+  std::size_t numBytes = memoryUsageOf(events_) + memoryUsageOf(treeNodes_) + memoryUsageOf(dirtyNodes_) +
+    memoryUsageOf(nodesToUpdateByDepth_) + memoryUsageOf(nodeIsMarked_) + memoryUsageOf(leavesToSort_);
+
+  if (evIdToNodeId_) {
+    numBytes += evIdToNodeId_->memoryUsage();
+  }
+
+#if KMC_PARALLEL
+  numBytes += memoryUsageOfEach(cellCenteredMaxTrees_);
+#endif
+
+  return numBytes;
+}
+
+void SolverBinaryTree::appendEventList(int sectNum,
+				       std::vector<EventId> & eIds,
+				       std::vector<double> & propensities) const {
+
+  const std::deque<EventId> & events = events_[sectNum];
+
+  if (!events.empty()) {
+    // The leaves are always up to date, even if their ancestors are
+    // dirty.
+    const std::vector<double> & nodes = treeNodes_[sectNum];
+    std::size_t numIntNodes = events.size() - 1;
+
+    if (numHoles_[sectNum] == 0) {
+      eIds.insert(eIds.end(), events.begin(), events.end());
+      propensities.insert(propensities.end(), nodes.begin() + numIntNodes, nodes.end());
+    }
+    else {
+      for (std::size_t i = 0; i < events.size(); ++i) {
+	if (nodes[i + numIntNodes] > 0) {
+	  eIds.push_back(events[i]);
+	  propensities.push_back(nodes[i + numIntNodes]);
+	}
+      }
+    }
+  }
+
 }
 
 void SolverBinaryTree::appendLeaf_(const EventId & eId,
                                    double propensity, int sectNum) {
 
+#if KMC_PARALLEL
+  // At most two nodes are appended below.
+  cellCenteredMaxTrees_[sectNum].reserveSlots(treeNodes_[sectNum].size() + 2);
+#endif
+
   if (!events_[sectNum].empty()) {
 
     // Note: events_[sectNum].size() - 1 is index of first leaf.
     treeNodes_[sectNum].push_back(treeNodes_[sectNum][events_[sectNum].size() - 1]);
 
+#if KMC_PARALLEL
+    moveCellCenteredMax_(events_[sectNum].size() - 1, treeNodes_[sectNum].size() - 1, sectNum);
+#endif
+
     events_[sectNum].push_back(events_[sectNum].front());
     events_[sectNum].pop_front();
 
-    evIdToNodeId_->getRefToVal(events_[sectNum].back()) = treeNodes_[sectNum].size() - 1;
+    // The moved leaf may be a hole, in which case its event has to be
+    // able to find it again.
+    std::size_t movedNodeInd = treeNodes_[sectNum].size() - 1;
+    evIdToNodeId_->getRefToVal(events_[sectNum].back()) =
+      ((treeNodes_[sectNum].back() > 0) ? static_cast<NodeId>(movedNodeInd) : holeCode_(movedNodeInd));
+  }
+
+  if (spatiallyOrdered_) {
+    ++(numUnsortedLeaves_[sectNum]);
   }
 
   evIdToNodeId_->addOrUpdate(eId, treeNodes_[sectNum].size());
+
+#if KMC_PARALLEL
+  cellCenteredMaxTrees_[sectNum].setValue(treeNodes_[sectNum].size(), propensity);
+#endif
+
   treeNodes_[sectNum].push_back(propensity);
   events_[sectNum].push_back(eId);
    
-  // Only need to do the update once, since the two appended leaves
-  // are children of the same parent.
-  updateAncestorsOfLeafNode_(treeNodes_[sectNum].size() - 1, sectNum);
+  // Only need to mark one node as dirty, since the two appended
+  // leaves are children of the same parent.
+  markNodeAsDirty_(treeNodes_[sectNum].size() - 1, sectNum);
 }
 
 void SolverBinaryTree::makeIntNodes_(int sectNum) {
@@ -274,36 +473,206 @@ void SolverBinaryTree::makeIntNodes_(int sectNum) {
     evIdToNodeId_->addOrUpdate(events_[sectNum][i], i + numIntNodes);
   }
 
+#if KMC_PARALLEL
+  std::vector<double> cellCenteredNodeVals(treeNodes_[sectNum].size(), 0);
+
+  for (std::size_t i = 0; i < numPropensities; ++i) {
+    if (!events_[sectNum][i].isForOverLattice()) {
+      cellCenteredNodeVals[i + numIntNodes] = treeNodes_[sectNum][i + numIntNodes];
+    }
+  }
+
+  cellCenteredMaxTrees_[sectNum].assign(cellCenteredNodeVals);
+#endif
+
+}
+
+namespace {
+
+  // Spreads the lowest 21 bits of x so that there are two zero bits
+  // between each of them.
+  inline boost::uint64_t spreadBitsBy3(boost::uint64_t x) {
+    x &= UINT64_C(0x1fffff);
+    x = (x | (x << 32)) & UINT64_C(0x1f00000000ffff);
+    x = (x | (x << 16)) & UINT64_C(0x1f0000ff0000ff);
+    x = (x | (x << 8)) & UINT64_C(0x100f00f00f00f00f);
+    x = (x | (x << 4)) & UINT64_C(0x10c30c30c30c30c3);
+    x = (x | (x << 2)) & UINT64_C(0x1249249249249249);
+    return x;
+  }
+
+  // Position of (i, j, k) along a three-dimensional Z-order curve.
+  inline boost::uint64_t mortonKey(int i, int j, int k) {
+    return spreadBitsBy3(i) | (spreadBitsBy3(j) << 1) | (spreadBitsBy3(k) << 2);
+  }
+
+}
+
+SolverBinaryTree::SortableLeaf_::SortableLeaf_(const EventId & myEId, double myPropensity,
+					       const EventIdFlattening & eIdFlattening)
+  : eId(myEId), propensity(myPropensity) {
+
+  if (eId.isForOverLattice()) {
+    int sectNum;
+    cellKey = 0;
+    eId.getEventInfo(eventInd, sectNum);
+  }
+  else {
+    CellInds ci;
+    eIdFlattening.getEventInfo(eId, ci, eventInd);
+
+    // Adding one, so that over-lattice events come first.
+    cellKey = mortonKey(ci.i - eIdFlattening.iMin(), ci.j - eIdFlattening.jMin(), ci.k) + 1;
+  }
+}
+
+void SolverBinaryTree::sortLeaves_(int sectNum, std::size_t firstLeafInd) {
+
+  std::deque<EventId> & events = events_[sectNum];
+  std::vector<double> & treeNodes = treeNodes_[sectNum];
+
+  leavesToSort_.clear();
+
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    double propensity = treeNodes[firstLeafInd + i];
+
+    if (propensity > 0) {
+      leavesToSort_.push_back(SortableLeaf_(events[i], propensity, eIdFlattening_));
+    }
+    else {
+      // Discarding the hole
+      evIdToNodeId_->remove(events[i]);
+    }
+  }
+
+  std::sort(leavesToSort_.begin(), leavesToSort_.end());
+
+  // Putting the propensities at the start of treeNodes, where
+  // makeIntNodes_() expects them.
+  events.clear();
+  treeNodes.clear();
+
+  for (std::vector<SortableLeaf_>::const_iterator itr = leavesToSort_.begin(),
+	 itrEnd = leavesToSort_.end(); itr != itrEnd; ++itr) {
+    events.push_back(itr->eId);
+    treeNodes.push_back(itr->propensity);
+  }
+
+  dirtyNodes_[sectNum].clear();
+  numHoles_[sectNum] = numUnsortedLeaves_[sectNum] = 0;
+
+  makeIntNodes_(sectNum);
+}
+
+namespace {
+
+  // Depth of node nodeInd in a binary tree stored as a heap,
+  // i.e. floor(log2(nodeInd + 1)).
+  inline int depthOfNode(std::size_t nodeInd) {
+    int depth = 0;
+    for (std::size_t n = nodeInd + 1; n > 1; n /= 2) {
+      ++depth;
+    }
+    return depth;
+  }
+
 }
 
-void SolverBinaryTree::updateAncestorsOfLeafNode_(std::size_t nodeInd, int sectNum) {
+void SolverBinaryTree::updateDirtyAncestors_(int sectNum) {
+
+  std::vector<std::size_t> & dirtyNodes = dirtyNodes_[sectNum];
+
+  if (dirtyNodes.empty()) {
+    return;
+  }
+
+  std::vector<double> & treeNodes = treeNodes_[sectNum];
+
+  int maxDepth = depthOfNode(treeNodes.size() - 1);
+
+  if (static_cast<int>(nodesToUpdateByDepth_.size()) <= maxDepth) {
+    nodesToUpdateByDepth_.resize(maxDepth + 1);
+  }
+
+  if (nodeIsMarked_.size() < treeNodes.size()) {
+    nodeIsMarked_.resize(treeNodes.size(), 0);
+  }
+
+  // Since the tree is complete, leaves are at either the deepest
+  // level or the one above it, so the depth calculation can usually
+  // be skipped.
+  std::size_t firstNodeAtMaxDepth = (static_cast<std::size_t>(1) << maxDepth) - 1;
+
+  for (std::vector<std::size_t>::const_iterator itr = dirtyNodes.begin(),
+	 itrEnd = dirtyNodes.end(); itr != itrEnd; ++itr) {
+
+    // Removing leaves shrinks the tree, so a node recorded before a
+    // removal may no longer exist. If so, then whatever leaf was moved
+    // out of it was recorded again at its new position.
+    if (*itr >= treeNodes.size()) {
+      continue;
+    }
+
+    int depth = ((*itr >= firstNodeAtMaxDepth) ? maxDepth :
+		 ((2*(*itr) + 1 >= firstNodeAtMaxDepth) ? maxDepth - 1 : depthOfNode(*itr)));
+
+    nodesToUpdateByDepth_[depth].push_back(*itr);
+  }
+
+  dirtyNodes.clear();
+
+  // Going up the tree one level at a time, so that every node in a
+  // level is recalculated once, after all of its children have been.
+  for (int depth = maxDepth; depth > 0; --depth) {
+
+    std::vector<std::size_t> & currLevel = nodesToUpdateByDepth_[depth];
+    std::vector<std::size_t> & parentLevel = nodesToUpdateByDepth_[depth - 1];
 
-  std::size_t parentId = nodeInd;
+    // Dirty leaves may already be in parentLevel. They need their own
+    // parents updated, but aren't recalculated themselves.
+    std::size_t firstParentInd = parentLevel.size();
 
-  while (parentId > 0) {
-    parentId = (parentId - 1)/2;
+    for (std::vector<std::size_t>::const_iterator itr = currLevel.begin(),
+	   itrEnd = currLevel.end(); itr != itrEnd; ++itr) {
+      std::size_t parentInd = (*itr - 1)/2;
+
+      if (!nodeIsMarked_[parentInd]) {
+	nodeIsMarked_[parentInd] = 1;
+	parentLevel.push_back(parentInd);
+      }
+    }
 
-    std::size_t leftChildInd = 2*parentId + 1;
-    std::size_t rightChildInd = leftChildInd + 1;
+    currLevel.clear();
+
+    for (std::size_t i = firstParentInd; i < parentLevel.size(); ++i) {
+      std::size_t parentInd = parentLevel[i];
+      std::size_t leftChildInd = 2*parentInd + 1;
+      std::size_t rightChildInd = leftChildInd + 1;
+
+      treeNodes[parentInd] = treeNodes[leftChildInd] + treeNodes[rightChildInd];
+      nodeIsMarked_[parentInd] = 0;
+    }
 
-    treeNodes_[sectNum][parentId] = treeNodes_[sectNum][leftChildInd] + treeNodes_[sectNum][rightChildInd];
   }
 
+  nodesToUpdateByDepth_[0].clear();
 }
 
 #if KMC_PARALLEL
 
 std::size_t SolverBinaryTree::numCellCenteredEvents_(int sectNum) const {
-  return (events_[sectNum].size() - numOverLatticeEvents_[sectNum]);
+  return (events_[sectNum].size() - numOverLatticeEvents_[sectNum] - numHoles_[sectNum]);
 }
 
 bool SolverBinaryTree::noCellCenteredEvents(int sectNum) const {
   return !(numCellCenteredEvents_(sectNum) > 0);
 }
 
-double SolverBinaryTree::getLocalMaxAvgPropensityPerPossEvent() const {
+double SolverBinaryTree::getLocalMaxAvgPropensityPerPossEvent() {
   double ps_local_max = 0;
   for (std::size_t i = 0; i < treeNodes_.size(); ++i) {
+    updateDirtyAncestors_(i);
+
     std::size_t nPossEventsPerSector = numCellCenteredEvents_(i);
     
     if (nPossEventsPerSector > 0) {
@@ -325,30 +694,11 @@ double SolverBinaryTree::getLocalMaxAvgPropensityPerPossEvent() const {
   return ps_local_max;
 }
 
-double SolverBinaryTree::getLocalMaxSinglePropensity() const {
+double SolverBinaryTree::getLocalMaxSinglePropensity() {
   double ps_local_max = 0;
-  for (std::size_t i = 0; i < events_.size(); ++i) {
-
-    double p_s = 0;
-
-    if (numCellCenteredEvents_(i) > 0) {
-
-      std::size_t nodeIndMin = events_[i].size() - 1;
-
-      for (std::size_t nodeInd = nodeIndMin; 
-           nodeInd < treeNodes_[i].size(); ++nodeInd) {
-	
-	if (events_[i][nodeInd - nodeIndMin].isForOverLattice()) {
-	  continue;
-	}
+  for (std::size_t i = 0; i < cellCenteredMaxTrees_.size(); ++i) {
 
-	if (treeNodes_[i][nodeInd] > p_s) {
-	  p_s = treeNodes_[i][nodeInd];
-	}
-
-      }
-
-    }
+    double p_s = cellCenteredMaxTrees_[i].max();
 
     if (p_s > ps_local_max) {
       ps_local_max = p_s;
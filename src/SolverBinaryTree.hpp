@@ -3,19 +3,22 @@
 
 #include "Solver.hpp"
 #include "EventIdMap.hpp"
+#include "MaxTree.hpp"
 
 #include <vector>
 #include <deque>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
 
 namespace KMCThinFilm {
 
   class Lattice;
+  class SolverParams;
 
   class SolverBinaryTree : public Solver {
   public:
-    SolverBinaryTree(const Lattice * lattice);
+    SolverBinaryTree(const Lattice * lattice, const SolverParams & params);
 
     virtual void beginBuildingEventList(int numOverLatticeEvents,
                                         int numReservedLatticePlanes);
@@ -24,6 +27,10 @@ namespace KMCThinFilm {
 						 double propensity,
 						 int sectNum);
     
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
     virtual void addOverLatticeEntryToEventList(const EventId & eId,
 						double propensity,
 						int sectNum);
@@ -34,12 +41,24 @@ namespace KMCThinFilm {
 							 double currPropensity,
 							 int sectNum);
 
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
     virtual void chooseEventIDAndUpdateTime(int sectNum,
 					    EventId & chosenEventID,
 					    double & time);
 
     virtual bool noMoreEvents(int sectNum) const;
 
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
 #if KMC_PARALLEL
     virtual bool noCellCenteredEvents(int sectNum) const;
 #endif
@@ -47,16 +66,29 @@ namespace KMCThinFilm {
   private:
 
 #if KMC_PARALLEL
-    virtual double getLocalMaxAvgPropensityPerPossEvent() const;
-    virtual double getLocalMaxSinglePropensity() const;
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
 
     std::vector<std::size_t> numOverLatticeEvents_;
     std::vector<double> totOverLatticePropensity_;
+
+    // One per sector, indexed in the same way as treeNodes_, with
+    // the leaves of cell-centered events holding their propensities
+    // and all other nodes holding zero, so that the maximum
+    // cell-centered propensity is available without scanning the
+    // leaves.
+    std::vector<MaxTree> cellCenteredMaxTrees_;
+
+    void moveCellCenteredMax_(std::size_t fromNodeInd, std::size_t toNodeInd,
+                              int sectNum) {
+      MaxTree & maxTree = cellCenteredMaxTrees_[sectNum];
+      maxTree.setValue(toNodeInd, maxTree.value(fromNodeInd));
+      maxTree.setValue(fromNodeInd, 0);
+    }
 #endif
 
     std::vector<std::deque<EventId> > events_;
     std::vector<std::vector<double> > treeNodes_;
-    const Lattice * lattice_;
 
     // Allows a node ID to be negative in order to indicate an invalid ID.
     typedef std::ptrdiff_t NodeId;
@@ -65,7 +97,73 @@ namespace KMCThinFilm {
 
     void makeIntNodes_(int sectNum);
 
-    void updateAncestorsOfLeafNode_(std::size_t nodeInd, int sectNum);
+    // If SolverParam::SPATIALLY_ORDERED_LEAVES is set, then the
+    // leaves are sorted in the Morton order of their cells when the
+    // event list is built. Removing an event then zeroes its leaf
+    // rather than filling the leaf with the last one, which would
+    // scatter the leaves over time. Such a zero leaf is a "hole",
+    // and evIdToNodeId_ maps the event to holeCode_() of the hole's
+    // node index, so that the event can reclaim its old leaf if it
+    // becomes possible again. Leaves appended at the end since the
+    // last sort are counted in numUnsortedLeaves_, and once they and
+    // the holes outnumber the leaves of a sector, the leaves are
+    // sorted again and the holes discarded. This keeps the cost of
+    // sorting to O(log N) per change, amortized.
+    bool spatiallyOrdered_;
+    std::vector<std::size_t> numHoles_, numUnsortedLeaves_;
+
+    static NodeId holeCode_(std::size_t nodeInd) {
+      return -static_cast<NodeId>(nodeInd) - 2;
+    }
+
+    static std::size_t nodeIndOfHoleCode_(NodeId code) {
+      return static_cast<std::size_t>(-(code + 2));
+    }
+
+    struct SortableLeaf_ {
+      // Over-lattice events have a cellKey of zero, and so come first.
+      boost::uint64_t cellKey;
+      int eventInd;
+
+      EventId eId;
+      double propensity;
+
+      SortableLeaf_(const EventId & myEId, double myPropensity,
+		    const EventIdFlattening & eIdFlattening);
+
+      bool operator<(const SortableLeaf_ & rhs) const {
+	return (cellKey < rhs.cellKey) || ((cellKey == rhs.cellKey) && (eventInd < rhs.eventInd));
+      }
+    };
+
+    // Scratch space for sortLeaves_(), kept between calls to avoid
+    // reallocating it.
+    std::vector<SortableLeaf_> leavesToSort_;
+
+    // Sorts the leaves of a sector, which start at index firstLeafInd
+    // of treeNodes_[sectNum], dropping any holes, and then rebuilds
+    // the internal nodes.
+    void sortLeaves_(int sectNum, std::size_t firstLeafInd);
+
+    // Rather than updating the ancestors of a leaf whenever the leaf
+    // changes, the leaf's node index is recorded in dirtyNodes_, and
+    // the union of the ancestors of all the recorded nodes is updated
+    // once, just before the tree is next used. Since a single event
+    // typically changes many propensities with shared ancestors, this
+    // avoids recalculating the upper levels of the tree many times
+    // over.
+    std::vector<std::vector<std::size_t> > dirtyNodes_;
+
+    // Scratch space for updateDirtyAncestors_(), kept between calls
+    // to avoid reallocating it.
+    std::vector<std::vector<std::size_t> > nodesToUpdateByDepth_;
+    std::vector<char> nodeIsMarked_;
+
+    void markNodeAsDirty_(std::size_t nodeInd, int sectNum) {
+      dirtyNodes_[sectNum].push_back(nodeInd);
+    }
+
+    void updateDirtyAncestors_(int sectNum);
 
     void appendLeafRaw_(const EventId & eId, double propensity,
 			int sectNum);
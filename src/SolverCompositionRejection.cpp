@@ -0,0 +1,455 @@
+#include "SolverCompositionRejection.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+#include "ErrorHandling.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // For a positive, finite double p, std::frexp(p, &e) returns a
+  // mantissa in [0.5, 1), so that p is in [2^(e-1), 2^e), where e is
+  // in [MIN_EXPONENT, MAX_EXPONENT].
+  const int MIN_EXPONENT = -1073;
+  const int MAX_EXPONENT = 1024;
+  const int NUM_GROUPS = MAX_EXPONENT - MIN_EXPONENT + 1;
+
+  // Minimum number of incremental updates to the sum of a group's
+  // propensities before that sum is recalculated from scratch.
+  const std::size_t MIN_UPDATES_BEFORE_RESUM = 64;
+
+}
+
+SolverCompositionRejection::SolverCompositionRejection(const Lattice * lattice)
+  :
+#if KMC_PARALLEL
+  Solver(lattice),
+  totOverLatticePropensity_(lattice->numSectors(),0),
+  numOverLatticeEvents_(lattice->numSectors(),0),
+#endif
+  groups_(lattice->numSectors(), std::vector<Group_>(NUM_GROUPS)),
+  nonEmptyGroups_(lattice->numSectors())
+{}
+
+int SolverCompositionRejection::groupIndOfPropensity_(double propensity) {
+  int e;
+  std::frexp(propensity, &e);
+  return e - MIN_EXPONENT;
+}
+
+void SolverCompositionRejection::beginBuildingEventList(int numOverLatticeEvents,
+							 int numReservedLatticePlanes) {
+
+  for (std::size_t i = 0; i < groups_.size(); ++i) {
+
+    // Only the non-empty groups need to be cleared.
+    for (std::vector<int>::const_iterator itr = nonEmptyGroups_[i].begin(),
+	   itrEnd = nonEmptyGroups_[i].end(); itr != itrEnd; ++itr) {
+      Group_ & group = groups_[i][*itr];
+      group.eIds.clear();
+      group.propensities.clear();
+      group.sumOfPropensities = 0;
+      group.numUpdatesSinceSum = 0;
+      group.indexToNonEmptyGroups = -1;
+#if KMC_PARALLEL
+      group.numOverLatticeEvents = 0;
+#endif
+    }
+
+    nonEmptyGroups_[i].clear();
+
+#if KMC_PARALLEL
+    numOverLatticeEvents_[i] = 0;
+    totOverLatticePropensity_[i] = 0;
+#endif
+  }
+
+  addrMap_.reset(new EventIdMap<GroupIndexPair_>(eIdFlattening_,
+						 groups_.size(),
+						 numOverLatticeEvents,
+						 numReservedLatticePlanes,
+						 GroupIndexPair_(-1, -1)));
+}
+
+void SolverCompositionRejection::updateSumOfPropensities_(Group_ & group, double change) {
+
+  if (++(group.numUpdatesSinceSum) > std::max(MIN_UPDATES_BEFORE_RESUM, group.propensities.size())) {
+    double sum = 0;
+    for (std::vector<double>::const_iterator itr = group.propensities.begin(),
+	   itrEnd = group.propensities.end(); itr != itrEnd; ++itr) {
+      sum += *itr;
+    }
+
+    group.sumOfPropensities = sum;
+    group.numUpdatesSinceSum = 0;
+  }
+  else {
+    group.sumOfPropensities += change;
+  }
+
+}
+
+void SolverCompositionRejection::addToGroup_(const EventId & eId, double propensity,
+					     int groupInd, int sectNum) {
+
+  Group_ & group = groups_[sectNum][groupInd];
+
+  if (group.indexToNonEmptyGroups < 0) {
+    group.indexToNonEmptyGroups = nonEmptyGroups_[sectNum].size();
+    nonEmptyGroups_[sectNum].push_back(groupInd);
+  }
+
+  addrMap_->addOrUpdate(eId, GroupIndexPair_(groupInd, group.eIds.size()));
+
+  group.eIds.push_back(eId);
+  group.propensities.push_back(propensity);
+
+  updateSumOfPropensities_(group, propensity);
+}
+
+void SolverCompositionRejection::removeFromGroup_(const GroupIndexPair_ & gip, int sectNum) {
+
+  Group_ & group = groups_[sectNum][gip.groupInd];
+  std::size_t origInd = gip.indexInGroup;
+
+  double origPropensity = group.propensities[origInd];
+
+  if ((origInd + 1) != group.eIds.size()) {
+    // Replace the removed entry with the entry at the rear, and
+    // update addrMap_ to reflect the replacement.
+    group.eIds[origInd] = group.eIds.back();
+    group.propensities[origInd] = group.propensities.back();
+
+    addrMap_->getRefToVal(group.eIds[origInd]).indexInGroup = origInd;
+  }
+
+  group.eIds.pop_back();
+  group.propensities.pop_back();
+
+  if (group.eIds.empty()) {
+    // Resetting the sum exactly, rather than letting roundoff leave a
+    // tiny nonzero weight on an empty group.
+    group.sumOfPropensities = 0;
+    group.numUpdatesSinceSum = 0;
+
+    std::vector<int> & currNonEmptyGroups = nonEmptyGroups_[sectNum];
+    Index origIndexToNonEmptyGroups = group.indexToNonEmptyGroups;
+
+    if ((origIndexToNonEmptyGroups + 1) != static_cast<Index>(currNonEmptyGroups.size())) {
+      currNonEmptyGroups[origIndexToNonEmptyGroups] = currNonEmptyGroups.back();
+      groups_[sectNum][currNonEmptyGroups[origIndexToNonEmptyGroups]].indexToNonEmptyGroups = origIndexToNonEmptyGroups;
+    }
+
+    currNonEmptyGroups.pop_back();
+    group.indexToNonEmptyGroups = -1;
+  }
+  else {
+    updateSumOfPropensities_(group, -origPropensity);
+  }
+
+}
+
+void SolverCompositionRejection::addCellCenteredEntryToEventList(const EventId & eId,
+								 double propensity,
+								 int sectNum) {
+  addToGroup_(eId, propensity, groupIndOfPropensity_(propensity), sectNum);
+}
+
+void SolverCompositionRejection::addOverLatticeEntryToEventList(const EventId & eId,
+								double propensity,
+								int sectNum) {
+  int groupInd = groupIndOfPropensity_(propensity);
+
+  addToGroup_(eId, propensity, groupInd, sectNum);
+
+#if KMC_PARALLEL
+  ++(groups_[sectNum][groupInd].numOverLatticeEvents);
+  ++(numOverLatticeEvents_[sectNum]);
+  totOverLatticePropensity_[sectNum] += propensity;
+#endif
+}
+
+void SolverCompositionRejection::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+									 double currPropensity,
+									 int sectNum) {
+
+  GroupIndexPair_ * gipPtr = addrMap_->getPtrToVal(eId);
+
+  if ((gipPtr == NULL) || (gipPtr->indexInGroup < 0)) {
+
+    /* If it wasn't in the address map before, but now has a
+       non-zero propensity, then it should be in the event and
+       address maps now. */
+
+    if (currPropensity > 0) {
+      addCellCenteredEntryToEventList(eId, currPropensity, sectNum);
+    }
+
+  }
+  else {
+
+    GroupIndexPair_ origGip = *gipPtr;
+
+    if (currPropensity > 0) {
+
+      Group_ & origGroup = groups_[sectNum][origGip.groupInd];
+      double & origPropensity = origGroup.propensities[origGip.indexInGroup];
+
+      if (origPropensity != currPropensity) {
+
+	int currGroupInd = groupIndOfPropensity_(currPropensity);
+
+	if (currGroupInd == origGip.groupInd) {
+	  // Staying in the same group only requires updating the sum.
+	  double change = currPropensity - origPropensity;
+	  origPropensity = currPropensity;
+	  updateSumOfPropensities_(origGroup, change);
+	}
+	else {
+	  removeFromGroup_(origGip, sectNum);
+	  addToGroup_(eId, currPropensity, currGroupInd, sectNum);
+	}
+
+      }
+
+    }
+    else {
+
+      /* If the current propensity is zero, then eId is associated
+         with an event that can't happen, so it is removed from its
+         group and its entry in the address map is invalidated. */
+
+      removeFromGroup_(origGip, sectNum);
+
+      addrMap_->remove(eId);
+    }
+
+  }
+
+}
+
+bool SolverCompositionRejection::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+									double currPropensity,
+									int sectNum) {
+
+  // There are few over-lattice events, so rather than being updated
+  // in place, the old entry is removed and the new one added.
+
+  GroupIndexPair_ * gipPtr = addrMap_->getPtrToVal(eId);
+
+  if ((gipPtr != NULL) && (gipPtr->indexInGroup >= 0)) {
+    GroupIndexPair_ origGip = *gipPtr;
+
+#if KMC_PARALLEL
+    Group_ & origGroup = groups_[sectNum][origGip.groupInd];
+
+    --(origGroup.numOverLatticeEvents);
+    --(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] -= origGroup.propensities[origGip.indexInGroup];
+#endif
+
+    removeFromGroup_(origGip, sectNum);
+    addrMap_->remove(eId);
+  }
+
+  if (currPropensity > 0) {
+    addOverLatticeEntryToEventList(eId, currPropensity, sectNum);
+  }
+
+  return true;
+}
+
+void SolverCompositionRejection::chooseEventIDAndUpdateTime(int sectNum,
+							    EventId & chosenEventID,
+							    double & time) {
+
+  const std::vector<int> & currNonEmptyGroups = nonEmptyGroups_[sectNum];
+  std::vector<Group_> & currGroups = groups_[sectNum];
+
+  double p_s = totalPropensity(sectNum);
+
+  // Composition step: choose a group with probability proportional
+  // to the sum of its propensities.
+
+  double R = p_s*(rng_->getNumInOpenIntervalFrom0To1());
+
+  // Defaulting to the last group in case roundoff makes R exceed the
+  // final partial sum.
+  int chosenGroupInd = currNonEmptyGroups.back();
+
+  double partialSum = 0;
+  for (std::vector<int>::const_iterator itr = currNonEmptyGroups.begin(),
+	 itrEnd = currNonEmptyGroups.end(); itr != itrEnd; ++itr) {
+    partialSum += currGroups[*itr].sumOfPropensities;
+    if (R < partialSum) {
+      chosenGroupInd = *itr;
+      break;
+    }
+  }
+
+  // Rejection step: choose an event uniformly from the group and
+  // accept it with probability propensity/(upper bound of group).
+
+  const Group_ & chosenGroup = currGroups[chosenGroupInd];
+  std::size_t groupSize = chosenGroup.eIds.size();
+  double propensityBound = std::ldexp(1.0, chosenGroupInd + MIN_EXPONENT);
+
+  std::size_t indInGroup;
+  do {
+    indInGroup = static_cast<std::size_t>(groupSize*(rng_->getNumInOpenIntervalFrom0To1()));
+
+    // Guarding against roundoff making indInGroup equal to groupSize.
+    if (indInGroup >= groupSize) {
+      indInGroup = groupSize - 1;
+    }
+
+  } while (propensityBound*(rng_->getNumInOpenIntervalFrom0To1()) >= chosenGroup.propensities[indInGroup]);
+
+  chosenEventID = chosenGroup.eIds[indInGroup];
+
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/p_s;
+}
+
+bool SolverCompositionRejection::noMoreEvents(int sectNum) const {
+  return nonEmptyGroups_[sectNum].empty();
+}
+
+double SolverCompositionRejection::totalPropensity(int sectNum) {
+  double p_s = 0;
+  for (std::vector<int>::const_iterator itr = nonEmptyGroups_[sectNum].begin(),
+	 itrEnd = nonEmptyGroups_[sectNum].end(); itr != itrEnd; ++itr) {
+    p_s += groups_[sectNum][*itr].sumOfPropensities;
+  }
+
+  return p_s;
+}
+
+std::size_t SolverCompositionRejection::memoryUsage() const {
+  std::size_t numBytes = groups_.capacity()*sizeof(std::vector<Group_>) + memoryUsageOf(nonEmptyGroups_);
+
+  for (std::vector<std::vector<Group_> >::const_iterator sectItr = groups_.begin(),
+	 sectItrEnd = groups_.end(); sectItr != sectItrEnd; ++sectItr) {
+
+    numBytes += sectItr->capacity()*sizeof(Group_);
+
+    for (std::vector<Group_>::const_iterator itr = sectItr->begin(),
+	   itrEnd = sectItr->end(); itr != itrEnd; ++itr) {
+      numBytes += memoryUsageOf(itr->eIds) + memoryUsageOf(itr->propensities);
+    }
+  }
+
+  if (addrMap_) {
+    numBytes += addrMap_->memoryUsage();
+  }
+
+  return numBytes;
+}
+
+void SolverCompositionRejection::appendEventList(int sectNum,
+						 std::vector<EventId> & eIds,
+						 std::vector<double> & propensities) const {
+
+  const std::vector<Group_> & currGroups = groups_[sectNum];
+  const std::vector<int> & currNonEmptyGroups = nonEmptyGroups_[sectNum];
+
+  for (std::vector<int>::const_iterator itr = currNonEmptyGroups.begin(),
+	 itrEnd = currNonEmptyGroups.end(); itr != itrEnd; ++itr) {
+    const Group_ & group = currGroups[*itr];
+    eIds.insert(eIds.end(), group.eIds.begin(), group.eIds.end());
+    propensities.insert(propensities.end(), group.propensities.begin(), group.propensities.end());
+  }
+
+}
+
+#if KMC_PARALLEL
+
+std::size_t SolverCompositionRejection::numCellCenteredEvents_(int sectNum) const {
+
+  std::size_t nPossEventsPerSector = 0;
+  for (std::vector<int>::const_iterator itr = nonEmptyGroups_[sectNum].begin(),
+	 itrEnd = nonEmptyGroups_[sectNum].end(); itr != itrEnd; ++itr) {
+    nPossEventsPerSector += groups_[sectNum][*itr].eIds.size();
+  }
+
+  nPossEventsPerSector -= numOverLatticeEvents_[sectNum];
+
+  return nPossEventsPerSector;
+}
+
+bool SolverCompositionRejection::noCellCenteredEvents(int sectNum) const {
+  return !(numCellCenteredEvents_(sectNum) > 0);
+}
+
+double SolverCompositionRejection::getLocalMaxAvgPropensityPerPossEvent() {
+
+  double ps_local_max = 0;
+
+  for (std::size_t i = 0; i < groups_.size(); ++i) {
+
+    std::size_t nPossEventsPerSector = numCellCenteredEvents_(i);
+
+    if (nPossEventsPerSector > 0) {
+
+      double p_s = totalPropensity(i) - totOverLatticePropensity_[i];
+      p_s /= nPossEventsPerSector;
+
+      if (p_s > ps_local_max) {
+        ps_local_max = p_s;
+      }
+    }
+
+  }
+
+  return ps_local_max;
+}
+
+double SolverCompositionRejection::getLocalMaxSinglePropensity() {
+
+  double propensityMaxLocal = 0;
+
+  for (std::size_t i = 0; i < groups_.size(); ++i) {
+
+    // Only the highest group containing a cell-centered event needs
+    // to be scanned, since every propensity in a lower group is
+    // smaller than every propensity in that group.
+    int highestGroupInd = -1;
+    for (std::vector<int>::const_iterator itr = nonEmptyGroups_[i].begin(),
+	   itrEnd = nonEmptyGroups_[i].end(); itr != itrEnd; ++itr) {
+
+      const Group_ & group = groups_[i][*itr];
+
+      // If all the events in the group are over-lattice events
+      if (group.eIds.size() == group.numOverLatticeEvents) {
+	continue;
+      }
+
+      if (*itr > highestGroupInd) {
+	highestGroupInd = *itr;
+      }
+    }
+
+    if (highestGroupInd < 0) {
+      continue;
+    }
+
+    const Group_ & highestGroup = groups_[i][highestGroupInd];
+    for (std::size_t j = 0; j < highestGroup.eIds.size(); ++j) {
+
+      if (highestGroup.eIds[j].isForOverLattice()) {
+	continue;
+      }
+
+      if (highestGroup.propensities[j] > propensityMaxLocal) {
+	propensityMaxLocal = highestGroup.propensities[j];
+      }
+    }
+
+  }
+
+  return propensityMaxLocal;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef SOLVER_COMPOSITION_REJECTION_HPP
+#define SOLVER_COMPOSITION_REJECTION_HPP
+
+#include "Solver.hpp"
+#include "EventIdMap.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Composition-rejection solver, after Slepoy, Thompson, and
+  // Plimpton, J. Chem. Phys. 128, 205101 (2008). Events are binned
+  // into groups such that all propensities in a group lie in
+  // [2^(e-1), 2^e) for some exponent e. A group is chosen by a
+  // linear search over the (few) non-empty groups, and then an event
+  // within that group is chosen by rejection sampling against the
+  // group's upper bound 2^e, which succeeds with probability greater
+  // than 1/2 per trial.
+  class SolverCompositionRejection : public Solver {
+  public:
+    SolverCompositionRejection(const Lattice * lattice);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList() {}
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+
+    std::vector<double> totOverLatticePropensity_;
+    std::vector<std::size_t> numOverLatticeEvents_;
+#endif
+
+    // Allows an index to be negative in order to indicate that the
+    // corresponding event ID is invalid.
+    typedef std::ptrdiff_t Index;
+
+    struct Group_ {
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+
+      double sumOfPropensities;
+
+      // Incrementally updating sumOfPropensities accumulates roundoff,
+      // so it is periodically recalculated from scratch.
+      std::size_t numUpdatesSinceSum;
+
+      // Position of this group in the list of non-empty groups, or -1
+      // if the group is empty.
+      Index indexToNonEmptyGroups;
+
+#if KMC_PARALLEL
+      std::size_t numOverLatticeEvents;
+#endif
+
+      Group_()
+	: sumOfPropensities(0), numUpdatesSinceSum(0), indexToNonEmptyGroups(-1)
+#if KMC_PARALLEL
+	, numOverLatticeEvents(0)
+#endif
+      {}
+    };
+
+    // One vector of groups per sector, indexed by the binary exponent
+    // of the propensities in the group (offset so that the smallest
+    // subnormal double maps to zero).
+    std::vector<std::vector<Group_> > groups_;
+
+    // One vector of indices of non-empty groups per sector. The
+    // composition step iterates over this instead of groups_.
+    std::vector<std::vector<int> > nonEmptyGroups_;
+
+    struct GroupIndexPair_ {
+      int groupInd;
+      Index indexInGroup;
+
+      GroupIndexPair_(int gInd, Index i)
+	: groupInd(gInd), indexInGroup(i)
+      {}
+    };
+
+    boost::scoped_ptr<EventIdMap<GroupIndexPair_> > addrMap_;
+
+    static int groupIndOfPropensity_(double propensity);
+
+    void addToGroup_(const EventId & eId, double propensity,
+		     int groupInd, int sectNum);
+
+    void removeFromGroup_(const GroupIndexPair_ & gip, int sectNum);
+
+    void updateSumOfPropensities_(Group_ & group, double change);
+
+#if KMC_PARALLEL
+    std::size_t numCellCenteredEvents_(int sectNum) const;
+#endif
+
+  };
+
+}
+
+#endif /* SOLVER_COMPOSITION_REJECTION_HPP */
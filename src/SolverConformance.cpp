@@ -0,0 +1,389 @@
+#include "SolverConformance.hpp"
+#include "SolverFactory.hpp"
+#include "SolverWithRateScales.hpp"
+#include "Lattice.hpp"
+#include "RandNumGenMT19937.hpp"
+#include "ErrorHandling.hpp"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  const int DOMAIN_SIZE = 8;
+  const int NUM_CELL_CEN_EVENTS = 2;
+  const int NUM_PLANES = 3;
+
+  const double OVER_LATTICE_PROPENSITY = 3;
+
+  // Applied to the cell-centered events with index 1 when a built-in
+  // solver is checked with rate scales.
+  const double RATE_SCALE = 2.5;
+
+  // Few distinct propensities, so that solvers that group events by
+  // propensity have groups with more than one event in them.
+  const double PROPENSITY_CHOICES[] = {0, 0.25, 1, 1, 2.5, 7};
+  const int NUM_PROPENSITY_CHOICES = sizeof(PROPENSITY_CHOICES)/sizeof(double);
+
+  typedef std::map<EventId, double> EventList;
+
+  // Thrown when the solver breaks its interface, so that
+  // checkSolverConformance() can report it rather than exit.
+  class ConformanceFailure : public std::runtime_error {
+  public:
+    ConformanceFailure(const std::string & msg)
+      : std::runtime_error(msg)
+    {}
+  };
+
+  class ConformanceCheck {
+  public:
+    // If rateScalingSolver is not NULL, it must be the same object as
+    // solver, and a rate scale is set once the event list is built.
+    ConformanceCheck(Solver * solver, RandNumGenSharedPtr rng,
+		     SolverWithRateScales * rateScalingSolver = NULL)
+      : solver_(solver), rng_(rng),
+	eIdFlattening_(0, 0, DOMAIN_SIZE, DOMAIN_SIZE, NUM_CELL_CEN_EVENTS),
+	rateScalingSolver_(rateScalingSolver),
+	rateScales_(NUM_CELL_CEN_EVENTS, 1.0)
+    {
+      solver_->setRNG(rng_);
+      solver_->setEventIdFlattening(eIdFlattening_);
+    }
+
+    void run() {
+      build_();
+      checkEventList_("after building the event list");
+
+      if (rateScalingSolver_ != NULL) {
+	rateScales_[1] = RATE_SCALE;
+	rateScalingSolver_->setRateScale(1, RATE_SCALE);
+	checkEventList_("after setting a rate scale");
+      }
+
+      update_();
+
+      updateOverLatticeEvents_();
+
+      choose_();
+
+      removeCellCenteredEvents_();
+      checkEventList_("after removing every cell-centered event");
+      checkOnlyOverLatticeEventIsChosen_();
+
+      solver_->beginBuildingEventList(0, 1);
+      solver_->endBuildingEventList();
+      eventList_.clear();
+      checkEventList_("after building an empty event list");
+    }
+
+  private:
+    boost::scoped_ptr<Solver> solver_;
+    RandNumGenSharedPtr rng_;
+    EventIdFlattening eIdFlattening_;
+
+    SolverWithRateScales * rateScalingSolver_;
+    std::vector<double> rateScales_;
+
+    // Holds the unscaled propensities.
+    EventList eventList_;
+
+    void require_(bool condition, const std::string & msg) const {
+      if (!condition) {
+	throw ConformanceFailure(msg);
+      }
+    }
+
+    int randInt_(int n) {
+      return std::min(static_cast<int>(n*(rng_->getNumInOpenIntervalFrom0To1())), n - 1);
+    }
+
+    EventId randCellCenteredEventId_(int numPlanes) {
+      CellInds ci(randInt_(DOMAIN_SIZE), randInt_(DOMAIN_SIZE), randInt_(numPlanes));
+      return eIdFlattening_.eventId(ci, randInt_(NUM_CELL_CEN_EVENTS));
+    }
+
+    double randPropensity_() {
+      return PROPENSITY_CHOICES[randInt_(NUM_PROPENSITY_CHOICES)];
+    }
+
+    double scaledPropensity_(EventList::const_iterator itr) const {
+      if (itr->first.isForOverLattice()) {
+	return itr->second;
+      }
+
+      CellInds ci;
+      int cellCenEventIndex;
+      eIdFlattening_.getEventInfo(itr->first, ci, cellCenEventIndex);
+
+      return rateScales_[cellCenEventIndex]*(itr->second);
+    }
+
+    void build_() {
+      solver_->beginBuildingEventList(1, NUM_PLANES - 1);
+
+      // Events in the lowest plane are added in a single batch, and
+      // those in the plane above it one at a time.
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+
+      CellInds ci;
+      for (ci.k = 0; ci.k < NUM_PLANES - 1; ++(ci.k)) {
+	for (ci.i = 0; ci.i < DOMAIN_SIZE; ++(ci.i)) {
+	  for (ci.j = 0; ci.j < DOMAIN_SIZE; ++(ci.j)) {
+	    for (int e = 0; e < NUM_CELL_CEN_EVENTS; ++e) {
+
+	      double propensity = randPropensity_();
+
+	      if (propensity > 0) {
+		EventId eId = eIdFlattening_.eventId(ci, e);
+		eventList_[eId] = propensity;
+
+		if (ci.k == 0) {
+		  eIds.push_back(eId);
+		  propensities.push_back(propensity);
+		}
+		else {
+		  solver_->addCellCenteredEntryToEventList(eId, propensity, 0);
+		}
+	      }
+	    }
+	  }
+	}
+
+	if (ci.k == 0) {
+	  solver_->addCellCenteredEntriesToEventList(eIds, propensities, 0);
+	}
+      }
+
+      EventId overLatticeEId(0, 0);
+      eventList_[overLatticeEId] = OVER_LATTICE_PROPENSITY;
+      solver_->addOverLatticeEntryToEventList(overLatticeEId, OVER_LATTICE_PROPENSITY, 0);
+
+      solver_->endBuildingEventList();
+    }
+
+    // Adds, updates and removes events at random, including events in
+    // a plane that was not reserved when the event list was built,
+    // and "removals" of events that aren't in the list.
+    void update_() {
+      const int numUpdates = 4000;
+
+      for (int u = 1; u <= numUpdates; ++u) {
+	EventId eId = randCellCenteredEventId_(NUM_PLANES);
+	double propensity = randPropensity_();
+
+	solver_->addOrUpdateCellCenteredEntryToEventList(eId, propensity, 0);
+
+	if (propensity > 0) {
+	  eventList_[eId] = propensity;
+	}
+	else {
+	  eventList_.erase(eId);
+	}
+
+	if (u % 500 == 0) {
+	  checkEventList_("after " + boost::lexical_cast<std::string>(u) + " updates");
+	}
+      }
+    }
+
+    // Changes the over-lattice event, and adds and removes others
+    // beyond the number given to beginBuildingEventList(), as
+    // Simulation does between runs. A solver that can't do this in
+    // place may refuse the first change, in which case Simulation
+    // builds the event list again instead.
+    void updateOverLatticeEvents_() {
+      EventId firstEId(0, 0), secondEId(1, 0), thirdEId(2, 0);
+
+      if (!solver_->addOrUpdateOverLatticeEntryToEventList(firstEId, 2*OVER_LATTICE_PROPENSITY, 0)) {
+	checkEventList_("after refusing to update an over-lattice event");
+	return;
+      }
+
+      eventList_[firstEId] = 2*OVER_LATTICE_PROPENSITY;
+      checkEventList_("after updating an over-lattice event");
+
+      solver_->addOrUpdateOverLatticeEntryToEventList(secondEId, 0.5*OVER_LATTICE_PROPENSITY, 0);
+      solver_->addOrUpdateOverLatticeEntryToEventList(thirdEId, OVER_LATTICE_PROPENSITY, 0);
+      eventList_[secondEId] = 0.5*OVER_LATTICE_PROPENSITY;
+      eventList_[thirdEId] = OVER_LATTICE_PROPENSITY;
+      checkEventList_("after adding over-lattice events");
+
+      solver_->addOrUpdateOverLatticeEntryToEventList(secondEId, 0, 0);
+      eventList_.erase(secondEId);
+      checkEventList_("after removing an over-lattice event");
+    }
+
+    // Checks that events are chosen in proportion to their
+    // propensities, with a chi-squared statistic, and that the mean
+    // time step is the reciprocal of the total propensity.
+    void choose_() {
+      const int numChoicesPerEvent = 400;
+
+      std::map<EventId, int> numTimesChosen;
+      int numChoices = numChoicesPerEvent*static_cast<int>(eventList_.size());
+      double totPropensity = 0;
+
+      for (EventList::const_iterator itr = eventList_.begin(),
+	     itrEnd = eventList_.end(); itr != itrEnd; ++itr) {
+	totPropensity += scaledPropensity_(itr);
+      }
+
+      double time = 0;
+
+      for (int c = 0; c < numChoices; ++c) {
+	EventId eId;
+	solver_->chooseEventIDAndUpdateTime(0, eId, time);
+
+	require_(eventList_.find(eId) != eventList_.end(),
+		 "chose an event that is not in the event list");
+
+	++(numTimesChosen[eId]);
+      }
+
+      double chiSq = 0;
+      for (EventList::const_iterator itr = eventList_.begin(),
+	     itrEnd = eventList_.end(); itr != itrEnd; ++itr) {
+	double expected = numChoices*scaledPropensity_(itr)/totPropensity;
+	double diff = numTimesChosen[itr->first] - expected;
+	chiSq += diff*diff/expected;
+      }
+
+      // Very unlikely to be exceeded by a correct solver, i.e., by
+      // more than seven standard deviations of the statistic.
+      double numDOF = eventList_.size() - 1;
+      double maxChiSq = numDOF + 7*std::sqrt(2*numDOF);
+
+      require_(chiSq < maxChiSq,
+	       "chose events out of proportion to their propensities (chi-squared = " +
+	       boost::lexical_cast<std::string>(chiSq) + " with " +
+	       boost::lexical_cast<std::string>(numDOF) + " degrees of freedom)");
+
+      double meanTimeStep = time/numChoices;
+      double expectedMeanTimeStep = 1/totPropensity;
+
+      require_(std::fabs(meanTimeStep - expectedMeanTimeStep) < 0.05*expectedMeanTimeStep,
+	       "mean time step " + boost::lexical_cast<std::string>(meanTimeStep) +
+	       " is not the reciprocal of the total propensity " +
+	       boost::lexical_cast<std::string>(totPropensity));
+    }
+
+    void removeCellCenteredEvents_() {
+      EventList::iterator itr = eventList_.begin();
+
+      while (itr != eventList_.end()) {
+	if (itr->first.isForOverLattice()) {
+	  ++itr;
+	}
+	else {
+	  solver_->addOrUpdateCellCenteredEntryToEventList(itr->first, 0, 0);
+	  eventList_.erase(itr++);
+	}
+      }
+    }
+
+    void checkOnlyOverLatticeEventIsChosen_() {
+      double time = 0;
+
+      for (int c = 0; c < 100; ++c) {
+	EventId eId;
+	solver_->chooseEventIDAndUpdateTime(0, eId, time);
+	require_(eId.isForOverLattice(),
+		 "chose a removed cell-centered event");
+      }
+    }
+
+    void checkEventList_(const std::string & when) {
+      std::string msgEnd = " " + when;
+
+      double expectedTotPropensity = 0;
+      for (EventList::const_iterator itr = eventList_.begin(),
+	     itrEnd = eventList_.end(); itr != itrEnd; ++itr) {
+	expectedTotPropensity += scaledPropensity_(itr);
+      }
+
+      double totPropensity = solver_->totalPropensity(0);
+      require_(std::fabs(totPropensity - expectedTotPropensity) <= 1e-9*expectedTotPropensity,
+	       "total propensity " + boost::lexical_cast<std::string>(totPropensity) +
+	       " should be " + boost::lexical_cast<std::string>(expectedTotPropensity) + msgEnd);
+
+      require_(solver_->noMoreEvents(0) == eventList_.empty(),
+	       "noMoreEvents() is wrong" + msgEnd);
+
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+      solver_->appendEventList(0, eIds, propensities);
+
+      require_(eIds.size() == propensities.size(),
+	       "appendEventList() gave different numbers of IDs and propensities" + msgEnd);
+      require_(eIds.size() == eventList_.size(),
+	       "appendEventList() gave " + boost::lexical_cast<std::string>(eIds.size()) +
+	       " events rather than " + boost::lexical_cast<std::string>(eventList_.size()) + msgEnd);
+
+      EventList appendedEventList;
+      for (std::size_t i = 0; i < eIds.size(); ++i) {
+	appendedEventList[eIds[i]] = propensities[i];
+      }
+
+      require_(appendedEventList == eventList_,
+	       "appendEventList() gave the wrong events or propensities" + msgEnd);
+    }
+
+  };
+
+}
+
+namespace KMCThinFilm {
+
+  int checkSolverConformance(int solverId, const SolverParams & params) {
+
+    exitOnCondition(!solverIsAvailable(solverId),
+		    "No solver is available with ID " +
+		    boost::lexical_cast<std::string>(solverId));
+
+    LatticeParams latParams;
+    latParams.numIntsPerCell = 1;
+    latParams.globalPlanarDims[0] = latParams.globalPlanarDims[1] = DOMAIN_SIZE;
+    latParams.latInit = AddEmptyPlanes(NUM_PLANES);
+
+    Lattice lattice(latParams);
+
+    RandNumGenSharedPtr rng(new RandNumGenMT19937(42));
+
+    try {
+      ConformanceCheck check(mkSolver(solverId, &lattice, params), rng);
+      check.run();
+    }
+    catch (const ConformanceFailure & failure) {
+      std::cerr << "Solver with ID " << solverId << ": " << failure.what() << std::endl;
+      return 1;
+    }
+
+    // Simulation wraps the built-in solvers to apply rate scales.
+    if (solverId < SolverId::MIN_CUSTOM_ID) {
+      try {
+	SolverWithRateScales * solver = new SolverWithRateScales(&lattice, solverId, params);
+	ConformanceCheck check(solver, rng, solver);
+	check.run();
+      }
+      catch (const ConformanceFailure & failure) {
+	std::cerr << "Solver with ID " << solverId << " and rate scales: " << failure.what() << std::endl;
+	return 1;
+      }
+    }
+
+    return 0;
+  }
+
+}
@@ -0,0 +1,46 @@
+#ifndef SOLVER_CONFORMANCE_HPP
+#define SOLVER_CONFORMANCE_HPP
+
+/*!\file
+  \brief Defines a check of whether a solver keeps to the interface
+  documented in Solver.hpp.
+
+  This is only available in the serial version of the library.
+ */
+
+#include "ParamsForSolvers.hpp"
+
+namespace KMCThinFilm {
+
+  /*! Checks whether the solver with ID <VAR>solverId</VAR> keeps to
+    the interface documented in Solver.hpp.
+
+    The solver is created from its ID as Simulation::setSolver() does,
+    so <VAR>solverId</VAR> may be either a SolverId::Type value or
+    the ID of a solver registered with registerSolver(). It is then
+    run through building an event list on a small lattice, both in
+    batches and one event at a time; adding, updating and removing
+    cell-centered events at random, including in a plane that was not
+    reserved when the event list was built; choosing events, which
+    must be chosen in proportion to their propensities with a mean
+    time step that is the reciprocal of the total propensity; and
+    building an empty event list. After each of these, the total
+    propensity, noMoreEvents() and appendEventList() are compared with
+    the events that were added. A built-in solver is then checked
+    again as Simulation::setSolver() wraps it to apply the rate scales
+    of Simulation::setEventRateScale(int, int, double), with a rate
+    scale set once the event list is built.
+
+    \return Zero if the solver passes the check. Otherwise, a message
+    saying which part of the interface was broken is printed to the
+    standard error stream, and a non-zero value is returned.
+   */
+  int checkSolverConformance(int solverId /*!< ID of the solver to check. */,
+			     const SolverParams & params = SolverParams() /*!< Parameters
+									     passed on
+									     to the
+									     solver. */);
+
+}
+
+#endif /* SOLVER_CONFORMANCE_HPP */
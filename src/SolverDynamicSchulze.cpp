@@ -1,35 +1,306 @@
 #include "SolverDynamicSchulze.hpp"
+#include "MemoryUsage.hpp"
 #include "Lattice.hpp"
+#include "ParamsForSolvers.hpp"
 #include "ErrorHandling.hpp"
+#include "CallMemberFunction.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
 
 using namespace KMCThinFilm;
 
-SolverDynamicSchulze::SolverDynamicSchulze(const Lattice * lattice) 
+namespace {
+
+  // Must be a power of two.
+  const std::size_t MIN_PROP_ITR_CACHE_SIZE = 64;
+
+  // Marks an entry of a PropToEventIdList_ whose event ID list is
+  // empty, and which therefore has no entry in the proxy.
+  const std::size_t RETIRED_PROPENSITY = static_cast<std::size_t>(-1);
+
+  const std::size_t MIN_RETIRED_PROPENSITIES_BEFORE_SWEEP = 64;
+
+  inline std::size_t hashOfPropensity(double propensity) {
+    boost::uint64_t bits;
+    std::memcpy(&bits, &propensity, sizeof(bits));
+
+    // Propensities often differ only in their high-order bits (e.g.,
+    // if they are small integers), so every bit is mixed into the
+    // low-order bits used to pick a slot. This is the final mixing
+    // step of MurmurHash3.
+    bits ^= bits >> 33;
+    bits *= UINT64_C(0xff51afd7ed558ccd);
+    bits ^= bits >> 33;
+    bits *= UINT64_C(0xc4ceb9fe1a85ec53);
+    bits ^= bits >> 33;
+    return static_cast<std::size_t>(bits);
+  }
+
+}
+
+SolverDynamicSchulze::SolverDynamicSchulze(const Lattice * lattice,
+					   const SolverParams & params)
   : 
 #if KMC_PARALLEL
   Solver(lattice),
 #endif
   propToEventIdList_(lattice->numSectors()),
+  numRetiredPropensities_(lattice->numSectors(), 0),
   propToEventIdListProxy_(lattice->numSectors())
 #if KMC_PARALLEL
   , totOverLatticePropensity_(lattice->numSectors()),
   totNumOverLatticeEvents_(lattice->numSectors())
 #endif
-{}
+  , propItrCacheNumUsed_(0),
+  propItrCacheSectNum_(-1)
+{
+
+  bool isQuantized;
+  propClassRatio_ = params.getParamIfAvailable(SolverParam::PROPENSITY_CLASS_RATIO,
+					       isQuantized);
+
+  if (isQuantized) {
+    exitOnCondition(!(propClassRatio_ > 1),
+		    "Parameter PROPENSITY_CLASS_RATIO must be greater than one");
+
+    invLogPropClassRatio_ = 1/std::log(propClassRatio_);
+    quantizedSectors_.resize(lattice->numSectors());
+
+    beginBuilding_ = &SolverDynamicSchulze::beginBuildingEventListQuantized_;
+    addCellCenteredEntry_ = &SolverDynamicSchulze::addCellCenteredEntryToEventListQuantized_;
+    addOverLatticeEntry_ = &SolverDynamicSchulze::addOverLatticeEntryToEventListQuantized_;
+    addOrUpdateCellCenteredEntry_ = &SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventListQuantized_;
+    chooseEvent_ = &SolverDynamicSchulze::chooseEventIDAndUpdateTimeQuantized_;
+    noMoreEvents_ = &SolverDynamicSchulze::noMoreEventsQuantized_;
+    totalPropensity_ = &SolverDynamicSchulze::totalPropensityQuantized_;
+#if KMC_PARALLEL
+    noCellCenteredEvents_ = &SolverDynamicSchulze::noCellCenteredEventsQuantized_;
+    localMaxAvgPropensityPerPossEvent_ = &SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEventQuantized_;
+    localMaxSinglePropensity_ = &SolverDynamicSchulze::getLocalMaxSinglePropensityQuantized_;
+#endif
+  }
+  else {
+    propClassRatio_ = invLogPropClassRatio_ = 0;
+
+    beginBuilding_ = &SolverDynamicSchulze::beginBuildingEventListExact_;
+    addCellCenteredEntry_ = &SolverDynamicSchulze::addCellCenteredEntryToEventListExact_;
+    addOverLatticeEntry_ = &SolverDynamicSchulze::addOverLatticeEntryToEventListExact_;
+    addOrUpdateCellCenteredEntry_ = &SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventListExact_;
+    chooseEvent_ = &SolverDynamicSchulze::chooseEventIDAndUpdateTimeExact_;
+    noMoreEvents_ = &SolverDynamicSchulze::noMoreEventsExact_;
+    totalPropensity_ = &SolverDynamicSchulze::totPropensityPerSector_;
+#if KMC_PARALLEL
+    noCellCenteredEvents_ = &SolverDynamicSchulze::noCellCenteredEventsExact_;
+    localMaxAvgPropensityPerPossEvent_ = &SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEventExact_;
+    localMaxSinglePropensity_ = &SolverDynamicSchulze::getLocalMaxSinglePropensityExact_;
+#endif
+  }
+
+}
 
 void SolverDynamicSchulze::beginBuildingEventList(int numOverLatticeEvents,
                                                   int numReservedLatticePlanes) {
+  KMC_CALL_MEMBER_FUNCTION(*this, beginBuilding_)(numOverLatticeEvents, numReservedLatticePlanes);
+}
+
+void SolverDynamicSchulze::addCellCenteredEntryToEventList(const EventId & eId,
+							   double propensity,
+							   int sectNum) {
+  KMC_CALL_MEMBER_FUNCTION(*this, addCellCenteredEntry_)(eId, propensity, sectNum);
+}
+
+void SolverDynamicSchulze::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+							     const std::vector<double> & propensities,
+							     int sectNum) {
+
+  if (!quantizedSectors_.empty()) {
+    Solver::addCellCenteredEntriesToEventList(eIds, propensities, sectNum);
+    return;
+  }
+
+  for (std::size_t i = 0; i < eIds.size(); ++i) {
+    addItrEntryToEventList_(eIds[i],
+			    getCachedPropToEventIdListItr_(propensities[i], sectNum),
+			    sectNum);
+  }
+
+}
+
+void SolverDynamicSchulze::addOverLatticeEntryToEventList(const EventId & eId,
+							  double propensity,
+							  int sectNum) {
+  KMC_CALL_MEMBER_FUNCTION(*this, addOverLatticeEntry_)(eId, propensity, sectNum);
+}
+
+void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+								   double currPropensity,
+								   int sectNum) {
+  KMC_CALL_MEMBER_FUNCTION(*this, addOrUpdateCellCenteredEntry_)(eId, currPropensity, sectNum);
+}
+
+bool SolverDynamicSchulze::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+								  double currPropensity,
+								  int sectNum) {
+
+  // Changing the propensity of an entry may move it to another
+  // propensity or class, which would leave its count of over-lattice
+  // events behind, so the old entry is removed and the new one added.
+
+#if KMC_PARALLEL
+  if (quantizedSectors_.empty()) {
+    EvListItrIndexPair_ * addrPtr = addrMap_->getPtrToVal(eId);
+
+    if ((addrPtr != NULL) && (addrPtr->indexToEId >= 0)) {
+      --(addrPtr->itr->second.numOverLatticeEvents);
+      --(totNumOverLatticeEvents_[sectNum]);
+      totOverLatticePropensity_[sectNum] -= addrPtr->itr->first;
+    }
+  }
+  else {
+    ClassItrIndexPair_ * cipPtr = classAddrMap_->getPtrToVal(eId);
+
+    if ((cipPtr != NULL) && (cipPtr->indexInClass >= 0)) {
+      PropensityClass_ & propClass = cipPtr->itr->second;
+
+      --(propClass.numOverLatticeEvents);
+      --(totNumOverLatticeEvents_[sectNum]);
+      totOverLatticePropensity_[sectNum] -= propClass.propensities[cipPtr->indexInClass];
+    }
+  }
+#endif
+
+  KMC_CALL_MEMBER_FUNCTION(*this, addOrUpdateCellCenteredEntry_)(eId, 0, sectNum);
+
+  if (currPropensity > 0) {
+    KMC_CALL_MEMBER_FUNCTION(*this, addOverLatticeEntry_)(eId, currPropensity, sectNum);
+  }
+
+  return true;
+}
+
+void SolverDynamicSchulze::chooseEventIDAndUpdateTime(int sectNum,
+						      EventId & chosenEventID,
+						      double & time) {
+  KMC_CALL_MEMBER_FUNCTION(*this, chooseEvent_)(sectNum, chosenEventID, time);
+}
+
+bool SolverDynamicSchulze::noMoreEvents(int sectNum) const {
+  return KMC_CALL_MEMBER_FUNCTION(*this, noMoreEvents_)(sectNum);
+}
+
+double SolverDynamicSchulze::totalPropensity(int sectNum) {
+  return KMC_CALL_MEMBER_FUNCTION(*this, totalPropensity_)(sectNum);
+}
+
+std::size_t SolverDynamicSchulze::memoryUsage() const {
+
+  // Only one of the two kinds of classes is in use, and the
+  // containers for the other are empty.
+
+  std::size_t numBytes = memoryUsageOf(propToEventIdListProxy_) + memoryUsageOf(propItrCache_);
+
+  for (std::vector<PropToEventIdList_>::const_iterator sectItr = propToEventIdList_.begin(),
+	 sectItrEnd = propToEventIdList_.end(); sectItr != sectItrEnd; ++sectItr) {
+
+    numBytes += memoryUsageOf(*sectItr);
+
+    for (PropToEventIdList_::const_iterator itr = sectItr->begin(),
+	   itrEnd = sectItr->end(); itr != itrEnd; ++itr) {
+      numBytes += memoryUsageOf(itr->second.eIdDeque);
+    }
+  }
+
+  for (std::vector<QuantizedSector_>::const_iterator sectItr = quantizedSectors_.begin(),
+	 sectItrEnd = quantizedSectors_.end(); sectItr != sectItrEnd; ++sectItr) {
+
+    numBytes += memoryUsageOf(sectItr->classes) + sectItr->classSums.memoryUsage() +
+      memoryUsageOf(sectItr->slotToClass) + memoryUsageOf(sectItr->freeSlots);
+
+    for (PropensityClasses_::const_iterator itr = sectItr->classes.begin(),
+	   itrEnd = sectItr->classes.end(); itr != itrEnd; ++itr) {
+      numBytes += memoryUsageOf(itr->second.eIds) + memoryUsageOf(itr->second.propensities);
+#if KMC_PARALLEL
+      numBytes += itr->second.cellCenteredMaxTree.memoryUsage();
+#endif
+    }
+  }
+
+  if (addrMap_) {
+    numBytes += addrMap_->memoryUsage();
+  }
+
+  if (classAddrMap_) {
+    numBytes += classAddrMap_->memoryUsage();
+  }
+
+  return numBytes;
+}
+
+void SolverDynamicSchulze::appendEventList(int sectNum,
+					   std::vector<EventId> & eIds,
+					   std::vector<double> & propensities) const {
+
+  if (quantizedSectors_.empty()) {
+    const PropToEventIdList_ & propList = propToEventIdList_[sectNum];
+
+    for (PropToEventIdList_::const_iterator itr = propList.begin(),
+	   itrEnd = propList.end(); itr != itrEnd; ++itr) {
+      const std::deque<EventId> & eIdDeque = itr->second.eIdDeque;
+      eIds.insert(eIds.end(), eIdDeque.begin(), eIdDeque.end());
+      propensities.insert(propensities.end(), eIdDeque.size(), itr->first);
+    }
+  }
+  else {
+    const PropensityClasses_ & classes = quantizedSectors_[sectNum].classes;
+
+    for (PropensityClasses_::const_iterator itr = classes.begin(),
+	   itrEnd = classes.end(); itr != itrEnd; ++itr) {
+      const PropensityClass_ & propClass = itr->second;
+      eIds.insert(eIds.end(), propClass.eIds.begin(), propClass.eIds.end());
+      propensities.insert(propensities.end(), propClass.propensities.begin(), propClass.propensities.end());
+    }
+  }
+
+}
+
+#if KMC_PARALLEL
+
+bool SolverDynamicSchulze::noCellCenteredEvents(int sectNum) const {
+  return KMC_CALL_MEMBER_FUNCTION(*this, noCellCenteredEvents_)(sectNum);
+}
+
+double SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEvent() {
+  return KMC_CALL_MEMBER_FUNCTION(*this, localMaxAvgPropensityPerPossEvent_)();
+}
+
+double SolverDynamicSchulze::getLocalMaxSinglePropensity() {
+  return KMC_CALL_MEMBER_FUNCTION(*this, localMaxSinglePropensity_)();
+}
+
+#endif
+
+void SolverDynamicSchulze::beginBuildingEventListExact_(int numOverLatticeEvents,
+							int numReservedLatticePlanes) {
   
   for (std::size_t i = 0; i < propToEventIdList_.size(); ++i) {
     propToEventIdList_[i].clear();
     propToEventIdListProxy_[i].clear();
+    numRetiredPropensities_[i] = 0;
 #if KMC_PARALLEL
     totOverLatticePropensity_[i] = 0;
     totNumOverLatticeEvents_[i] = 0;
 #endif
   }
 
-  addrMap_.reset(new EventIdMap<EvListItrIndexPair_>(propToEventIdList_.size(),
+  // The cache refers to entries of propToEventIdList_ that no longer exist.
+  propItrCacheSectNum_ = -1;
+
+  addrMap_.reset(new EventIdMap<EvListItrIndexPair_>(eIdFlattening_,
+                                                     propToEventIdList_.size(),
                                                      numOverLatticeEvents,
                                                      numReservedLatticePlanes,
                                                      EvListItrIndexPair_(propToEventIdList_[0].begin(), -1)));
@@ -48,13 +319,72 @@ SolverDynamicSchulze::PropToEventIdList_::iterator SolverDynamicSchulze::getProp
     propToEventIdListItr = itrBoolPair.first;
     propToEventIdListProxy_[sectNum].push_back(PropToEventIdListProxyEntry_(propToEventIdListItr));
   }
+  else if (propToEventIdListItr->second.indexToEIdListProxy == RETIRED_PROPENSITY) {
+    // Reusing the retired entry (and the storage its event ID list
+    // kept) rather than allocating a new one.
+    propToEventIdListItr->second.indexToEIdListProxy = propToEventIdListProxy_[sectNum].size();
+    propToEventIdListProxy_[sectNum].push_back(PropToEventIdListProxyEntry_(propToEventIdListItr));
+    --(numRetiredPropensities_[sectNum]);
+  }
 
   return propToEventIdListItr;
 }
 
-void SolverDynamicSchulze::addCellCenteredEntryToEventList(const EventId & eId,
-							   double propensity,
-							   int sectNum) {
+void SolverDynamicSchulze::clearPropItrCache_(int sectNum, std::size_t cacheSize) {
+  propItrCache_.assign(cacheSize, PropItrCacheEntry_(0, propToEventIdList_[sectNum].end()));
+  propItrCacheNumUsed_ = 0;
+  propItrCacheSectNum_ = sectNum;
+}
+
+SolverDynamicSchulze::PropToEventIdList_::iterator SolverDynamicSchulze::getCachedPropToEventIdListItr_(double propensity,
+													int sectNum) {
+  if (sectNum != propItrCacheSectNum_) {
+    clearPropItrCache_(sectNum, MIN_PROP_ITR_CACHE_SIZE);
+  }
+
+  std::size_t mask = propItrCache_.size() - 1;
+  std::size_t slot = hashOfPropensity(propensity) & mask;
+
+  while (propItrCache_[slot].propensity != 0) {
+    if (propItrCache_[slot].propensity == propensity) {
+      return propItrCache_[slot].itr;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  PropToEventIdList_::iterator propToEventIdListItr = getPropToEventIdListItr_(propensity,
+                                                                               sectNum);
+
+  propItrCache_[slot] = PropItrCacheEntry_(propensity, propToEventIdListItr);
+
+  // Keep the table at most half full, so that probe sequences stay short.
+  if (2*(++propItrCacheNumUsed_) > propItrCache_.size()) {
+
+    std::vector<PropItrCacheEntry_> oldCache;
+    oldCache.swap(propItrCache_);
+
+    clearPropItrCache_(sectNum, 2*oldCache.size());
+    mask = propItrCache_.size() - 1;
+
+    for (std::vector<PropItrCacheEntry_>::const_iterator itr = oldCache.begin(),
+	   itrEnd = oldCache.end(); itr != itrEnd; ++itr) {
+      if (itr->propensity != 0) {
+	slot = hashOfPropensity(itr->propensity) & mask;
+	while (propItrCache_[slot].propensity != 0) {
+	  slot = (slot + 1) & mask;
+	}
+	propItrCache_[slot] = *itr;
+	++propItrCacheNumUsed_;
+      }
+    }
+  }
+
+  return propToEventIdListItr;
+}
+
+void SolverDynamicSchulze::addCellCenteredEntryToEventListExact_(const EventId & eId,
+								 double propensity,
+								 int sectNum) {
 
   PropToEventIdList_::iterator propToEventIdListItr = getPropToEventIdListItr_(propensity,
                                                                                sectNum);
@@ -63,9 +393,9 @@ void SolverDynamicSchulze::addCellCenteredEntryToEventList(const EventId & eId,
 
 }
 
-void SolverDynamicSchulze::addOverLatticeEntryToEventList(const EventId & eId,
-							  double propensity,
-							  int sectNum) {
+void SolverDynamicSchulze::addOverLatticeEntryToEventListExact_(const EventId & eId,
+								double propensity,
+								int sectNum) {
 
   PropToEventIdList_::iterator propToEventIdListItr = getPropToEventIdListItr_(propensity,
                                                                                sectNum);
@@ -117,9 +447,9 @@ void SolverDynamicSchulze::removeFromEventIdList_(std::size_t origInd, std::dequ
 
 }
 
-void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
-								   double currPropensity,
-								   int sectNum) {
+void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventListExact_(const EventId & eId,
+									 double currPropensity,
+									 int sectNum) {
 
   EvListItrIndexPair_ * evListItrIndexPairPtr = addrMap_->getPtrToVal(eId);
 
@@ -131,9 +461,9 @@ void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventList(const EventId
 	 address maps now. */
 
       // In this *particular* context, I can use
-      // addCellCenteredEntryToEventList without being in between
+      // addCellCenteredEntryToEventListExact_ without being in between
       // calls to beginBuildingEventList() and endBuildingEventList().
-      addCellCenteredEntryToEventList(eId, currPropensity, sectNum);
+      addCellCenteredEntryToEventListExact_(eId, currPropensity, sectNum);
     }
 
   }
@@ -183,11 +513,15 @@ void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventList(const EventId
       removeFromEventIdList_(origInd, origDeque);
       std::size_t origIndexToEIdListProxy = origItr->second.indexToEIdListProxy;
       propToEventIdListProxy_[sectNum][origIndexToEIdListProxy].recalcPartialSumContrib = true;
-      evListItrIndexPairPtr->indexToEId = -1;
+      addrMap_->remove(eId);
     }
 
     if (origDeque.empty()) {
-      // I don't want propensities to be associated with empty event ID lists.
+      // I don't want propensities to be associated with empty event
+      // ID lists in the proxy, since it is what events are chosen
+      // from. The entry of propToEventIdList_ itself is only retired,
+      // since propensities tend to recur, and erasing the entry and
+      // then recreating it would allocate on nearly every event.
       
       std::size_t origIndexToEIdListProxy = origItr->second.indexToEIdListProxy;
       PropToEventIdListProxy_ & currPropToEventIdListProxy = propToEventIdListProxy_[sectNum];
@@ -211,16 +545,39 @@ void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventList(const EventId
       // first place.
       currPropToEventIdListProxy.pop_back();
 
-      propToEventIdList_[sectNum].erase(origItr);
+      origItr->second.indexToEIdListProxy = RETIRED_PROPENSITY;
+
+      if (++(numRetiredPropensities_[sectNum]) > std::max(MIN_RETIRED_PROPENSITIES_BEFORE_SWEEP,
+							  currPropToEventIdListProxy.size())) {
+	sweepRetiredPropensities_(sectNum);
+      }
     }
 
   }
 
 }
 
-void SolverDynamicSchulze::chooseEventIDAndUpdateTime(int sectNum,
-						      EventId & chosenEventID,
-						      double & time) {
+void SolverDynamicSchulze::sweepRetiredPropensities_(int sectNum) {
+
+  // Keeps the propensities that no longer recur from piling up.
+
+  PropToEventIdList_ & propList = propToEventIdList_[sectNum];
+
+  for (PropToEventIdList_::iterator itr = propList.begin(); itr != propList.end();) {
+    if (itr->second.indexToEIdListProxy == RETIRED_PROPENSITY) {
+      propList.erase(itr++);
+    }
+    else {
+      ++itr;
+    }
+  }
+
+  numRetiredPropensities_[sectNum] = 0;
+}
+
+void SolverDynamicSchulze::chooseEventIDAndUpdateTimeExact_(int sectNum,
+							    EventId & chosenEventID,
+							    double & time) {
   // Choose event to execute (but don't execute it just yet) and
   // update t_sector. Method for choosing the event is a
   // slightly modified version of the one from Schulze, Physical
@@ -275,23 +632,8 @@ void SolverDynamicSchulze::chooseEventIDAndUpdateTime(int sectNum,
   chosenEventID = chosenEventIDList[indForEventList];
 }
 
-bool SolverDynamicSchulze::noMoreEvents(int sectNum) const {
-  return propToEventIdList_[sectNum].empty();
-}
-
-#if KMC_PARALLEL
-
-std::size_t SolverDynamicSchulze::numCellCenteredEvents_(int sectNum) const {
-
-  std::size_t nPossEventsPerSector = 0;
-  for (PropToEventIdListProxy_::const_iterator itr = propToEventIdListProxy_[sectNum].begin(),
-	 itrEnd = propToEventIdListProxy_[sectNum].end(); itr != itrEnd; ++itr) {
-    nPossEventsPerSector += itr->itr->second.eIdDeque.size();
-  }
-
-  nPossEventsPerSector -= totNumOverLatticeEvents_[sectNum];
-
-  return nPossEventsPerSector;
+bool SolverDynamicSchulze::noMoreEventsExact_(int sectNum) const {
+  return propToEventIdListProxy_[sectNum].empty();
 }
 
 double SolverDynamicSchulze::totPropensityPerSector_(int sectNum) const {
@@ -311,11 +653,26 @@ double SolverDynamicSchulze::totPropensityPerSector_(int sectNum) const {
   return p_s;
 }
 
-bool SolverDynamicSchulze::noCellCenteredEvents(int sectNum) const {
+#if KMC_PARALLEL
+
+std::size_t SolverDynamicSchulze::numCellCenteredEvents_(int sectNum) const {
+
+  std::size_t nPossEventsPerSector = 0;
+  for (PropToEventIdListProxy_::const_iterator itr = propToEventIdListProxy_[sectNum].begin(),
+	 itrEnd = propToEventIdListProxy_[sectNum].end(); itr != itrEnd; ++itr) {
+    nPossEventsPerSector += itr->itr->second.eIdDeque.size();
+  }
+
+  nPossEventsPerSector -= totNumOverLatticeEvents_[sectNum];
+
+  return nPossEventsPerSector;
+}
+
+bool SolverDynamicSchulze::noCellCenteredEventsExact_(int sectNum) const {
   return !(numCellCenteredEvents_(sectNum) > 0);
 }
 
-double SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEvent() const {
+double SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEventExact_() const {
 
   double ps_local_max = 0;
 
@@ -342,29 +699,388 @@ double SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEvent() const {
   return ps_local_max;
 }
 
-double SolverDynamicSchulze::getLocalMaxSinglePropensity() const {
+double SolverDynamicSchulze::getLocalMaxSinglePropensityExact_() const {
 
   double propensityMaxLocal = 0;
 
-  for (std::size_t i = 0; i < propToEventIdListProxy_.size(); ++i) {
-    
-    for (PropToEventIdListProxy_::const_iterator itr = propToEventIdListProxy_[i].begin(),
-           itrEnd = propToEventIdListProxy_[i].end(); itr != itrEnd; ++itr) {
+  for (std::size_t i = 0; i < propToEventIdList_.size(); ++i) {
+
+    // Since propToEventIdList_[i] is sorted by propensity, the
+    // largest propensity of a cell-centered event is usually that of
+    // the last entry. Only retired entries and entries containing
+    // nothing but over-lattice events are skipped.
+    for (PropToEventIdList_::const_reverse_iterator itr = propToEventIdList_[i].rbegin(),
+	   itrEnd = propToEventIdList_[i].rend(); itr != itrEnd; ++itr) {
+
+      // If the entry is retired, or all the events in eIdDeque are
+      // over-lattice events
+      if (itr->second.eIdDeque.empty() ||
+	  (itr->second.eIdDeque.size() == itr->second.numOverLatticeEvents)) {
+	continue;
+      }
+
+      if (itr->first > propensityMaxLocal) {
+	propensityMaxLocal = itr->first;
+      }
+
+      break;
+    }
+  }
+
+  return propensityMaxLocal;
+}
+
+#endif
+
+namespace {
+
+  // Minimum number of incremental updates to the sum of a propensity
+  // class before that sum is recalculated from scratch.
+  const std::size_t MIN_UPDATES_BEFORE_RESUM = 64;
+
+}
+
+void SolverDynamicSchulze::beginBuildingEventListQuantized_(int numOverLatticeEvents,
+							    int numReservedLatticePlanes) {
+
+  for (std::size_t i = 0; i < quantizedSectors_.size(); ++i) {
+    QuantizedSector_ & qs = quantizedSectors_[i];
+
+    qs.classes.clear();
+    qs.classSums.assign(std::vector<double>());
+    qs.slotToClass.clear();
+    qs.freeSlots.clear();
+    qs.numEvents = 0;
+
+#if KMC_PARALLEL
+    totOverLatticePropensity_[i] = 0;
+    totNumOverLatticeEvents_[i] = 0;
+#endif
+  }
+
+  classAddrMap_.reset(new EventIdMap<ClassItrIndexPair_>(eIdFlattening_,
+							 quantizedSectors_.size(),
+							 numOverLatticeEvents,
+							 numReservedLatticePlanes,
+							 ClassItrIndexPair_(quantizedSectors_[0].classes.end(), -1)));
+}
+
+SolverDynamicSchulze::PropensityClasses_::iterator SolverDynamicSchulze::getPropensityClassItr_(double propensity,
+												int sectNum) {
+
+  QuantizedSector_ & qs = quantizedSectors_[sectNum];
+
+  int classNum = static_cast<int>(std::floor(std::log(propensity)*invLogPropClassRatio_));
+
+  PropensityClasses_::iterator classItr = qs.classes.find(classNum);
+
+  if (classItr == qs.classes.end()) {
+
+    std::size_t slotInd;
+
+    if (!qs.freeSlots.empty()) {
+      slotInd = qs.freeSlots.back();
+      qs.freeSlots.pop_back();
+    }
+    else {
+      slotInd = qs.slotToClass.size();
+      qs.slotToClass.push_back(classItr);
+
+      if (slotInd >= qs.classSums.numSlots()) {
+	qs.classSums.reserveSlots(2*slotInd);
+      }
+    }
+
+    classItr = qs.classes.insert(std::make_pair(classNum,
+						PropensityClass_(std::pow(propClassRatio_, classNum + 1),
+								 slotInd))).first;
+    qs.slotToClass[slotInd] = classItr;
+  }
+
+  // Roundoff in calculating classNum or the bound could leave the
+  // propensity slightly above the bound, which would bias the
+  // rejection step, so the bound is raised if need be.
+  if (propensity > classItr->second.propensityBound) {
+    classItr->second.propensityBound = propensity;
+  }
+
+  return classItr;
+}
+
+void SolverDynamicSchulze::updateSumOfPropensities_(PropensityClass_ & propClass, double change,
+						    int sectNum) {
+
+  if (++(propClass.numUpdatesSinceSum) > std::max(MIN_UPDATES_BEFORE_RESUM, propClass.propensities.size())) {
+    double sum = 0;
+    for (std::vector<double>::const_iterator itr = propClass.propensities.begin(),
+	   itrEnd = propClass.propensities.end(); itr != itrEnd; ++itr) {
+      sum += *itr;
+    }
+
+    propClass.sumOfPropensities = sum;
+    propClass.numUpdatesSinceSum = 0;
+  }
+  else {
+    propClass.sumOfPropensities += change;
+  }
+
+  quantizedSectors_[sectNum].classSums.setWeight(propClass.slotInd, propClass.sumOfPropensities);
+}
+
+void SolverDynamicSchulze::addToPropensityClass_(const EventId & eId, double propensity,
+						 PropensityClasses_::iterator classItr,
+						 int sectNum) {
+
+  PropensityClass_ & propClass = classItr->second;
+
+  classAddrMap_->addOrUpdate(eId, ClassItrIndexPair_(classItr, propClass.eIds.size()));
+
+  propClass.eIds.push_back(eId);
+  propClass.propensities.push_back(propensity);
+
+#if KMC_PARALLEL
+  std::size_t indInClass = propClass.eIds.size() - 1;
+
+  propClass.cellCenteredMaxTree.reserveSlots(indInClass + 1);
+  propClass.cellCenteredMaxTree.setValue(indInClass, eId.isForOverLattice() ? 0 : propensity);
+#endif
+
+  ++(quantizedSectors_[sectNum].numEvents);
+
+  updateSumOfPropensities_(propClass, propensity, sectNum);
+}
+
+void SolverDynamicSchulze::removeFromPropensityClass_(const ClassItrIndexPair_ & cip, int sectNum) {
+
+  QuantizedSector_ & qs = quantizedSectors_[sectNum];
+  PropensityClass_ & propClass = cip.itr->second;
+  std::size_t origInd = cip.indexInClass;
+
+  double origPropensity = propClass.propensities[origInd];
+
+  if ((origInd + 1) != propClass.eIds.size()) {
+    // Replace the removed entry with the entry at the rear, and
+    // update classAddrMap_ to reflect the replacement.
+    propClass.eIds[origInd] = propClass.eIds.back();
+    propClass.propensities[origInd] = propClass.propensities.back();
+
+    classAddrMap_->getRefToVal(propClass.eIds[origInd]).indexInClass = origInd;
+
+#if KMC_PARALLEL
+    propClass.cellCenteredMaxTree.setValue(origInd,
+					   propClass.cellCenteredMaxTree.value(propClass.eIds.size() - 1));
+#endif
+  }
+
+#if KMC_PARALLEL
+  propClass.cellCenteredMaxTree.setValue(propClass.eIds.size() - 1, 0);
+#endif
+
+  propClass.eIds.pop_back();
+  propClass.propensities.pop_back();
+
+  --(qs.numEvents);
+
+  if (propClass.eIds.empty()) {
+    // I don't want propensity classes with no events in them.
+    qs.classSums.setWeight(propClass.slotInd, 0);
+    qs.freeSlots.push_back(propClass.slotInd);
+    qs.classes.erase(cip.itr);
+  }
+  else {
+    updateSumOfPropensities_(propClass, -origPropensity, sectNum);
+  }
+
+}
+
+void SolverDynamicSchulze::addCellCenteredEntryToEventListQuantized_(const EventId & eId,
+								     double propensity,
+								     int sectNum) {
+  addToPropensityClass_(eId, propensity,
+			getPropensityClassItr_(propensity, sectNum),
+			sectNum);
+}
+
+void SolverDynamicSchulze::addOverLatticeEntryToEventListQuantized_(const EventId & eId,
+								    double propensity,
+								    int sectNum) {
+
+  PropensityClasses_::iterator classItr = getPropensityClassItr_(propensity, sectNum);
+
+#if KMC_PARALLEL
+  ++(classItr->second.numOverLatticeEvents);
+  ++(totNumOverLatticeEvents_[sectNum]);
+
+  totOverLatticePropensity_[sectNum] += propensity;
+#endif
+
+  addToPropensityClass_(eId, propensity, classItr, sectNum);
+}
+
+void SolverDynamicSchulze::addOrUpdateCellCenteredEntryToEventListQuantized_(const EventId & eId,
+									     double currPropensity,
+									     int sectNum) {
+
+  ClassItrIndexPair_ * cipPtr = classAddrMap_->getPtrToVal(eId);
+
+  if ((cipPtr == NULL) || (cipPtr->indexInClass < 0)) {
+
+    if (currPropensity > 0) {
+      addCellCenteredEntryToEventListQuantized_(eId, currPropensity, sectNum);
+    }
+
+  }
+  else {
+
+    ClassItrIndexPair_ origCip = *cipPtr;
+    PropensityClass_ & origClass = origCip.itr->second;
+    double & origPropensity = origClass.propensities[origCip.indexInClass];
+
+    if (currPropensity > 0) {
+
+      if (origPropensity != currPropensity) {
+
+	int currClassNum = static_cast<int>(std::floor(std::log(currPropensity)*invLogPropClassRatio_));
+
+	if (currClassNum == origCip.itr->first) {
+	  // Staying in the same class only requires updating the sum
+	  // (and possibly the bound).
+	  double change = currPropensity - origPropensity;
+	  origPropensity = currPropensity;
+
+	  if (currPropensity > origClass.propensityBound) {
+	    origClass.propensityBound = currPropensity;
+	  }
+
+#if KMC_PARALLEL
+	  origClass.cellCenteredMaxTree.setValue(origCip.indexInClass, currPropensity);
+#endif
+
+	  updateSumOfPropensities_(origClass, change, sectNum);
+	}
+	else {
+	  // Getting the new class first, so that the original class
+	  // isn't erased and then immediately recreated.
+	  PropensityClasses_::iterator currItr = getPropensityClassItr_(currPropensity, sectNum);
+	  removeFromPropensityClass_(origCip, sectNum);
+	  addToPropensityClass_(eId, currPropensity, currItr, sectNum);
+	}
+
+      }
+
+    }
+    else {
+
+      /* If the current propensity is zero, then eId is associated
+         with an event that can't happen, so it is removed from its
+         class and its entry in classAddrMap_ is invalidated. */
+
+      removeFromPropensityClass_(origCip, sectNum);
+      classAddrMap_->remove(eId);
+    }
+
+  }
+
+}
+
+void SolverDynamicSchulze::chooseEventIDAndUpdateTimeQuantized_(int sectNum,
+								EventId & chosenEventID,
+								double & time) {
 
-      PropToEventIdList_::iterator pItr = itr->itr;
+  QuantizedSector_ & qs = quantizedSectors_[sectNum];
 
-      // If all the events in eIdDeque are over-lattice events
-      if (pItr->second.eIdDeque.size() ==  pItr->second.numOverLatticeEvents) {
+  // Composition step: choose a class with probability proportional
+  // to the sum of its propensities.
+  std::size_t chosenSlotInd = qs.classSums.findSlot(qs.classSums.total()*
+						    (rng_->getNumInOpenIntervalFrom0To1()));
+
+  const PropensityClass_ & chosenClass = qs.slotToClass[chosenSlotInd]->second;
+
+  // Rejection step: choose an event uniformly from the class and
+  // accept it with probability propensity/(bound of class), which is
+  // at least 1/PROPENSITY_CLASS_RATIO.
+
+  std::size_t classSize = chosenClass.eIds.size();
+  std::size_t indInClass;
+
+  do {
+    indInClass = static_cast<std::size_t>(classSize*(rng_->getNumInOpenIntervalFrom0To1()));
+
+    // Guarding against roundoff making indInClass equal to classSize.
+    if (indInClass >= classSize) {
+      indInClass = classSize - 1;
+    }
+
+  } while (chosenClass.propensityBound*(rng_->getNumInOpenIntervalFrom0To1()) >= chosenClass.propensities[indInClass]);
+
+  chosenEventID = chosenClass.eIds[indInClass];
+
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/(qs.classSums.total());
+}
+
+bool SolverDynamicSchulze::noMoreEventsQuantized_(int sectNum) const {
+  return quantizedSectors_[sectNum].classes.empty();
+}
+
+double SolverDynamicSchulze::totalPropensityQuantized_(int sectNum) const {
+  return quantizedSectors_[sectNum].classSums.total();
+}
+
+#if KMC_PARALLEL
+
+bool SolverDynamicSchulze::noCellCenteredEventsQuantized_(int sectNum) const {
+  return !(quantizedSectors_[sectNum].numEvents > totNumOverLatticeEvents_[sectNum]);
+}
+
+double SolverDynamicSchulze::getLocalMaxAvgPropensityPerPossEventQuantized_() const {
+
+  double ps_local_max = 0;
+
+  for (std::size_t i = 0; i < quantizedSectors_.size(); ++i) {
+
+    std::size_t nPossEventsPerSector = quantizedSectors_[i].numEvents - totNumOverLatticeEvents_[i];
+
+    if (nPossEventsPerSector > 0) {
+      double p_s = (quantizedSectors_[i].classSums.total() - totOverLatticePropensity_[i])/nPossEventsPerSector;
+
+      if (p_s > ps_local_max) {
+        ps_local_max = p_s;
+      }
+    }
+
+  }
+
+  return ps_local_max;
+}
+
+double SolverDynamicSchulze::getLocalMaxSinglePropensityQuantized_() const {
+
+  double propensityMaxLocal = 0;
+
+  for (std::size_t i = 0; i < quantizedSectors_.size(); ++i) {
+
+    const PropensityClasses_ & classes = quantizedSectors_[i].classes;
+
+    // Only the highest class containing a cell-centered event needs
+    // to be looked at, since every propensity in a lower class is
+    // smaller than every propensity in that class.
+    for (PropensityClasses_::const_reverse_iterator itr = classes.rbegin(),
+	   itrEnd = classes.rend(); itr != itrEnd; ++itr) {
+
+      const PropensityClass_ & propClass = itr->second;
+
+      // If all the events in the class are over-lattice events
+      if (propClass.eIds.size() == propClass.numOverLatticeEvents) {
 	continue;
       }
-      
-      double currPropensity = pItr->first;
-      
-      if (currPropensity > propensityMaxLocal) {
-        propensityMaxLocal = currPropensity;
+
+      if (propClass.cellCenteredMaxTree.max() > propensityMaxLocal) {
+	propensityMaxLocal = propClass.cellCenteredMaxTree.max();
       }
 
+      break;
     }
+
   }
 
   return propensityMaxLocal;
@@ -3,6 +3,11 @@
 
 #include "Solver.hpp"
 #include "EventIdMap.hpp"
+#include "FenwickTree.hpp"
+
+#if KMC_PARALLEL
+#include "MaxTree.hpp"
+#endif
 
 #include <vector>
 #include <deque>
@@ -14,10 +19,12 @@
 namespace KMCThinFilm {
 
   class Lattice;
+  class SolverParams;
 
   class SolverDynamicSchulze : public Solver {
   public:
-    SolverDynamicSchulze(const Lattice * lattice);
+    SolverDynamicSchulze(const Lattice * lattice,
+			 const SolverParams & params);
 
     virtual void beginBuildingEventList(int numOverLatticeEvents,
                                         int numReservedLatticePlanes);
@@ -26,6 +33,10 @@ namespace KMCThinFilm {
 						 double propensity,
 						 int sectNum);
 
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
     virtual void addOverLatticeEntryToEventList(const EventId & eId,
 						double propensity,
 						int sectNum);
@@ -36,21 +47,61 @@ namespace KMCThinFilm {
 							 double propensity,
 							 int sectNum);
 
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
     virtual void chooseEventIDAndUpdateTime(int sectNum,
 					    EventId & chosenEventID,
 					    double & time);
 
     virtual bool noMoreEvents(int sectNum) const;
 
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
 #if KMC_PARALLEL
     virtual bool noCellCenteredEvents(int sectNum) const;
 #endif
 
   private:
 
+    // Events are grouped into classes either by exact propensity
+    // (the default) or, if SolverParam::PROPENSITY_CLASS_RATIO is
+    // set, by quantized propensity. The public member functions
+    // dispatch to the implementation for the chosen kind of class
+    // through these pointers.
+
+    typedef void (SolverDynamicSchulze::*BeginBuilding_)(int numOverLatticeEvents,
+							 int numReservedLatticePlanes);
+    typedef void (SolverDynamicSchulze::*AddEntry_)(const EventId & eId,
+						    double propensity,
+						    int sectNum);
+    typedef void (SolverDynamicSchulze::*ChooseEvent_)(int sectNum,
+						       EventId & chosenEventID,
+						       double & time);
+    typedef bool (SolverDynamicSchulze::*NoEvents_)(int sectNum) const;
+    typedef double (SolverDynamicSchulze::*TotalPropensity_)(int sectNum) const;
+
+    BeginBuilding_ beginBuilding_;
+    AddEntry_ addCellCenteredEntry_, addOverLatticeEntry_, addOrUpdateCellCenteredEntry_;
+    ChooseEvent_ chooseEvent_;
+    NoEvents_ noMoreEvents_;
+    TotalPropensity_ totalPropensity_;
+
 #if KMC_PARALLEL
-    virtual double getLocalMaxAvgPropensityPerPossEvent() const;
-    virtual double getLocalMaxSinglePropensity() const;
+    typedef double (SolverDynamicSchulze::*LocalMax_)() const;
+
+    NoEvents_ noCellCenteredEvents_;
+    LocalMax_ localMaxAvgPropensityPerPossEvent_, localMaxSinglePropensity_;
+
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
 
     std::vector<double> totOverLatticePropensity_;
     std::vector<std::size_t> totNumOverLatticeEvents_;
@@ -77,9 +128,16 @@ namespace KMCThinFilm {
     // storing iterators of a PropToEventIdList_ in addrMap_.
     typedef std::map<double,IndexDequePair_> PropToEventIdList_;
   
-    // One instance of PropToEventIdList_ per sector
+    // One instance of PropToEventIdList_ per sector. An entry whose
+    // event ID list has emptied is retired rather than erased, and is
+    // left out of propToEventIdListProxy_ until it is reused.
     std::vector<PropToEventIdList_> propToEventIdList_;
 
+    // Number of retired entries in each PropToEventIdList_
+    std::vector<std::size_t> numRetiredPropensities_;
+
+    void sweepRetiredPropensities_(int sectNum);
+
     // This points to an entry in propToEventIdList_ and contains some other stuff.
     struct PropToEventIdListProxyEntry_ {
       PropToEventIdList_::iterator itr;
@@ -134,10 +192,176 @@ namespace KMCThinFilm {
 
     void removeFromEventIdList_(std::size_t origInd, std::deque<EventId> & origDeque);
 
+    // Used by addCellCenteredEntriesToEventList() to find the entry
+    // of propToEventIdList_ for a propensity without searching
+    // propToEventIdList_ itself. This is an open-addressing hash
+    // table whose size is a power of two, in which unused slots have
+    // a propensity of zero. It is only valid for the sector
+    // propItrCacheSectNum_ of the event list currently being built.
+    struct PropItrCacheEntry_ {
+      double propensity;
+      PropToEventIdList_::iterator itr;
+
+      PropItrCacheEntry_(double p, PropToEventIdList_::iterator myItr)
+	: propensity(p), itr(myItr)
+      {}
+    };
+
+    std::vector<PropItrCacheEntry_> propItrCache_;
+    std::size_t propItrCacheNumUsed_;
+    int propItrCacheSectNum_;
+
+    void clearPropItrCache_(int sectNum, std::size_t cacheSize);
+
+    PropToEventIdList_::iterator getCachedPropToEventIdListItr_(double propensity,
+								int sectNum);
+
     double totPropensityPerSector_(int sectNum) const;
 
+    void beginBuildingEventListExact_(int numOverLatticeEvents,
+				      int numReservedLatticePlanes);
+
+    void addCellCenteredEntryToEventListExact_(const EventId & eId,
+					       double propensity,
+					       int sectNum);
+
+    void addOverLatticeEntryToEventListExact_(const EventId & eId,
+					      double propensity,
+					      int sectNum);
+
+    void addOrUpdateCellCenteredEntryToEventListExact_(const EventId & eId,
+						       double propensity,
+						       int sectNum);
+
+    void chooseEventIDAndUpdateTimeExact_(int sectNum,
+					  EventId & chosenEventID,
+					  double & time);
+
+    bool noMoreEventsExact_(int sectNum) const;
+
 #if KMC_PARALLEL
     std::size_t numCellCenteredEvents_(int sectNum) const;
+
+    bool noCellCenteredEventsExact_(int sectNum) const;
+    double getLocalMaxAvgPropensityPerPossEventExact_() const;
+    double getLocalMaxSinglePropensityExact_() const;
+#endif
+
+    // Quantized propensity classes. Class n holds the events with
+    // propensities in [r^n, r^(n+1)), where r is
+    // SolverParam::PROPENSITY_CLASS_RATIO. The sums of the
+    // propensities in each class are stored in a Fenwick tree, so
+    // that choosing a class scales as O(log(number of classes)), and
+    // an event within a class is chosen by rejection.
+
+    double propClassRatio_, invLogPropClassRatio_;
+
+    struct PropensityClass_ {
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+
+      // An upper bound on the propensities in this class, used for
+      // rejection.
+      double propensityBound;
+
+      double sumOfPropensities;
+
+      // Incrementally updating sumOfPropensities accumulates
+      // roundoff, so it is periodically recalculated from scratch.
+      std::size_t numUpdatesSinceSum;
+
+      // Slot of this class in the Fenwick tree of class sums
+      std::size_t slotInd;
+
+#if KMC_PARALLEL
+      std::size_t numOverLatticeEvents;
+
+      // Holds the propensity of each cell-centered event in the
+      // class, and zero for each over-lattice event, at the same
+      // index as in propensities, so that the largest propensity of
+      // a cell-centered event in the class is known without scanning
+      // the class.
+      MaxTree cellCenteredMaxTree;
+#endif
+
+      PropensityClass_(double bound, std::size_t slot)
+	: propensityBound(bound), sumOfPropensities(0),
+	  numUpdatesSinceSum(0), slotInd(slot)
+#if KMC_PARALLEL
+	, numOverLatticeEvents(0)
+#endif
+      {}
+    };
+
+    // Using a std::map for the same reason that PropToEventIdList_
+    // is one: iterators to it are stored in classAddrMap_.
+    typedef std::map<int,PropensityClass_> PropensityClasses_;
+
+    struct QuantizedSector_ {
+      PropensityClasses_ classes;
+      FenwickTree classSums;
+      std::vector<PropensityClasses_::iterator> slotToClass;
+      std::vector<std::size_t> freeSlots;
+      std::size_t numEvents;
+
+      QuantizedSector_()
+	: numEvents(0)
+      {}
+    };
+
+    // One instance of QuantizedSector_ per sector
+    std::vector<QuantizedSector_> quantizedSectors_;
+
+    struct ClassItrIndexPair_ {
+      PropensityClasses_::iterator itr;
+      Index indexInClass;
+
+      ClassItrIndexPair_(PropensityClasses_::iterator myItr, Index i)
+	: itr(myItr), indexInClass(i)
+      {}
+    };
+
+    boost::scoped_ptr<EventIdMap<ClassItrIndexPair_> > classAddrMap_;
+
+    PropensityClasses_::iterator getPropensityClassItr_(double propensity,
+							int sectNum);
+
+    void addToPropensityClass_(const EventId & eId, double propensity,
+			       PropensityClasses_::iterator classItr,
+			       int sectNum);
+
+    void removeFromPropensityClass_(const ClassItrIndexPair_ & cip, int sectNum);
+
+    void updateSumOfPropensities_(PropensityClass_ & propClass, double change,
+				  int sectNum);
+
+    void beginBuildingEventListQuantized_(int numOverLatticeEvents,
+					  int numReservedLatticePlanes);
+
+    void addCellCenteredEntryToEventListQuantized_(const EventId & eId,
+						   double propensity,
+						   int sectNum);
+
+    void addOverLatticeEntryToEventListQuantized_(const EventId & eId,
+						  double propensity,
+						  int sectNum);
+
+    void addOrUpdateCellCenteredEntryToEventListQuantized_(const EventId & eId,
+							   double propensity,
+							   int sectNum);
+
+    void chooseEventIDAndUpdateTimeQuantized_(int sectNum,
+					      EventId & chosenEventID,
+					      double & time);
+
+    bool noMoreEventsQuantized_(int sectNum) const;
+
+    double totalPropensityQuantized_(int sectNum) const;
+
+#if KMC_PARALLEL
+    bool noCellCenteredEventsQuantized_(int sectNum) const;
+    double getLocalMaxAvgPropensityPerPossEventQuantized_() const;
+    double getLocalMaxSinglePropensityQuantized_() const;
 #endif
 
   };
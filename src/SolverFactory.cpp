@@ -5,24 +5,97 @@
 
 #include "SolverDynamicSchulze.hpp"
 #include "SolverBinaryTree.hpp"
+#include "SolverCompositionRejection.hpp"
+#include "SolverKaryTree.hpp"
+#include "SolverFenwickTree.hpp"
+#include "SolverRejection.hpp"
+#include "SolverAuto.hpp"
+#include "SolverWithAliasTable.hpp"
+
+#include <map>
+#include <string>
+
+#include <boost/lexical_cast.hpp>
+
+namespace {
+
+  typedef std::map<int, KMCThinFilm::SolverCreator> SolverRegistry;
+
+  // Using a function-local static so that solvers can be registered
+  // during static initialization in other translation units.
+  SolverRegistry & solverRegistry() {
+    static SolverRegistry registry;
+    return registry;
+  }
+
+}
 
 namespace KMCThinFilm {
 
-  // Right now, just using a "dumb" switch-based factory, since I
-  // doubt that I'll have enough new solver types to justify something
-  // fancier, like what the "Gang of Four" would do in a design
-  // pattern.
+  void registerSolver(int solverId, const SolverCreator & creator) {
+    exitOnCondition(solverId < SolverId::MIN_CUSTOM_ID,
+		    "The ID of a custom solver must be at least SolverId::MIN_CUSTOM_ID");
+    exitOnCondition(creator.empty(), "Cannot register an empty solver creator");
+
+    solverRegistry()[solverId] = creator;
+  }
+
+  bool solverIsAvailable(int solverId) {
+    if (solverId < SolverId::MIN_CUSTOM_ID) {
+      return (solverId >= SolverId::DYNAMIC_SCHULZE) && (solverId <= SolverId::AUTO);
+    }
+    else {
+      return (solverRegistry().find(solverId) != solverRegistry().end());
+    }
+  }
+
+  namespace {
+
+  // The built-in solvers are still made with a "dumb" switch-based
+  // factory, with only custom solvers looked up in the registry.
   
-  Solver * mkSolver(SolverId::Type sId, const Lattice * lattice) {
+  Solver * mkUnwrappedSolver(int sId, const Lattice * lattice,
+			     const SolverParams & params) {
     
     Solver * solver = NULL;
 
+    if (sId >= SolverId::MIN_CUSTOM_ID) {
+      SolverRegistry::const_iterator itr = solverRegistry().find(sId);
+
+      exitOnCondition(itr == solverRegistry().end(),
+		      "No custom solver has been registered with ID " +
+		      boost::lexical_cast<std::string>(sId));
+
+      solver = (itr->second)(lattice, params);
+
+      exitOnCondition(solver == NULL,
+		      "Creator of custom solver with ID " +
+		      boost::lexical_cast<std::string>(sId) + " returned NULL");
+
+      return solver;
+    }
+
     switch (sId) {
     case SolverId::DYNAMIC_SCHULZE:
-      solver = new SolverDynamicSchulze(lattice);
+      solver = new SolverDynamicSchulze(lattice, params);
       break;
     case SolverId::BINARY_TREE:
-      solver = new SolverBinaryTree(lattice);
+      solver = new SolverBinaryTree(lattice, params);
+      break;
+    case SolverId::COMPOSITION_REJECTION:
+      solver = new SolverCompositionRejection(lattice);
+      break;
+    case SolverId::KARY_TREE:
+      solver = new SolverKaryTree(lattice);
+      break;
+    case SolverId::FENWICK_TREE:
+      solver = new SolverFenwickTree(lattice);
+      break;
+    case SolverId::REJECTION:
+      solver = new SolverRejection(lattice);
+      break;
+    case SolverId::AUTO:
+      solver = new SolverAuto(lattice, params);
       break;
     default:
       exitWithMsg("Bad SolverId value");
@@ -30,5 +103,19 @@ namespace KMCThinFilm {
 
     return solver;
   }
+
+  }
+
+  Solver * mkSolver(int sId, const Lattice * lattice,
+		    const SolverParams & params) {
+
+    Solver * solver = mkUnwrappedSolver(sId, lattice, params);
+
+    if (params.getParamOrReturnDefaultVal(SolverParam::ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS, 0) != 0) {
+      solver = new SolverWithAliasTable(lattice, solver);
+    }
+
+    return solver;
+  }
   
 }
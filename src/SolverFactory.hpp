@@ -2,7 +2,9 @@
 #define SOLVER_FACTORY_HPP
 
 #include "IdsOfSolvers.hpp"
+#include "ParamsForSolvers.hpp"
 #include "Solver.hpp"
+#include "SolverRegistry.hpp"
 
 namespace KMCThinFilm {
 
@@ -10,7 +12,11 @@ namespace KMCThinFilm {
 
   // This returns a raw pointer to a Solver, which can be captured in
   // the constructor of an appropriate "smart" pointer.
-  Solver * mkSolver(SolverId::Type sId, const Lattice * lattice);
+  //
+  // The ID may be either a SolverId::Type value or the ID of a solver
+  // registered with registerSolver().
+  Solver * mkSolver(int sId, const Lattice * lattice,
+		    const SolverParams & params);
   
 }
 
@@ -0,0 +1,343 @@
+#include "SolverFenwickTree.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+SolverFenwickTree::SolverFenwickTree(const Lattice * lattice)
+  :
+#if KMC_PARALLEL
+  Solver(lattice),
+  numOverLatticeEvents_(lattice->numSectors(),0),
+  totOverLatticePropensity_(lattice->numSectors(),0),
+  cellCenteredMaxTrees_(lattice->numSectors()),
+#endif
+  trees_(lattice->numSectors())
+{}
+
+void SolverFenwickTree::beginBuildingEventList(int numOverLatticeEvents,
+					       int numReservedLatticePlanes) {
+
+  evIdToSlotInd_.reset(new EventIdMap<SlotInd>(eIdFlattening_,
+					       trees_.size(),
+					       numOverLatticeEvents,
+					       numReservedLatticePlanes,
+					       -1));
+
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    Tree_ & tree = trees_[i];
+
+    tree.eIds.clear();
+    tree.propensitiesToBuild.clear();
+    tree.freeSlots.clear();
+    tree.numEvents = 0;
+
+#if KMC_PARALLEL
+    numOverLatticeEvents_[i] = 0;
+    totOverLatticePropensity_[i] = 0;
+#endif
+  }
+}
+
+void SolverFenwickTree::appendSlotRaw_(const EventId & eId, double propensity,
+				       int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  evIdToSlotInd_->addOrUpdate(eId, tree.eIds.size());
+
+  // The partial sums aren't calculated until endBuildingEventList().
+  tree.eIds.push_back(eId);
+  tree.propensitiesToBuild.push_back(propensity);
+  ++(tree.numEvents);
+}
+
+void SolverFenwickTree::addCellCenteredEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum) {
+  appendSlotRaw_(eId, propensity, sectNum);
+}
+
+void SolverFenwickTree::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+							  const std::vector<double> & propensities,
+							  int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  for (std::size_t i = 0; i < eIds.size(); ++i) {
+    evIdToSlotInd_->addOrUpdate(eIds[i], tree.eIds.size() + i);
+  }
+
+  // As in appendSlotRaw_(), the partial sums are calculated over all
+  // the slots at once in endBuildingEventList().
+  tree.eIds.insert(tree.eIds.end(), eIds.begin(), eIds.end());
+  tree.propensitiesToBuild.insert(tree.propensitiesToBuild.end(), propensities.begin(), propensities.end());
+  tree.numEvents += eIds.size();
+}
+
+void SolverFenwickTree::addOverLatticeEntryToEventList(const EventId & eId,
+						       double propensity,
+						       int sectNum) {
+  appendSlotRaw_(eId, propensity, sectNum);
+
+#if KMC_PARALLEL
+  ++(numOverLatticeEvents_[sectNum]);
+  totOverLatticePropensity_[sectNum] += propensity;
+#endif
+}
+
+void SolverFenwickTree::endBuildingEventList() {
+
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    Tree_ & tree = trees_[i];
+
+    tree.propensities.assign(tree.propensitiesToBuild);
+
+#if KMC_PARALLEL
+    std::vector<double> & cellCenteredSlotVals = tree.propensitiesToBuild;
+
+    for (std::size_t slotInd = 0; slotInd < tree.eIds.size(); ++slotInd) {
+      if (tree.eIds[slotInd].isForOverLattice()) {
+	cellCenteredSlotVals[slotInd] = 0;
+      }
+    }
+
+    cellCenteredMaxTrees_[i].assign(cellCenteredSlotVals);
+#endif
+
+    tree.propensitiesToBuild.clear();
+  }
+
+}
+
+void SolverFenwickTree::addToSlot_(const EventId & eId, double propensity,
+				   int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  std::size_t slotInd;
+
+  if (!tree.freeSlots.empty()) {
+    slotInd = tree.freeSlots.back();
+    tree.freeSlots.pop_back();
+  }
+  else {
+    slotInd = tree.eIds.size();
+
+    tree.eIds.push_back(eId);
+
+    if (slotInd >= tree.propensities.numSlots()) {
+      // Out of slots, so doubling the number of them.
+      tree.propensities.reserveSlots(2*slotInd);
+    }
+  }
+
+  tree.eIds[slotInd] = eId;
+  tree.propensities.setWeight(slotInd, propensity);
+
+  evIdToSlotInd_->addOrUpdate(eId, slotInd);
+  ++(tree.numEvents);
+
+#if KMC_PARALLEL
+  cellCenteredMaxTrees_[sectNum].reserveSlots(slotInd + 1);
+  cellCenteredMaxTrees_[sectNum].setValue(slotInd, propensity);
+#endif
+}
+
+void SolverFenwickTree::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+								double currPropensity,
+								int sectNum) {
+
+  SlotInd * slotIndPtr = evIdToSlotInd_->getPtrToVal(eId);
+
+  if ((slotIndPtr == NULL) || (*slotIndPtr < 0)) {
+
+    /* If it wasn't in the address map before, but now has a
+       non-zero propensity, then it should be in the event and
+       address maps now. */
+
+    if (currPropensity > 0) {
+      addToSlot_(eId, currPropensity, sectNum);
+    }
+
+  }
+  else {
+
+    Tree_ & tree = trees_[sectNum];
+
+    std::size_t slotInd = *slotIndPtr;
+
+    if (currPropensity > 0) {
+
+      if (tree.propensities.weight(slotInd) != currPropensity) {
+	tree.propensities.setWeight(slotInd, currPropensity);
+
+#if KMC_PARALLEL
+	cellCenteredMaxTrees_[sectNum].setValue(slotInd, currPropensity);
+#endif
+      }
+
+    }
+    else {
+
+      /* If the current propensity is zero, then eId is associated
+         with an event that can't happen. Its slot gets zero weight
+         and goes on the free list, and its entry in the address map
+         is invalidated. */
+
+      tree.propensities.setWeight(slotInd, 0);
+
+#if KMC_PARALLEL
+      cellCenteredMaxTrees_[sectNum].setValue(slotInd, 0);
+#endif
+
+      tree.freeSlots.push_back(slotInd);
+      --(tree.numEvents);
+
+      evIdToSlotInd_->remove(eId);
+    }
+
+  }
+
+}
+
+bool SolverFenwickTree::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							       double currPropensity,
+							       int sectNum) {
+
+  // As in SolverBinaryTree, the old entry is removed and the new one
+  // added, going through the same code as for a cell-centered entry.
+
+  SlotInd * slotIndPtr = evIdToSlotInd_->getPtrToVal(eId);
+
+  if ((slotIndPtr != NULL) && (*slotIndPtr >= 0)) {
+
+#if KMC_PARALLEL
+    --(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] -= trees_[sectNum].propensities.weight(*slotIndPtr);
+#endif
+
+    addOrUpdateCellCenteredEntryToEventList(eId, 0, sectNum);
+  }
+
+  if (currPropensity > 0) {
+    addOrUpdateCellCenteredEntryToEventList(eId, currPropensity, sectNum);
+
+#if KMC_PARALLEL
+    ++(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] += currPropensity;
+    cellCenteredMaxTrees_[sectNum].setValue(evIdToSlotInd_->getRefToVal(eId), 0);
+#endif
+  }
+
+  return true;
+}
+
+void SolverFenwickTree::chooseEventIDAndUpdateTime(int sectNum,
+						   EventId & chosenEventID,
+						   double & time) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  std::size_t chosenSlotInd = tree.propensities.findSlot(tree.propensities.total()*
+							 (rng_->getNumInOpenIntervalFrom0To1()));
+
+  chosenEventID = tree.eIds[chosenSlotInd];
+
+  // Calling total() after findSlot(), since the latter may have
+  // corrected the partial sums for roundoff.
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/(tree.propensities.total());
+}
+
+bool SolverFenwickTree::noMoreEvents(int sectNum) const {
+  return (trees_[sectNum].numEvents == 0);
+}
+
+double SolverFenwickTree::totalPropensity(int sectNum) {
+  return trees_[sectNum].propensities.total();
+}
+
+std::size_t SolverFenwickTree::memoryUsage() const {
+  std::size_t numBytes = trees_.capacity()*sizeof(Tree_);
+
+  for (std::vector<Tree_>::const_iterator itr = trees_.begin(),
+	 itrEnd = trees_.end(); itr != itrEnd; ++itr) {
+    numBytes += memoryUsageOf(itr->eIds) + itr->propensities.memoryUsage() +
+      memoryUsageOf(itr->propensitiesToBuild) + memoryUsageOf(itr->freeSlots);
+  }
+
+  if (evIdToSlotInd_) {
+    numBytes += evIdToSlotInd_->memoryUsage();
+  }
+
+#if KMC_PARALLEL
+  numBytes += memoryUsageOfEach(cellCenteredMaxTrees_);
+#endif
+
+  return numBytes;
+}
+
+void SolverFenwickTree::appendEventList(int sectNum,
+					std::vector<EventId> & eIds,
+					std::vector<double> & propensities) const {
+
+  const Tree_ & tree = trees_[sectNum];
+
+  for (std::size_t slotInd = 0; slotInd < tree.eIds.size(); ++slotInd) {
+    double propensity = tree.propensities.weight(slotInd);
+
+    // Skipping free slots
+    if (propensity > 0) {
+      eIds.push_back(tree.eIds[slotInd]);
+      propensities.push_back(propensity);
+    }
+  }
+
+}
+
+#if KMC_PARALLEL
+
+std::size_t SolverFenwickTree::numCellCenteredEvents_(int sectNum) const {
+  return (trees_[sectNum].numEvents - numOverLatticeEvents_[sectNum]);
+}
+
+bool SolverFenwickTree::noCellCenteredEvents(int sectNum) const {
+  return !(numCellCenteredEvents_(sectNum) > 0);
+}
+
+double SolverFenwickTree::getLocalMaxAvgPropensityPerPossEvent() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    std::size_t nPossEventsPerSector = numCellCenteredEvents_(i);
+
+    if (nPossEventsPerSector > 0) {
+
+      double p_s = trees_[i].propensities.total() - totOverLatticePropensity_[i];
+
+      p_s /= nPossEventsPerSector;
+
+      if (p_s > ps_local_max) {
+        ps_local_max = p_s;
+      }
+    }
+
+  }
+
+  return ps_local_max;
+}
+
+double SolverFenwickTree::getLocalMaxSinglePropensity() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < cellCenteredMaxTrees_.size(); ++i) {
+    if (cellCenteredMaxTrees_[i].max() > ps_local_max) {
+      ps_local_max = cellCenteredMaxTrees_[i].max();
+    }
+  }
+
+  return ps_local_max;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef SOLVER_FENWICK_TREE_HPP
+#define SOLVER_FENWICK_TREE_HPP
+
+#include "Solver.hpp"
+#include "EventIdMap.hpp"
+#include "FenwickTree.hpp"
+#include "MaxTree.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Stores the propensities of events in a Fenwick (binary indexed)
+  // tree over an array of slots. An event keeps its slot for as long
+  // as it has a non-zero propensity, so unlike SolverBinaryTree,
+  // removing an event does not move any other event: its slot is
+  // just given zero weight and put on a free list to be reused.
+  class SolverFenwickTree : public Solver {
+  public:
+    SolverFenwickTree(const Lattice * lattice);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList();
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+
+    std::vector<std::size_t> numOverLatticeEvents_;
+    std::vector<double> totOverLatticePropensity_;
+
+    // One per sector, indexed by slot, with over-lattice events and
+    // free slots having value zero.
+    std::vector<MaxTree> cellCenteredMaxTrees_;
+#endif
+
+    struct Tree_ {
+      // Slot i holds eIds[i], and its propensity is the weight of
+      // slot i in propensities. A slot with zero propensity is free.
+      std::vector<EventId> eIds;
+      FenwickTree propensities;
+
+      // Propensities are collected here while the event list is
+      // being built, and then moved into the Fenwick tree all at once.
+      std::vector<double> propensitiesToBuild;
+
+      std::vector<std::size_t> freeSlots;
+      std::size_t numEvents;
+
+      Tree_()
+	: numEvents(0)
+      {}
+    };
+
+    // One tree per sector
+    std::vector<Tree_> trees_;
+
+    // Allows a slot index to be negative in order to indicate an invalid index.
+    typedef std::ptrdiff_t SlotInd;
+
+    boost::scoped_ptr<EventIdMap<SlotInd> > evIdToSlotInd_;
+
+    void appendSlotRaw_(const EventId & eId, double propensity,
+			int sectNum);
+
+    void addToSlot_(const EventId & eId, double propensity,
+		    int sectNum);
+
+#if KMC_PARALLEL
+    std::size_t numCellCenteredEvents_(int sectNum) const;
+#endif
+
+  };
+
+}
+
+#endif /* SOLVER_FENWICK_TREE_HPP */
@@ -0,0 +1,435 @@
+#include "SolverKaryTree.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // The loops below have a fixed trip count and no data-dependent
+  // branches, so that the compiler is free to unroll and vectorize
+  // them.
+
+  template<int FANOUT>
+  inline double sumOfBlock(const double * block) {
+    double s = 0;
+    for (int k = 0; k < FANOUT; ++k) {
+      s += block[k];
+    }
+    return s;
+  }
+
+  // Returns the index c of the child in block such that the sum of
+  // the children before c is <= R and the sum through c is > R, and
+  // subtracts the sum of the children before c from R.
+  template<int FANOUT>
+  inline int chooseChildInBlock(const double * block, double & R) {
+
+    double prefix[FANOUT];
+    double s = 0;
+    for (int k = 0; k < FANOUT; ++k) {
+      s += block[k];
+      prefix[k] = s;
+    }
+
+    int c = 0;
+    for (int k = 0; k < FANOUT - 1; ++k) {
+      c += (prefix[k] <= R);
+    }
+
+    // Roundoff can push R past the final partial sum, in which case
+    // c may land on a child with zero propensity. This rarely
+    // happens, so it's not worth making branchless.
+    while ((c > 0) && !(block[c] > 0)) {
+      --c;
+    }
+
+    R -= ((c > 0) ? prefix[c - 1] : 0);
+
+    return c;
+  }
+
+}
+
+SolverKaryTree::SolverKaryTree(const Lattice * lattice)
+  :
+#if KMC_PARALLEL
+  Solver(lattice),
+  numOverLatticeEvents_(lattice->numSectors(),0),
+  totOverLatticePropensity_(lattice->numSectors(),0),
+  cellCenteredMaxTrees_(lattice->numSectors()),
+#endif
+  trees_(lattice->numSectors())
+{}
+
+void SolverKaryTree::beginBuildingEventList(int numOverLatticeEvents,
+					    int numReservedLatticePlanes) {
+
+  evIdToLeafInd_.reset(new EventIdMap<LeafInd>(eIdFlattening_,
+					       trees_.size(),
+					       numOverLatticeEvents,
+					       numReservedLatticePlanes,
+					       -1));
+
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    Tree_ & tree = trees_[i];
+
+    // As in SolverBinaryTree, the leaves keep the capacity they had
+    // before rather than reserving space for every possible event of
+    // every reserved plane.
+    tree.eIds.clear();
+    tree.levels.resize(1);
+    tree.levels[0].clear();
+
+#if KMC_PARALLEL
+    numOverLatticeEvents_[i] = 0;
+    totOverLatticePropensity_[i] = 0;
+#endif
+  }
+}
+
+void SolverKaryTree::appendLeafRaw_(const EventId & eId, double propensity,
+				    int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  evIdToLeafInd_->addOrUpdate(eId, tree.eIds.size());
+
+  // The internal levels aren't built until endBuildingEventList().
+  tree.eIds.push_back(eId);
+  tree.levels[0].push_back(propensity);
+}
+
+void SolverKaryTree::addCellCenteredEntryToEventList(const EventId & eId,
+						     double propensity,
+						     int sectNum) {
+  appendLeafRaw_(eId, propensity, sectNum);
+}
+
+void SolverKaryTree::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						       const std::vector<double> & propensities,
+						       int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  for (std::size_t i = 0; i < eIds.size(); ++i) {
+    evIdToLeafInd_->addOrUpdate(eIds[i], tree.eIds.size() + i);
+  }
+
+  // As in appendLeafRaw_(), the internal levels are built over all
+  // the leaves at once in endBuildingEventList().
+  tree.eIds.insert(tree.eIds.end(), eIds.begin(), eIds.end());
+  tree.levels[0].insert(tree.levels[0].end(), propensities.begin(), propensities.end());
+}
+
+void SolverKaryTree::addOverLatticeEntryToEventList(const EventId & eId,
+						    double propensity,
+						    int sectNum) {
+  appendLeafRaw_(eId, propensity, sectNum);
+
+#if KMC_PARALLEL
+  ++(numOverLatticeEvents_[sectNum]);
+  totOverLatticePropensity_[sectNum] += propensity;
+#endif
+}
+
+void SolverKaryTree::endBuildingEventList() {
+
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    makeIntLevels_(trees_[i], std::max<std::size_t>(trees_[i].eIds.size(), 1));
+
+#if KMC_PARALLEL
+    const Tree_ & tree = trees_[i];
+    std::vector<double> cellCenteredLeafVals(tree.eIds.size(), 0);
+
+    for (std::size_t leafInd = 0; leafInd < tree.eIds.size(); ++leafInd) {
+      if (!tree.eIds[leafInd].isForOverLattice()) {
+	cellCenteredLeafVals[leafInd] = tree.levels[0][leafInd];
+      }
+    }
+
+    cellCenteredMaxTrees_[i].assign(cellCenteredLeafVals);
+#endif
+  }
+
+}
+
+void SolverKaryTree::makeIntLevels_(Tree_ & tree, std::size_t numLeafSlots) {
+
+  // Rounding up to a whole number of blocks, padding with zeros.
+  std::size_t levelSize = FANOUT_*((numLeafSlots + FANOUT_ - 1)/FANOUT_);
+
+  tree.levels.resize(1);
+  tree.levels[0].resize(levelSize, 0);
+
+  while (levelSize > FANOUT_) {
+
+    std::size_t numBlocks = levelSize/FANOUT_;
+    levelSize = FANOUT_*((numBlocks + FANOUT_ - 1)/FANOUT_);
+
+    tree.levels.push_back(Level_(levelSize, 0));
+
+    const Level_ & childLevel = tree.levels[tree.levels.size() - 2];
+    Level_ & parentLevel = tree.levels.back();
+
+    for (std::size_t b = 0; b < numBlocks; ++b) {
+      parentLevel[b] = sumOfBlock<FANOUT_>(&(childLevel[FANOUT_*b]));
+    }
+  }
+
+}
+
+void SolverKaryTree::updateAncestorsOfLeaf_(Tree_ & tree, std::size_t leafInd) {
+
+  std::size_t nodeInd = leafInd;
+
+  for (std::size_t l = 1; l < tree.levels.size(); ++l) {
+    nodeInd /= FANOUT_;
+    tree.levels[l][nodeInd] = sumOfBlock<FANOUT_>(&(tree.levels[l-1][FANOUT_*nodeInd]));
+  }
+
+}
+
+double SolverKaryTree::totPropensity_(const Tree_ & tree) const {
+  return sumOfBlock<FANOUT_>(&(tree.levels.back()[0]));
+}
+
+void SolverKaryTree::appendLeaf_(const EventId & eId,
+				 double propensity, int sectNum) {
+
+  Tree_ & tree = trees_[sectNum];
+
+  std::size_t leafInd = tree.eIds.size();
+
+  if (leafInd == tree.levels[0].size()) {
+    // Out of leaf slots, so doubling the number of them. The existing
+    // leaf indices don't change, so evIdToLeafInd_ doesn't need to be
+    // updated.
+    makeIntLevels_(tree, 2*leafInd);
+  }
+
+  evIdToLeafInd_->addOrUpdate(eId, leafInd);
+  tree.eIds.push_back(eId);
+  tree.levels[0][leafInd] = propensity;
+
+  updateAncestorsOfLeaf_(tree, leafInd);
+
+#if KMC_PARALLEL
+  cellCenteredMaxTrees_[sectNum].reserveSlots(leafInd + 1);
+  cellCenteredMaxTrees_[sectNum].setValue(leafInd, propensity);
+#endif
+}
+
+void SolverKaryTree::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							     double currPropensity,
+							     int sectNum) {
+
+  LeafInd * leafIndPtr = evIdToLeafInd_->getPtrToVal(eId);
+
+  if ((leafIndPtr == NULL) || (*leafIndPtr < 0)) {
+
+    /* If it wasn't in the address map before, but now has a
+       non-zero propensity, then it should be in the event and
+       address maps now. */
+
+    if (currPropensity > 0) {
+      appendLeaf_(eId, currPropensity, sectNum);
+    }
+
+  }
+  else {
+
+    Tree_ & tree = trees_[sectNum];
+
+    std::size_t origLeafInd = *leafIndPtr;
+    double & origPropensity = tree.levels[0][origLeafInd];
+
+    if (currPropensity > 0) {
+
+      if (origPropensity != currPropensity) {
+	origPropensity = currPropensity;
+	updateAncestorsOfLeaf_(tree, origLeafInd);
+
+#if KMC_PARALLEL
+	cellCenteredMaxTrees_[sectNum].setValue(origLeafInd, currPropensity);
+#endif
+      }
+
+    }
+    else {
+
+      /* If the current propensity is zero, then eId is associated
+         with an event that can't happen.
+
+         Therefore, I remove eId by replacing it with the last leaf,
+         and then zeroing out the last leaf slot.
+      */
+
+      // Erasing the map entry corresponding to the element to be
+      // removed. This may free the page holding it, so leafIndPtr
+      // isn't used after this.
+      evIdToLeafInd_->remove(eId);
+
+      std::size_t lastLeafInd = tree.eIds.size() - 1;
+
+#if KMC_PARALLEL
+      MaxTree & maxTree = cellCenteredMaxTrees_[sectNum];
+      maxTree.setValue(origLeafInd, maxTree.value(lastLeafInd));
+      maxTree.setValue(lastLeafInd, 0);
+#endif
+
+      if (origLeafInd != lastLeafInd) {
+	tree.eIds[origLeafInd] = tree.eIds.back();
+	origPropensity = tree.levels[0][lastLeafInd];
+
+	evIdToLeafInd_->getRefToVal(tree.eIds[origLeafInd]) = origLeafInd;
+	updateAncestorsOfLeaf_(tree, origLeafInd);
+      }
+
+      tree.eIds.pop_back();
+      tree.levels[0][lastLeafInd] = 0;
+      updateAncestorsOfLeaf_(tree, lastLeafInd);
+    }
+
+  }
+
+}
+
+bool SolverKaryTree::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							    double currPropensity,
+							    int sectNum) {
+
+  // As in SolverBinaryTree, the old entry is removed and the new one
+  // added, going through the same code as for a cell-centered entry.
+
+  LeafInd * leafIndPtr = evIdToLeafInd_->getPtrToVal(eId);
+
+  if ((leafIndPtr != NULL) && (*leafIndPtr >= 0)) {
+
+#if KMC_PARALLEL
+    --(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] -= trees_[sectNum].levels[0][*leafIndPtr];
+#endif
+
+    addOrUpdateCellCenteredEntryToEventList(eId, 0, sectNum);
+  }
+
+  if (currPropensity > 0) {
+    addOrUpdateCellCenteredEntryToEventList(eId, currPropensity, sectNum);
+
+#if KMC_PARALLEL
+    ++(numOverLatticeEvents_[sectNum]);
+    totOverLatticePropensity_[sectNum] += currPropensity;
+    cellCenteredMaxTrees_[sectNum].setValue(evIdToLeafInd_->getRefToVal(eId), 0);
+#endif
+  }
+
+  return true;
+}
+
+void SolverKaryTree::chooseEventIDAndUpdateTime(int sectNum,
+						EventId & chosenEventID,
+						double & time) {
+
+  const Tree_ & tree = trees_[sectNum];
+
+  double totPropensity = totPropensity_(tree);
+
+  double R = totPropensity*(rng_->getNumInOpenIntervalFrom0To1());
+
+  std::size_t nodeInd = 0;
+  for (std::size_t r = tree.levels.size(); r > 0; --r) {
+    const double * block = &(tree.levels[r - 1][FANOUT_*nodeInd]);
+    nodeInd = FANOUT_*nodeInd + chooseChildInBlock<FANOUT_>(block, R);
+  }
+
+  chosenEventID = tree.eIds[nodeInd];
+
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/totPropensity;
+}
+
+bool SolverKaryTree::noMoreEvents(int sectNum) const {
+  return trees_[sectNum].eIds.empty();
+}
+
+double SolverKaryTree::totalPropensity(int sectNum) {
+  return totPropensity_(trees_[sectNum]);
+}
+
+std::size_t SolverKaryTree::memoryUsage() const {
+  std::size_t numBytes = trees_.capacity()*sizeof(Tree_);
+
+  for (std::vector<Tree_>::const_iterator itr = trees_.begin(),
+	 itrEnd = trees_.end(); itr != itrEnd; ++itr) {
+    numBytes += memoryUsageOf(itr->eIds) + memoryUsageOf(itr->levels);
+  }
+
+  if (evIdToLeafInd_) {
+    numBytes += evIdToLeafInd_->memoryUsage();
+  }
+
+#if KMC_PARALLEL
+  numBytes += memoryUsageOfEach(cellCenteredMaxTrees_);
+#endif
+
+  return numBytes;
+}
+
+void SolverKaryTree::appendEventList(int sectNum,
+				     std::vector<EventId> & eIds,
+				     std::vector<double> & propensities) const {
+
+  const Tree_ & tree = trees_[sectNum];
+
+  eIds.insert(eIds.end(), tree.eIds.begin(), tree.eIds.end());
+  propensities.insert(propensities.end(), tree.levels[0].begin(),
+		      tree.levels[0].begin() + tree.eIds.size());
+
+}
+
+#if KMC_PARALLEL
+
+std::size_t SolverKaryTree::numCellCenteredEvents_(int sectNum) const {
+  return (trees_[sectNum].eIds.size() - numOverLatticeEvents_[sectNum]);
+}
+
+bool SolverKaryTree::noCellCenteredEvents(int sectNum) const {
+  return !(numCellCenteredEvents_(sectNum) > 0);
+}
+
+double SolverKaryTree::getLocalMaxAvgPropensityPerPossEvent() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < trees_.size(); ++i) {
+    std::size_t nPossEventsPerSector = numCellCenteredEvents_(i);
+
+    if (nPossEventsPerSector > 0) {
+
+      double p_s = totPropensity_(trees_[i]) - totOverLatticePropensity_[i];
+
+      p_s /= nPossEventsPerSector;
+
+      if (p_s > ps_local_max) {
+        ps_local_max = p_s;
+      }
+    }
+
+  }
+
+  return ps_local_max;
+}
+
+double SolverKaryTree::getLocalMaxSinglePropensity() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < cellCenteredMaxTrees_.size(); ++i) {
+    if (cellCenteredMaxTrees_[i].max() > ps_local_max) {
+      ps_local_max = cellCenteredMaxTrees_[i].max();
+    }
+  }
+
+  return ps_local_max;
+}
+
+#endif
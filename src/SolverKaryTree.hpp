@@ -0,0 +1,129 @@
+#ifndef SOLVER_KARY_TREE_HPP
+#define SOLVER_KARY_TREE_HPP
+
+#include "Solver.hpp"
+#include "EventIdMap.hpp"
+#include "MaxTree.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/align/aligned_allocator.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // A sum tree like that in SolverBinaryTree, but with a fan-out of
+  // FANOUT_ rather than two, so that the tree is shallower, and each
+  // set of siblings fills exactly one cache line. The tree is stored
+  // level by level, with the leaves (i.e. the propensities) in level
+  // zero and the sums of each block of FANOUT_ siblings in the level
+  // above it. The event IDs are stored in a contiguous vector
+  // parallel to the leaves.
+  class SolverKaryTree : public Solver {
+  public:
+    SolverKaryTree(const Lattice * lattice);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList();
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+
+    std::vector<std::size_t> numOverLatticeEvents_;
+    std::vector<double> totOverLatticePropensity_;
+
+    // One per sector, indexed by leaf, with over-lattice events and
+    // unused leaves having value zero.
+    std::vector<MaxTree> cellCenteredMaxTrees_;
+#endif
+
+    // Eight doubles make up a 64-byte cache line.
+    enum {FANOUT_ = 8, CACHE_LINE_SIZE_ = 64};
+
+    typedef std::vector<double, boost::alignment::aligned_allocator<double, CACHE_LINE_SIZE_> > Level_;
+
+    struct Tree_ {
+      std::vector<EventId> eIds;
+
+      // levels[0] holds the leaves, and levels.back() holds exactly
+      // FANOUT_ nodes whose sum is the total propensity. The size of
+      // every level is a multiple of FANOUT_, with unused nodes set
+      // to zero.
+      std::vector<Level_> levels;
+    };
+
+    // One tree per sector
+    std::vector<Tree_> trees_;
+
+    // Allows a leaf index to be negative in order to indicate an invalid index.
+    typedef std::ptrdiff_t LeafInd;
+
+    boost::scoped_ptr<EventIdMap<LeafInd> > evIdToLeafInd_;
+
+    void appendLeafRaw_(const EventId & eId, double propensity,
+			int sectNum);
+
+    void appendLeaf_(const EventId & eId, double propensity,
+		     int sectNum);
+
+    void makeIntLevels_(Tree_ & tree, std::size_t numLeafSlots);
+
+    void updateAncestorsOfLeaf_(Tree_ & tree, std::size_t leafInd);
+
+    double totPropensity_(const Tree_ & tree) const;
+
+#if KMC_PARALLEL
+    std::size_t numCellCenteredEvents_(int sectNum) const;
+#endif
+
+  };
+
+}
+
+#endif /* SOLVER_KARY_TREE_HPP */
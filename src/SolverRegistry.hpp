@@ -0,0 +1,54 @@
+#ifndef SOLVER_REGISTRY_HPP
+#define SOLVER_REGISTRY_HPP
+
+/*!\file
+  \brief Defines the means of registering custom solvers.
+ */
+
+#include "IdsOfSolvers.hpp"
+#include "ParamsForSolvers.hpp"
+#include "Solver.hpp"
+
+#include <boost/function.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  /*! Type of function object that creates a custom solver.
+
+    The function object is passed the lattice of the simulation and
+    the parameters passed to Simulation::setSolver(), and must return
+    a pointer to a new instance of a class derived from Solver, which
+    the simulation then takes ownership of. Parameters that the
+    custom solver doesn't understand may be ignored.
+   */
+  typedef boost::function<Solver * (const Lattice * lattice,
+				    const SolverParams & params)> SolverCreator;
+
+  /*! Registers a custom solver, so that it can be selected by
+    passing solverId to Simulation::setSolver().
+
+    Registering a creator with the ID of a previously registered
+    solver replaces that solver's creator. Solvers should be
+    registered before any call to Simulation::setSolver() that uses
+    them.
+
+    In the serial version of the library, once a solver is
+    registered, checkSolverConformance() (see SolverConformance.hpp)
+    can be used to check that it keeps to the interface documented
+    in Solver.hpp.
+   */
+  void registerSolver(int solverId /*!< ID of the solver, which must be
+				      at least SolverId::MIN_CUSTOM_ID. */,
+		      const SolverCreator & creator /*!< Function object
+						       that creates the
+						       solver. */);
+
+  /*! Returns true if solverId is either one of the values in
+    SolverId::Type or has been registered with registerSolver(). */
+  bool solverIsAvailable(int solverId);
+
+}
+
+#endif /* SOLVER_REGISTRY_HPP */
@@ -0,0 +1,350 @@
+#include "SolverRejection.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+namespace {
+
+  // Minimum number of incremental updates to the sum of a sector's
+  // propensities before that sum is recalculated from scratch.
+  const std::size_t MIN_UPDATES_BEFORE_RESUM = 64;
+
+}
+
+SolverRejection::SolverRejection(const Lattice * lattice)
+  :
+#if KMC_PARALLEL
+  Solver(lattice),
+#endif
+  sectors_(lattice->numSectors())
+{}
+
+void SolverRejection::beginBuildingEventList(int numOverLatticeEvents,
+					     int numReservedLatticePlanes) {
+
+  evIdToIndex_.reset(new EventIdMap<Index>(eIdFlattening_,
+					   sectors_.size(),
+					   numOverLatticeEvents,
+					   numReservedLatticePlanes,
+					   -1));
+
+  for (std::size_t i = 0; i < sectors_.size(); ++i) {
+    sectors_[i] = Sector_();
+  }
+}
+
+void SolverRejection::updateSumOfPropensities_(Sector_ & sector, double change) {
+
+  if (++(sector.numUpdatesSinceSum) > std::max(MIN_UPDATES_BEFORE_RESUM, sector.propensities.size())) {
+    double sum = 0;
+    for (std::vector<double>::const_iterator itr = sector.propensities.begin(),
+	   itrEnd = sector.propensities.end(); itr != itrEnd; ++itr) {
+      sum += *itr;
+    }
+
+    sector.sumOfPropensities = sum;
+    sector.numUpdatesSinceSum = 0;
+  }
+  else {
+    sector.sumOfPropensities += change;
+  }
+
+}
+
+void SolverRejection::appendEvent_(const EventId & eId, double propensity,
+				   int sectNum) {
+
+  Sector_ & sector = sectors_[sectNum];
+  std::size_t ind = sector.eIds.size();
+
+  evIdToIndex_->addOrUpdate(eId, ind);
+
+  sector.eIds.push_back(eId);
+  sector.propensities.push_back(propensity);
+
+  if (propensity > sector.propensityBound) {
+    sector.propensityBound = propensity;
+  }
+
+#if KMC_PARALLEL
+  sector.cellCenteredMaxTree.reserveSlots(ind + 1);
+  sector.cellCenteredMaxTree.setValue(ind, eId.isForOverLattice() ? 0 : propensity);
+#endif
+
+  updateSumOfPropensities_(sector, propensity);
+}
+
+void SolverRejection::removeEvent_(std::size_t ind, int sectNum) {
+
+  Sector_ & sector = sectors_[sectNum];
+  std::size_t lastInd = sector.eIds.size() - 1;
+
+  double origPropensity = sector.propensities[ind];
+
+#if KMC_PARALLEL
+  MaxTree & maxTree = sector.cellCenteredMaxTree;
+  maxTree.setValue(ind, maxTree.value(lastInd));
+  maxTree.setValue(lastInd, 0);
+#endif
+
+  if (ind != lastInd) {
+    // Replace the removed entry with the entry at the rear, and
+    // update evIdToIndex_ to reflect the replacement.
+    sector.eIds[ind] = sector.eIds.back();
+    sector.propensities[ind] = sector.propensities.back();
+
+    evIdToIndex_->getRefToVal(sector.eIds[ind]) = ind;
+  }
+
+  sector.eIds.pop_back();
+  sector.propensities.pop_back();
+
+  if (sector.eIds.empty()) {
+    // Resetting the sum exactly, rather than letting roundoff leave a
+    // tiny nonzero propensity on an empty sector.
+    sector.sumOfPropensities = 0;
+    sector.numUpdatesSinceSum = 0;
+  }
+  else {
+    updateSumOfPropensities_(sector, -origPropensity);
+  }
+}
+
+void SolverRejection::setPropensity_(std::size_t ind, double propensity,
+				     int sectNum) {
+
+  Sector_ & sector = sectors_[sectNum];
+
+  double change = propensity - sector.propensities[ind];
+
+  sector.propensities[ind] = propensity;
+
+  if (propensity > sector.propensityBound) {
+    sector.propensityBound = propensity;
+  }
+
+#if KMC_PARALLEL
+  // Only cell-centered events have their propensities changed.
+  sector.cellCenteredMaxTree.setValue(ind, propensity);
+#endif
+
+  updateSumOfPropensities_(sector, change);
+}
+
+void SolverRejection::updatePropensityBound_(Sector_ & sector) {
+  sector.propensityBound = *std::max_element(sector.propensities.begin(),
+					     sector.propensities.end());
+  sector.numRejectionsSinceBoundUpdate = 0;
+}
+
+void SolverRejection::addCellCenteredEntryToEventList(const EventId & eId,
+						      double propensity,
+						      int sectNum) {
+  appendEvent_(eId, propensity, sectNum);
+}
+
+void SolverRejection::addOverLatticeEntryToEventList(const EventId & eId,
+						     double propensity,
+						     int sectNum) {
+  appendEvent_(eId, propensity, sectNum);
+
+#if KMC_PARALLEL
+  ++(sectors_[sectNum].numOverLatticeEvents);
+  sectors_[sectNum].totOverLatticePropensity += propensity;
+#endif
+}
+
+void SolverRejection::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							      double currPropensity,
+							      int sectNum) {
+
+  Index * indPtr = evIdToIndex_->getPtrToVal(eId);
+
+  if ((indPtr == NULL) || (*indPtr < 0)) {
+
+    /* If it wasn't in the address map before, but now has a
+       non-zero propensity, then it should be in the event and
+       address maps now. */
+
+    if (currPropensity > 0) {
+      appendEvent_(eId, currPropensity, sectNum);
+    }
+
+  }
+  else {
+
+    std::size_t ind = *indPtr;
+
+    if (currPropensity > 0) {
+
+      if (sectors_[sectNum].propensities[ind] != currPropensity) {
+	setPropensity_(ind, currPropensity, sectNum);
+      }
+
+    }
+    else {
+
+      /* If the current propensity is zero, then eId is associated
+         with an event that can't happen, so it is removed and its
+         entry in the address map is invalidated. */
+
+      removeEvent_(ind, sectNum);
+
+      evIdToIndex_->remove(eId);
+    }
+
+  }
+
+}
+
+bool SolverRejection::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							     double currPropensity,
+							     int sectNum) {
+
+  // There are few over-lattice events, so rather than being updated
+  // in place, the old entry is removed and the new one added.
+
+  Index * indPtr = evIdToIndex_->getPtrToVal(eId);
+
+  if ((indPtr != NULL) && (*indPtr >= 0)) {
+    std::size_t ind = *indPtr;
+
+#if KMC_PARALLEL
+    --(sectors_[sectNum].numOverLatticeEvents);
+    sectors_[sectNum].totOverLatticePropensity -= sectors_[sectNum].propensities[ind];
+#endif
+
+    removeEvent_(ind, sectNum);
+    evIdToIndex_->remove(eId);
+  }
+
+  if (currPropensity > 0) {
+    addOverLatticeEntryToEventList(eId, currPropensity, sectNum);
+  }
+
+  return true;
+}
+
+void SolverRejection::chooseEventIDAndUpdateTime(int sectNum,
+						 EventId & chosenEventID,
+						 double & time) {
+
+  Sector_ & sector = sectors_[sectNum];
+  std::size_t numEvents = sector.eIds.size();
+
+  while (true) {
+
+    double trialRate = numEvents*sector.propensityBound;
+
+    double x = numEvents*(rng_->getNumInOpenIntervalFrom0To1());
+    std::size_t ind = static_cast<std::size_t>(x);
+
+    // Guarding against roundoff making ind equal to numEvents.
+    if (ind >= numEvents) {
+      ind = numEvents - 1;
+    }
+
+    // Every trial takes time, whether or not it's accepted.
+    time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/trialRate;
+
+    // The fractional part of x is uniformly distributed independently
+    // of ind, so it can be reused to decide whether to accept the
+    // event, saving a random number per trial.
+    if ((x - ind)*(sector.propensityBound) < sector.propensities[ind]) {
+      chosenEventID = sector.eIds[ind];
+      break;
+    }
+
+    if (++(sector.numRejectionsSinceBoundUpdate) > numEvents) {
+      // The bound may have fallen well above the actual maximum, so
+      // tightening it. Since this takes O(numEvents) time, it's only
+      // done after at least that many rejections.
+      updatePropensityBound_(sector);
+    }
+
+  }
+
+}
+
+bool SolverRejection::noMoreEvents(int sectNum) const {
+  return sectors_[sectNum].eIds.empty();
+}
+
+double SolverRejection::totalPropensity(int sectNum) {
+  return sectors_[sectNum].sumOfPropensities;
+}
+
+std::size_t SolverRejection::memoryUsage() const {
+  std::size_t numBytes = sectors_.capacity()*sizeof(Sector_);
+
+  for (std::vector<Sector_>::const_iterator itr = sectors_.begin(),
+	 itrEnd = sectors_.end(); itr != itrEnd; ++itr) {
+    numBytes += memoryUsageOf(itr->eIds) + memoryUsageOf(itr->propensities);
+#if KMC_PARALLEL
+    numBytes += itr->cellCenteredMaxTree.memoryUsage();
+#endif
+  }
+
+  if (evIdToIndex_) {
+    numBytes += evIdToIndex_->memoryUsage();
+  }
+
+  return numBytes;
+}
+
+void SolverRejection::appendEventList(int sectNum,
+				      std::vector<EventId> & eIds,
+				      std::vector<double> & propensities) const {
+
+  const Sector_ & sector = sectors_[sectNum];
+
+  eIds.insert(eIds.end(), sector.eIds.begin(), sector.eIds.end());
+  propensities.insert(propensities.end(), sector.propensities.begin(), sector.propensities.end());
+
+}
+
+#if KMC_PARALLEL
+
+bool SolverRejection::noCellCenteredEvents(int sectNum) const {
+  return !(sectors_[sectNum].eIds.size() > sectors_[sectNum].numOverLatticeEvents);
+}
+
+double SolverRejection::getLocalMaxAvgPropensityPerPossEvent() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < sectors_.size(); ++i) {
+    const Sector_ & sector = sectors_[i];
+
+    std::size_t nPossEventsPerSector = sector.eIds.size() - sector.numOverLatticeEvents;
+
+    if (nPossEventsPerSector > 0) {
+
+      double p_s = sector.sumOfPropensities - sector.totOverLatticePropensity;
+
+      p_s /= nPossEventsPerSector;
+
+      if (p_s > ps_local_max) {
+        ps_local_max = p_s;
+      }
+    }
+
+  }
+
+  return ps_local_max;
+}
+
+double SolverRejection::getLocalMaxSinglePropensity() {
+  double ps_local_max = 0;
+  for (std::size_t i = 0; i < sectors_.size(); ++i) {
+    if (sectors_[i].cellCenteredMaxTree.max() > ps_local_max) {
+      ps_local_max = sectors_[i].cellCenteredMaxTree.max();
+    }
+  }
+
+  return ps_local_max;
+}
+
+#endif
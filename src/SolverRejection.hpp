@@ -0,0 +1,141 @@
+#ifndef SOLVER_REJECTION_HPP
+#define SOLVER_REJECTION_HPP
+
+#include "Solver.hpp"
+#include "EventIdMap.hpp"
+
+#if KMC_PARALLEL
+#include "MaxTree.hpp"
+#endif
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Rejection (or "null-event") solver. The events of a sector are
+  // kept in a flat array, from which a candidate is chosen uniformly
+  // and accepted with probability propensity/(upper bound on all
+  // propensities in the sector). Every trial, accepted or not,
+  // advances time as if it were an event of a system in which every
+  // event had the upper bound as its propensity, which makes the
+  // distribution of the time between accepted events exact.
+  //
+  // Adding, updating, and removing events are O(1), so this is
+  // well-suited to models where most events share a few similar
+  // propensities, but becomes slow if some propensities are much
+  // smaller than the largest one.
+  class SolverRejection : public Solver {
+  public:
+    SolverRejection(const Lattice * lattice);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList() {}
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+#endif
+
+    struct Sector_ {
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+
+      // Upper bound on the propensities, used for rejection. It is
+      // raised as soon as a larger propensity is added, but only
+      // lowered (to the actual maximum) after enough rejections to
+      // pay for the scan that finds the maximum.
+      double propensityBound;
+      std::size_t numRejectionsSinceBoundUpdate;
+
+      // Choosing an event doesn't need the sum of the propensities,
+      // but totalPropensity() does. The sum is periodically
+      // recalculated from scratch to keep roundoff from accumulating.
+      double sumOfPropensities;
+      std::size_t numUpdatesSinceSum;
+
+#if KMC_PARALLEL
+      std::size_t numOverLatticeEvents;
+      double totOverLatticePropensity;
+
+      // Indexed in the same way as propensities, with over-lattice
+      // events having value zero.
+      MaxTree cellCenteredMaxTree;
+#endif
+
+      Sector_()
+	: propensityBound(0), numRejectionsSinceBoundUpdate(0),
+	  sumOfPropensities(0), numUpdatesSinceSum(0)
+#if KMC_PARALLEL
+	, numOverLatticeEvents(0), totOverLatticePropensity(0)
+#endif
+      {}
+    };
+
+    // One per sector
+    std::vector<Sector_> sectors_;
+
+    // Allows an index to be negative in order to indicate an invalid index.
+    typedef std::ptrdiff_t Index;
+
+    boost::scoped_ptr<EventIdMap<Index> > evIdToIndex_;
+
+    void appendEvent_(const EventId & eId, double propensity,
+		      int sectNum);
+
+    void removeEvent_(std::size_t ind, int sectNum);
+
+    void setPropensity_(std::size_t ind, double propensity,
+			int sectNum);
+
+    void updatePropensityBound_(Sector_ & sector);
+
+    void updateSumOfPropensities_(Sector_ & sector, double change);
+
+  };
+
+}
+
+#endif /* SOLVER_REJECTION_HPP */
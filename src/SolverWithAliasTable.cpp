@@ -0,0 +1,255 @@
+#include "SolverWithAliasTable.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+SolverWithAliasTable::SolverWithAliasTable(const Lattice * lattice,
+					   Solver * wrappedSolver)
+  : Solver(lattice),
+    wrappedSolver_(wrappedSolver),
+    aliasTables_(lattice->numSectors())
+{}
+
+void SolverWithAliasTable::setRNG(RandNumGenSharedPtr rng) {
+  Solver::setRNG(rng);
+  wrappedSolver_->setRNG(rng);
+}
+
+void SolverWithAliasTable::setEventIdFlattening(const EventIdFlattening & eIdFlattening) {
+  Solver::setEventIdFlattening(eIdFlattening);
+  wrappedSolver_->setEventIdFlattening(eIdFlattening);
+}
+
+void SolverWithAliasTable::beginBuildingEventList(int numOverLatticeEvents,
+						  int numReservedLatticePlanes) {
+
+  wrappedSolver_->beginBuildingEventList(numOverLatticeEvents, numReservedLatticePlanes);
+
+  for (std::size_t i = 0; i < aliasTables_.size(); ++i) {
+    AliasTable_ & table = aliasTables_[i];
+    table.eIds.clear();
+    table.propensities.clear();
+    table.acceptProbs.clear();
+    table.aliases.clear();
+    table.totPropensity = 0;
+  }
+}
+
+void SolverWithAliasTable::addCellCenteredEntryToEventList(const EventId & eId,
+							   double propensity,
+							   int sectNum) {
+  wrappedSolver_->addCellCenteredEntryToEventList(eId, propensity, sectNum);
+}
+
+void SolverWithAliasTable::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+							     const std::vector<double> & propensities,
+							     int sectNum) {
+  wrappedSolver_->addCellCenteredEntriesToEventList(eIds, propensities, sectNum);
+}
+
+void SolverWithAliasTable::addOverLatticeEntryToEventList(const EventId & eId,
+							  double propensity,
+							  int sectNum) {
+  aliasTables_[sectNum].eIds.push_back(eId);
+  aliasTables_[sectNum].propensities.push_back(propensity);
+}
+
+void SolverWithAliasTable::endBuildingEventList() {
+
+  wrappedSolver_->endBuildingEventList();
+
+  for (std::size_t i = 0; i < aliasTables_.size(); ++i) {
+    buildAliasTable_(aliasTables_[i]);
+  }
+
+}
+
+void SolverWithAliasTable::buildAliasTable_(AliasTable_ & table) {
+
+  // Vose's variant of Walker's alias method, which builds the table
+  // in O(N) time.
+
+  std::size_t numEntries = table.eIds.size();
+
+  table.totPropensity = 0;
+  for (std::vector<double>::const_iterator itr = table.propensities.begin(),
+	 itrEnd = table.propensities.end(); itr != itrEnd; ++itr) {
+    table.totPropensity += *itr;
+  }
+
+  table.acceptProbs.assign(numEntries, 1);
+  table.aliases.resize(numEntries);
+
+  smallInds_.clear();
+  largeInds_.clear();
+  scaledPropensities_.resize(numEntries);
+
+  for (std::size_t i = 0; i < numEntries; ++i) {
+    table.aliases[i] = i;
+    scaledPropensities_[i] = numEntries*(table.propensities[i]/table.totPropensity);
+
+    if (scaledPropensities_[i] < 1) {
+      smallInds_.push_back(i);
+    }
+    else {
+      largeInds_.push_back(i);
+    }
+  }
+
+  while (!(smallInds_.empty() || largeInds_.empty())) {
+    std::size_t smallInd = smallInds_.back();
+    std::size_t largeInd = largeInds_.back();
+    smallInds_.pop_back();
+    largeInds_.pop_back();
+
+    table.acceptProbs[smallInd] = scaledPropensities_[smallInd];
+    table.aliases[smallInd] = largeInd;
+
+    scaledPropensities_[largeInd] = (scaledPropensities_[largeInd] + scaledPropensities_[smallInd]) - 1;
+
+    if (scaledPropensities_[largeInd] < 1) {
+      smallInds_.push_back(largeInd);
+    }
+    else {
+      largeInds_.push_back(largeInd);
+    }
+  }
+
+  // Whatever is left over has a scaled propensity that differs from
+  // one only by roundoff, and so is always accepted, which is what
+  // acceptProbs was initialized to.
+}
+
+void SolverWithAliasTable::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+								   double propensity,
+								   int sectNum) {
+  wrappedSolver_->addOrUpdateCellCenteredEntryToEventList(eId, propensity, sectNum);
+}
+
+bool SolverWithAliasTable::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+								  double propensity,
+								  int sectNum) {
+
+  AliasTable_ & table = aliasTables_[sectNum];
+
+  std::size_t ind = std::find(table.eIds.begin(), table.eIds.end(), eId) - table.eIds.begin();
+
+  if (ind < table.eIds.size()) {
+    if (propensity > 0) {
+      table.propensities[ind] = propensity;
+    }
+    else {
+      table.eIds[ind] = table.eIds.back();
+      table.propensities[ind] = table.propensities.back();
+      table.eIds.pop_back();
+      table.propensities.pop_back();
+    }
+  }
+  else if (propensity > 0) {
+    table.eIds.push_back(eId);
+    table.propensities.push_back(propensity);
+  }
+
+  // The table holds only the over-lattice events of a sector, so
+  // building it again is cheap.
+  buildAliasTable_(table);
+
+  return true;
+}
+
+void SolverWithAliasTable::chooseEventIDAndUpdateTime(int sectNum,
+						      EventId & chosenEventID,
+						      double & time) {
+
+  const AliasTable_ & table = aliasTables_[sectNum];
+
+  bool noCellCenteredEvents = wrappedSolver_->noMoreEvents(sectNum);
+
+  double p_s = table.totPropensity;
+  if (!noCellCenteredEvents) {
+    p_s += wrappedSolver_->totalPropensity(sectNum);
+  }
+
+  double R = p_s*(rng_->getNumInOpenIntervalFrom0To1());
+
+  if ((R < table.totPropensity) || noCellCenteredEvents) {
+
+    // R/table.totPropensity is uniformly distributed in [0,1), so it
+    // can be reused to choose from the alias table.
+    std::size_t numEntries = table.eIds.size();
+    double x = numEntries*std::min(R/table.totPropensity, 1.0);
+    std::size_t ind = static_cast<std::size_t>(x);
+
+    // Guarding against roundoff making ind equal to numEntries.
+    if (ind >= numEntries) {
+      ind = numEntries - 1;
+    }
+
+    if (!((x - ind) < table.acceptProbs[ind])) {
+      ind = table.aliases[ind];
+    }
+
+    chosenEventID = table.eIds[ind];
+  }
+  else {
+    // The wrapped solver's time step is for its events alone, so it
+    // is discarded in favor of the one calculated below.
+    double unusedTime = 0;
+    wrappedSolver_->chooseEventIDAndUpdateTime(sectNum, chosenEventID, unusedTime);
+  }
+
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/p_s;
+}
+
+bool SolverWithAliasTable::noMoreEvents(int sectNum) const {
+  return aliasTables_[sectNum].eIds.empty() && wrappedSolver_->noMoreEvents(sectNum);
+}
+
+double SolverWithAliasTable::totalPropensity(int sectNum) {
+  return aliasTables_[sectNum].totPropensity + wrappedSolver_->totalPropensity(sectNum);
+}
+
+std::size_t SolverWithAliasTable::memoryUsage() const {
+  std::size_t numBytes = wrappedSolver_->memoryUsage() + aliasTables_.capacity()*sizeof(AliasTable_) +
+    memoryUsageOf(smallInds_) + memoryUsageOf(largeInds_) + memoryUsageOf(scaledPropensities_);
+
+  for (std::vector<AliasTable_>::const_iterator itr = aliasTables_.begin(),
+	 itrEnd = aliasTables_.end(); itr != itrEnd; ++itr) {
+    numBytes += memoryUsageOf(itr->eIds) + memoryUsageOf(itr->propensities) +
+      memoryUsageOf(itr->acceptProbs) + memoryUsageOf(itr->aliases);
+  }
+
+  return numBytes;
+}
+
+void SolverWithAliasTable::appendEventList(int sectNum,
+					   std::vector<EventId> & eIds,
+					   std::vector<double> & propensities) const {
+
+  const AliasTable_ & table = aliasTables_[sectNum];
+
+  eIds.insert(eIds.end(), table.eIds.begin(), table.eIds.end());
+  propensities.insert(propensities.end(), table.propensities.begin(), table.propensities.end());
+
+  wrappedSolver_->appendEventList(sectNum, eIds, propensities);
+}
+
+#if KMC_PARALLEL
+
+bool SolverWithAliasTable::noCellCenteredEvents(int sectNum) const {
+  return wrappedSolver_->noCellCenteredEvents(sectNum);
+}
+
+double SolverWithAliasTable::getLocalMaxAvgPropensityPerPossEvent() {
+  return localMaxAvgPropensityPerPossEventOf(*wrappedSolver_);
+}
+
+double SolverWithAliasTable::getLocalMaxSinglePropensity() {
+  return localMaxSinglePropensityOf(*wrappedSolver_);
+}
+
+#endif
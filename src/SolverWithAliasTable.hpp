@@ -0,0 +1,115 @@
+#ifndef SOLVER_WITH_ALIAS_TABLE_HPP
+#define SOLVER_WITH_ALIAS_TABLE_HPP
+
+#include "Solver.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Wraps another solver, taking over the over-lattice events, whose
+  // propensities only change between runs. These are stored in a
+  // Walker alias table that is built again whenever they change, so
+  // that choosing one of them takes O(1) time and updating the
+  // cell-centered events never touches them. Choosing an event
+  // first chooses between the over-lattice events and the
+  // cell-centered events of the wrapped solver, in proportion to
+  // their total propensities.
+  class SolverWithAliasTable : public Solver {
+  public:
+    // Takes ownership of wrappedSolver.
+    SolverWithAliasTable(const Lattice * lattice, Solver * wrappedSolver);
+
+    virtual void setRNG(RandNumGenSharedPtr rng);
+
+    virtual void setEventIdFlattening(const EventIdFlattening & eIdFlattening);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList();
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    // Over-lattice events don't contribute to these, so they're just
+    // those of the wrapped solver.
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+#endif
+
+    boost::scoped_ptr<Solver> wrappedSolver_;
+
+    struct AliasTable_ {
+      std::vector<EventId> eIds;
+      std::vector<double> propensities;
+
+      // Entry i is chosen with probability acceptProbs[i], and
+      // otherwise entry aliases[i] is chosen instead.
+      std::vector<double> acceptProbs;
+      std::vector<std::size_t> aliases;
+
+      double totPropensity;
+
+      AliasTable_()
+	: totPropensity(0)
+      {}
+    };
+
+    // One per sector
+    std::vector<AliasTable_> aliasTables_;
+
+    // Scratch space for endBuildingEventList(), kept between calls to
+    // avoid reallocating it.
+    std::vector<std::size_t> smallInds_, largeInds_;
+    std::vector<double> scaledPropensities_;
+
+    void buildAliasTable_(AliasTable_ & table);
+  };
+
+}
+
+#endif /* SOLVER_WITH_ALIAS_TABLE_HPP */
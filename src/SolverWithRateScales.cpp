@@ -0,0 +1,427 @@
+#include "SolverWithRateScales.hpp"
+#include "SolverFactory.hpp"
+#include "MemoryUsage.hpp"
+#include "Lattice.hpp"
+#include "ErrorHandling.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace KMCThinFilm;
+
+SolverWithRateScales::SolverWithRateScales(const Lattice * lattice, int solverId,
+					   const SolverParams & params)
+  : Solver(lattice),
+    lattice_(lattice),
+    solverId_(solverId),
+    cellCenParams_(params),
+    baseSolver_(mkSolver(solverId, lattice, params)),
+    typesAreSplit_(false),
+    isBuilding_(false),
+    hasEventList_(false),
+    numOverLatticeEvents_(0),
+    numReservedLatticePlanes_(0),
+    numCellsPerPlane_(0)
+{
+  // The solvers of the cell-centered events never hold over-lattice
+  // events, so there is no point in giving them alias tables.
+  cellCenParams_.setParam(SolverParam::ALIAS_TABLE_FOR_OVER_LATTICE_EVENTS, 0);
+}
+
+void SolverWithRateScales::setRateScale(int cellCenEventIndex, double rateScale) {
+
+  if (cellCenEventIndex >= static_cast<int>(rateScales_.size())) {
+    rateScales_.resize(cellCenEventIndex + 1, 1.0);
+  }
+
+  rateScales_[cellCenEventIndex] = rateScale;
+
+  if ((!typesAreSplit_) && (rateScale != 1)) {
+    splitTypes_();
+  }
+}
+
+void SolverWithRateScales::splitTypes_() {
+
+  exitOnCondition(isBuilding_, "Cannot split the event list of a solver while it is being built");
+
+  typesAreSplit_ = true;
+
+  if (!hasEventList_) {
+    return;
+  }
+
+  // This is the only time that the entries are touched, and it takes
+  // them from the solver itself rather than from the lattice.
+
+  int numSectors = lattice_->numSectors();
+
+  std::vector<std::vector<EventId> > eIdsPerSector(numSectors);
+  std::vector<std::vector<double> > propensitiesPerSector(numSectors);
+
+  int numOverLatticeEvents = numOverLatticeEvents_;
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+    baseSolver_->appendEventList(sectNum, eIdsPerSector[sectNum], propensitiesPerSector[sectNum]);
+
+    // Over-lattice events may have been added since the event list
+    // was built.
+    const std::vector<EventId> & eIds = eIdsPerSector[sectNum];
+    for (std::size_t i = 0; i < eIds.size(); ++i) {
+      if (eIds[i].isForOverLattice()) {
+	int overLatticeEventIndex, eIdSectNum;
+	eIds[i].getEventInfo(overLatticeEventIndex, eIdSectNum);
+	numOverLatticeEvents = std::max(numOverLatticeEvents, overLatticeEventIndex + 1);
+      }
+    }
+  }
+
+  beginBuildingEventList(numOverLatticeEvents, numReservedLatticePlanes_);
+
+  std::vector<EventId> cellCenEIds;
+  std::vector<double> cellCenPropensities;
+
+  for (int sectNum = 0; sectNum < numSectors; ++sectNum) {
+
+    std::vector<EventId> & eIds = eIdsPerSector[sectNum];
+    std::vector<double> & propensities = propensitiesPerSector[sectNum];
+
+    cellCenEIds.clear();
+    cellCenPropensities.clear();
+
+    for (std::size_t i = 0; i < eIds.size(); ++i) {
+      if (eIds[i].isForOverLattice()) {
+	addOverLatticeEntryToEventList(eIds[i], propensities[i], sectNum);
+      }
+      else {
+	cellCenEIds.push_back(eIds[i]);
+	cellCenPropensities.push_back(propensities[i]);
+      }
+    }
+
+    addCellCenteredEntriesToEventList(cellCenEIds, cellCenPropensities, sectNum);
+
+    std::vector<EventId>().swap(eIds);
+    std::vector<double>().swap(propensities);
+  }
+
+  endBuildingEventList();
+}
+
+Solver & SolverWithRateScales::cellCenSolver_(int cellCenEventIndex) {
+
+  while (static_cast<int>(cellCenSolvers_.size()) <= cellCenEventIndex) {
+    boost::shared_ptr<Solver> solver(mkSolver(solverId_, lattice_, cellCenParams_));
+
+    if (rng_) {
+      solver->setRNG(rng_);
+    }
+
+    solver->setEventIdFlattening(cellCenEIdFlattening_);
+
+    solver->beginBuildingEventList(0, numReservedLatticePlanes_);
+    if (!isBuilding_) {
+      solver->endBuildingEventList();
+    }
+
+    cellCenSolvers_.push_back(solver);
+  }
+
+  return *(cellCenSolvers_[cellCenEventIndex]);
+}
+
+void SolverWithRateScales::setRNG(RandNumGenSharedPtr rng) {
+  Solver::setRNG(rng);
+  baseSolver_->setRNG(rng);
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    cellCenSolvers_[i]->setRNG(rng);
+  }
+}
+
+void SolverWithRateScales::setEventIdFlattening(const EventIdFlattening & eIdFlattening) {
+  Solver::setEventIdFlattening(eIdFlattening);
+  baseSolver_->setEventIdFlattening(eIdFlattening);
+
+  cellCenEIdFlattening_ = eIdFlattening.forSingleCellCenEvent();
+  numCellsPerPlane_ = eIdFlattening.numCellsPerPlane();
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    cellCenSolvers_[i]->setEventIdFlattening(cellCenEIdFlattening_);
+  }
+}
+
+void SolverWithRateScales::beginBuildingEventList(int numOverLatticeEvents,
+						  int numReservedLatticePlanes) {
+
+  numOverLatticeEvents_ = numOverLatticeEvents;
+  numReservedLatticePlanes_ = numReservedLatticePlanes;
+  isBuilding_ = true;
+
+  baseSolver_->beginBuildingEventList(numOverLatticeEvents, numReservedLatticePlanes);
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    cellCenSolvers_[i]->beginBuildingEventList(0, numReservedLatticePlanes);
+  }
+}
+
+void SolverWithRateScales::addCellCenteredEntryToEventList(const EventId & eId,
+							   double propensity,
+							   int sectNum) {
+  if (typesAreSplit_) {
+    int cellCenEventIndex = cellCenEventIndex_(eId);
+    cellCenSolver_(cellCenEventIndex).addCellCenteredEntryToEventList(eIdForType_(eId, cellCenEventIndex),
+								      propensity, sectNum);
+  }
+  else {
+    baseSolver_->addCellCenteredEntryToEventList(eId, propensity, sectNum);
+  }
+}
+
+void SolverWithRateScales::addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+							     const std::vector<double> & propensities,
+							     int sectNum) {
+  if (!typesAreSplit_) {
+    baseSolver_->addCellCenteredEntriesToEventList(eIds, propensities, sectNum);
+    return;
+  }
+
+  // The batch is split into one batch per type, so that each solver
+  // still gets its entries in batches.
+  for (std::size_t i = 0; i < eIds.size(); ++i) {
+    int cellCenEventIndex = cellCenEventIndex_(eIds[i]);
+
+    if (cellCenEventIndex >= static_cast<int>(batchEIds_.size())) {
+      batchEIds_.resize(cellCenEventIndex + 1);
+      batchPropensities_.resize(cellCenEventIndex + 1);
+    }
+
+    batchEIds_[cellCenEventIndex].push_back(eIdForType_(eIds[i], cellCenEventIndex));
+    batchPropensities_[cellCenEventIndex].push_back(propensities[i]);
+  }
+
+  for (std::size_t i = 0; i < batchEIds_.size(); ++i) {
+    if (!batchEIds_[i].empty()) {
+      cellCenSolver_(i).addCellCenteredEntriesToEventList(batchEIds_[i], batchPropensities_[i], sectNum);
+      batchEIds_[i].clear();
+      batchPropensities_[i].clear();
+    }
+  }
+}
+
+void SolverWithRateScales::addOverLatticeEntryToEventList(const EventId & eId,
+							  double propensity,
+							  int sectNum) {
+  baseSolver_->addOverLatticeEntryToEventList(eId, propensity, sectNum);
+}
+
+void SolverWithRateScales::endBuildingEventList() {
+
+  baseSolver_->endBuildingEventList();
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    cellCenSolvers_[i]->endBuildingEventList();
+  }
+
+  isBuilding_ = false;
+  hasEventList_ = true;
+}
+
+void SolverWithRateScales::addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+								   double propensity,
+								   int sectNum) {
+  if (typesAreSplit_) {
+    int cellCenEventIndex = cellCenEventIndex_(eId);
+
+    // A type without a solver has no entries to remove.
+    if ((propensity > 0) || (cellCenEventIndex < static_cast<int>(cellCenSolvers_.size()))) {
+      cellCenSolver_(cellCenEventIndex).addOrUpdateCellCenteredEntryToEventList(eIdForType_(eId, cellCenEventIndex),
+										propensity, sectNum);
+    }
+  }
+  else {
+    baseSolver_->addOrUpdateCellCenteredEntryToEventList(eId, propensity, sectNum);
+  }
+}
+
+bool SolverWithRateScales::addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+								  double propensity,
+								  int sectNum) {
+  return baseSolver_->addOrUpdateOverLatticeEntryToEventList(eId, propensity, sectNum);
+}
+
+double SolverWithRateScales::fillPartialSums_(int sectNum) {
+
+  // Entry 0 is for the base solver, and entry i + 1 for the solver of
+  // cell-centered events with index i.
+
+  partialSums_.resize(cellCenSolvers_.size() + 1);
+
+  double p_s = 0;
+
+  if (!baseSolver_->noMoreEvents(sectNum)) {
+    p_s += baseSolver_->totalPropensity(sectNum);
+  }
+
+  partialSums_[0] = p_s;
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    double rateScale = rateScale_(i);
+    Solver & solver = *(cellCenSolvers_[i]);
+
+    if ((rateScale > 0) && !solver.noMoreEvents(sectNum)) {
+      p_s += rateScale*solver.totalPropensity(sectNum);
+    }
+
+    partialSums_[i + 1] = p_s;
+  }
+
+  return p_s;
+}
+
+void SolverWithRateScales::chooseEventIDAndUpdateTime(int sectNum,
+						      EventId & chosenEventID,
+						      double & time) {
+
+  if (!typesAreSplit_) {
+    baseSolver_->chooseEventIDAndUpdateTime(sectNum, chosenEventID, time);
+    return;
+  }
+
+  double p_s = fillPartialSums_(sectNum);
+  double R = p_s*(rng_->getNumInOpenIntervalFrom0To1());
+
+  // The first partial sum that exceeds R belongs to a solver with
+  // events, since it exceeds the partial sum before it.
+  std::size_t ind = std::upper_bound(partialSums_.begin(), partialSums_.end(), R) - partialSums_.begin();
+
+  if (ind == partialSums_.size()) {
+    // Roundoff made R reach the total, so defaulting to the last
+    // solver with events.
+    do {
+      --ind;
+    } while ((ind > 0) && !(partialSums_[ind] > partialSums_[ind - 1]));
+  }
+
+  // The chosen solver's time step is for its events alone, so it is
+  // discarded in favor of the one calculated below.
+  double unusedTime = 0;
+
+  if (ind == 0) {
+    baseSolver_->chooseEventIDAndUpdateTime(sectNum, chosenEventID, unusedTime);
+  }
+  else {
+    int cellCenEventIndex = static_cast<int>(ind - 1);
+
+    EventId typeEId;
+    cellCenSolvers_[cellCenEventIndex]->chooseEventIDAndUpdateTime(sectNum, typeEId, unusedTime);
+    chosenEventID = eIdFromType_(typeEId, cellCenEventIndex);
+  }
+
+  time += -std::log(rng_->getNumInOpenIntervalFrom0To1())/p_s;
+}
+
+bool SolverWithRateScales::noMoreEvents(int sectNum) const {
+
+  if (!baseSolver_->noMoreEvents(sectNum)) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    if ((rateScale_(i) > 0) && !cellCenSolvers_[i]->noMoreEvents(sectNum)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+double SolverWithRateScales::totalPropensity(int sectNum) {
+  if (typesAreSplit_) {
+    return fillPartialSums_(sectNum);
+  }
+  else {
+    return baseSolver_->totalPropensity(sectNum);
+  }
+}
+
+std::size_t SolverWithRateScales::memoryUsage() const {
+  std::size_t numBytes = baseSolver_->memoryUsage() +
+    cellCenSolvers_.capacity()*sizeof(boost::shared_ptr<Solver>) + memoryUsageOf(rateScales_) +
+    memoryUsageOf(batchEIds_) + memoryUsageOf(batchPropensities_) + memoryUsageOf(partialSums_);
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    numBytes += cellCenSolvers_[i]->memoryUsage();
+  }
+
+  return numBytes;
+}
+
+void SolverWithRateScales::appendEventList(int sectNum,
+					   std::vector<EventId> & eIds,
+					   std::vector<double> & propensities) const {
+
+  baseSolver_->appendEventList(sectNum, eIds, propensities);
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    std::size_t firstInd = eIds.size();
+    int cellCenEventIndex = static_cast<int>(i);
+
+    cellCenSolvers_[i]->appendEventList(sectNum, eIds, propensities);
+
+    for (std::size_t j = firstInd; j < eIds.size(); ++j) {
+      eIds[j] = eIdFromType_(eIds[j], cellCenEventIndex);
+    }
+  }
+}
+
+#if KMC_PARALLEL
+
+bool SolverWithRateScales::noCellCenteredEvents(int sectNum) const {
+
+  if (!typesAreSplit_) {
+    return baseSolver_->noCellCenteredEvents(sectNum);
+  }
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    if ((rateScale_(i) > 0) && !cellCenSolvers_[i]->noCellCenteredEvents(sectNum)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+double SolverWithRateScales::getLocalMaxAvgPropensityPerPossEvent() {
+
+  if (!typesAreSplit_) {
+    return localMaxAvgPropensityPerPossEventOf(*baseSolver_);
+  }
+
+  double maxAvgPropensity = 0;
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    maxAvgPropensity = std::max(maxAvgPropensity,
+				rateScale_(i)*localMaxAvgPropensityPerPossEventOf(*(cellCenSolvers_[i])));
+  }
+
+  return maxAvgPropensity;
+}
+
+double SolverWithRateScales::getLocalMaxSinglePropensity() {
+
+  if (!typesAreSplit_) {
+    return localMaxSinglePropensityOf(*baseSolver_);
+  }
+
+  double maxPropensity = 0;
+
+  for (std::size_t i = 0; i < cellCenSolvers_.size(); ++i) {
+    maxPropensity = std::max(maxPropensity,
+			     rateScale_(i)*localMaxSinglePropensityOf(*(cellCenSolvers_[i])));
+  }
+
+  return maxPropensity;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef SOLVER_WITH_RATE_SCALES_HPP
+#define SOLVER_WITH_RATE_SCALES_HPP
+
+#include "Solver.hpp"
+#include "ParamsForSolvers.hpp"
+
+#include <vector>
+#include <cstddef>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace KMCThinFilm {
+
+  class Lattice;
+
+  // Wraps a built-in solver so that the propensities of each type of
+  // cell-centered event (i.e., each cell-centered event index of the
+  // EventIdFlattening) can be multiplied by a rate scale without
+  // touching their entries, which is how Simulation applies
+  // Simulation::setEventRateScale(int, int, double).
+  //
+  // Until a rate scale other than one is set, every event is kept in
+  // a single solver and every call is passed straight on to it, so
+  // that the wrapper changes nothing. Once one is set, the
+  // cell-centered events of each type are moved to a solver of their
+  // own, which holds their unscaled propensities, while the
+  // over-lattice events stay where they were. Choosing an event then
+  // first chooses between the over-lattice events and the types of
+  // cell-centered events, in proportion to their total propensities
+  // times their rate scales, so that changing a rate scale takes
+  // O(1) time rather than touching every entry of its type.
+  class SolverWithRateScales : public Solver {
+  public:
+    SolverWithRateScales(const Lattice * lattice, int solverId,
+			 const SolverParams & params);
+
+    // Sets the factor multiplying the propensities of the
+    // cell-centered events with the given index. The propensities
+    // passed to the solver are always the unscaled ones.
+    void setRateScale(int cellCenEventIndex, double rateScale);
+
+    virtual void setRNG(RandNumGenSharedPtr rng);
+
+    virtual void setEventIdFlattening(const EventIdFlattening & eIdFlattening);
+
+    virtual void beginBuildingEventList(int numOverLatticeEvents,
+                                        int numReservedLatticePlanes);
+
+    virtual void addCellCenteredEntryToEventList(const EventId & eId,
+						 double propensity,
+						 int sectNum);
+
+    virtual void addCellCenteredEntriesToEventList(const std::vector<EventId> & eIds,
+						   const std::vector<double> & propensities,
+						   int sectNum);
+
+    virtual void addOverLatticeEntryToEventList(const EventId & eId,
+						double propensity,
+						int sectNum);
+
+    virtual void endBuildingEventList();
+
+    virtual void addOrUpdateCellCenteredEntryToEventList(const EventId & eId,
+							 double propensity,
+							 int sectNum);
+
+    virtual bool addOrUpdateOverLatticeEntryToEventList(const EventId & eId,
+							double propensity,
+							int sectNum);
+
+    virtual void chooseEventIDAndUpdateTime(int sectNum,
+					    EventId & chosenEventID,
+					    double & time);
+
+    // Events whose rate scale is zero are still in the event list,
+    // but don't count as events here.
+    virtual bool noMoreEvents(int sectNum) const;
+
+    virtual double totalPropensity(int sectNum);
+
+    virtual std::size_t memoryUsage() const;
+
+    // Appends the unscaled propensities, including those of events
+    // whose rate scale is zero, so that the event list can be built
+    // again from what is appended.
+    virtual void appendEventList(int sectNum,
+				 std::vector<EventId> & eIds,
+				 std::vector<double> & propensities) const;
+
+#if KMC_PARALLEL
+    virtual bool noCellCenteredEvents(int sectNum) const;
+#endif
+
+  private:
+
+#if KMC_PARALLEL
+    // Once the types are split, the average is taken as the largest
+    // over the types of the scaled average of a type, which is an
+    // upper bound on the average over all of them, and so can only
+    // shorten the time step.
+    virtual double getLocalMaxAvgPropensityPerPossEvent();
+    virtual double getLocalMaxSinglePropensity();
+#endif
+
+    const Lattice * lattice_;
+    int solverId_;
+    SolverParams cellCenParams_;
+
+    // Holds the over-lattice events, and also the cell-centered
+    // events until the types are split.
+    boost::scoped_ptr<Solver> baseSolver_;
+
+    // One per type of cell-centered event, made as they are needed
+    // once the types are split.
+    std::vector<boost::shared_ptr<Solver> > cellCenSolvers_;
+    std::vector<double> rateScales_;
+
+    bool typesAreSplit_;
+    bool isBuilding_;
+    bool hasEventList_;
+
+    int numOverLatticeEvents_;
+    int numReservedLatticePlanes_;
+
+    EventIdFlattening cellCenEIdFlattening_;
+    EventId::FlatIndex numCellsPerPlane_;
+
+    // Scratch space, kept between calls to avoid reallocating it.
+    std::vector<std::vector<EventId> > batchEIds_;
+    std::vector<std::vector<double> > batchPropensities_;
+    std::vector<double> partialSums_;
+
+    void splitTypes_();
+
+    // Fills partialSums_ with the cumulative scaled total propensities
+    // of the solvers of sector sectNum, and returns their sum.
+    double fillPartialSums_(int sectNum);
+
+    Solver & cellCenSolver_(int cellCenEventIndex);
+
+    double rateScale_(std::size_t cellCenEventIndex) const {
+      return (cellCenEventIndex < rateScales_.size()) ? rateScales_[cellCenEventIndex] : 1.0;
+    }
+
+    // Splits an event ID into the type of the event and its ID within
+    // the solver of that type, and back again.
+    int cellCenEventIndex_(const EventId & eId) const {
+      return static_cast<int>(eId.e1_/numCellsPerPlane_);
+    }
+
+    EventId eIdForType_(const EventId & eId, int cellCenEventIndex) const {
+      EventId typeEId(eId);
+      typeEId.e1_ -= numCellsPerPlane_*cellCenEventIndex;
+      return typeEId;
+    }
+
+    EventId eIdFromType_(const EventId & typeEId, int cellCenEventIndex) const {
+      EventId eId(typeEId);
+      eId.e1_ += numCellsPerPlane_*cellCenEventIndex;
+      return eId;
+    }
+  };
+
+}
+
+#endif /* SOLVER_WITH_RATE_SCALES_HPP */
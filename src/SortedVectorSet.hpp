@@ -0,0 +1,50 @@
+#ifndef SORTED_VECTOR_SET_HPP
+#define SORTED_VECTOR_SET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace KMCThinFilm {
+
+  //! \cond HIDE_FROM_DOXYGEN
+
+  // A set kept as a sorted std::vector, and iterated in the same
+  // order as a std::set. Unlike a std::set, it does not allocate a
+  // node per element, and clear() keeps its storage, so that once it
+  // has grown to its working size, inserting into it and clearing it
+  // never allocate. Inserting takes O(N) time, which is fine for the
+  // handful of elements it usually holds.
+  template <typename T>
+  class SortedVectorSet {
+  public:
+    typedef typename std::vector<T>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+    typedef T value_type;
+
+    void insert(const T & val) {
+      typename std::vector<T>::iterator itr = std::lower_bound(vals_.begin(), vals_.end(), val);
+
+      if ((itr == vals_.end()) || (val < *itr)) {
+        vals_.insert(itr, val);
+      }
+    }
+
+    void clear() {vals_.clear();}
+    void reserve(std::size_t n) {vals_.reserve(n);}
+
+    std::size_t size() const {return vals_.size();}
+    bool empty() const {return vals_.empty();}
+
+    const_iterator begin() const {return vals_.begin();}
+    const_iterator end() const {return vals_.end();}
+
+  private:
+    std::vector<T> vals_;
+  };
+
+  //! \endcond
+
+}
+
+#endif /* SORTED_VECTOR_SET_HPP */